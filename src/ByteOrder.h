@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Chip8State.h"
+
+// Little endian fields of the binary files (input movies, frame streams, traces), whatever the host byte order.
+
+inline void writeLittleEndian(std::vector<byte>& output, std::uint64_t value, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; ++i)
+        output.push_back(static_cast<byte>(value >> (8 * i)));
+}
+
+inline std::uint64_t readLittleEndian(const byte* input, unsigned int size)
+{
+    std::uint64_t value = 0;
+
+    for (unsigned int i = 0; i < size; ++i)
+        value |= static_cast<std::uint64_t>(input[i]) << (8 * i);
+
+    return value;
+}
+
+// Reads the field at offset and moves offset past it.
+inline std::uint64_t readLittleEndian(const std::vector<byte>& input, std::size_t& offset, unsigned int size)
+{
+    const std::uint64_t value = readLittleEndian(&input[offset], size);
+    offset += size;
+
+    return value;
+}
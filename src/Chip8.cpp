@@ -1,32 +1,549 @@
+#include <algorithm>
 #include <fstream>
+#include <cstring>
+#include <initializer_list>
+#include <random>
+#include <utility>
 #include "Chip8.h"
 
+// Profiler hooks, run before each instruction by every engine and when a DXYN draws (past any display wait).
+// Compile to nothing without CHIP8_PROFILER.
+#ifdef CHIP8_PROFILER
+#define CHIP8_PROFILE_INSTRUCTION(instruction)  do { if (profiler) profiler->onInstruction(PC, instruction, SP); } while (false)
+#define CHIP8_PROFILE_DRAW(c, rows)             do { if ((c).profiler) (c).profiler->onDraw(rows); } while (false)
+#else
+#define CHIP8_PROFILE_INSTRUCTION(instruction)  do { } while (false)
+#define CHIP8_PROFILE_DRAW(c, rows)             do { } while (false)
+#endif
+
+// Tracer hook, same places. Compiles to nothing without CHIP8_TRACER.
+#ifdef CHIP8_TRACER
+#define CHIP8_TRACE_INSTRUCTION(instruction)    do { if (tracer) tracer->onInstruction(getState(), instruction); } while (false)
+#else
+#define CHIP8_TRACE_INSTRUCTION(instruction)    do { } while (false)
+#endif
+
+namespace
+{
+    // Builds a dense dispatch table at compile time, every slot not listed goes to the trap handler.
+    template<std::size_t Size, typename Handler>
+    constexpr std::array<Handler, Size> makeDispatchTable(Handler trapHandler, std::initializer_list<std::pair<unsigned int, Handler>> entries)
+    {
+        std::array<Handler, Size> table{};
+
+        for (std::size_t i = 0; i < Size; ++i)
+            table[i] = trapHandler;
+
+        for (const auto& entry : entries)
+            table[entry.first] = entry.second;
+
+        return table;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Same opcode definitions as the std::map tables below, as plain functions indexed by the opcode bits.
+// Level one is indexed by the highest nibble, level two by NN (groups 0, E and F) or N (group 8).
+// Instantiated once per quirk profile: the quirks are compile time constants, each profile gets its own core.
+template<Chip8::QuirkProfile Profile>
+struct Chip8::JumpTable
+{
+    using Handler = OpHandler;
+
+    static constexpr Quirks c_quirks = getQuirks(Profile);
+
+    static void trap(Chip8& c, const Operands& o)   { c.trap(o.opCode); }
+
+    static void group0(Chip8& c, const Operands& o) { table0[o.NN](c, o); }
+    static void group8(Chip8& c, const Operands& o) { table8[o.N](c, o);  }
+    static void groupE(Chip8& c, const Operands& o) { tableE[o.NN](c, o); }
+    static void groupF(Chip8& c, const Operands& o) { tableF[o.NN](c, o); }
+
+    static void op00E0(Chip8& c, const Operands&)   { c.clearDisplay();                                    c.drawFlag = true; c.PC += 2; }   // CLS
+    static void op00EE(Chip8& c, const Operands&)   { c.PC = c.popStack();                                                  c.PC += 2; }   // RET
+
+    static void op1NNN(Chip8& c, const Operands& o) { c.PC = o.NNN;                                 } // JMP
+    static void op2NNN(Chip8& c, const Operands& o) { c.pushStack(c.PC); c.PC = o.NNN;              } // CALL
+    static void op3XNN(Chip8& c, const Operands& o) { c.PC += (c.V[o.X] == o.NN)     ? 4 : 2;       } // SE
+    static void op4XNN(Chip8& c, const Operands& o) { c.PC += (c.V[o.X] != o.NN)     ? 4 : 2;       } // SNE
+    static void op5XY0(Chip8& c, const Operands& o) { c.PC += (c.V[o.X] == c.V[o.Y]) ? 4 : 2;       } // SE
+    static void op6XNN(Chip8& c, const Operands& o) { c.V[o.X] = o.NN;                    c.PC += 2; } // LD
+    static void op7XNN(Chip8& c, const Operands& o) { c.V[o.X] += o.NN;                   c.PC += 2; } // ADD
+    static void op9XY0(Chip8& c, const Operands& o) { c.PC += (c.V[o.X] != c.V[o.Y]) ? 4 : 2;       } // SNE
+    static void opANNN(Chip8& c, const Operands& o) { c.I = o.NNN;                        c.PC += 2; } // LD
+    static void opBNNN(Chip8& c, const Operands& o) { c.PC = o.NNN + c.V[c_quirks.jumpUsesVX ? o.X : 0]; } // JMP
+    static void opCXNN(Chip8& c, const Operands& o) { c.V[o.X] = c.randomNext() & o.NN;   c.PC += 2; } // RND
+    static void opDXYN(Chip8& c, const Operands& o)                                                     // DRW
+    {
+        if constexpr (c_quirks.displayWait)
+        {
+            // Stay on the instruction until the next vertical blank.
+            if (!c.vblank)
+                return;
+
+            c.vblank = false;
+        }
+
+        CHIP8_PROFILE_DRAW(c, o.N);
+        c.drawSprite<c_quirks.clipSprites>(o.X, o.Y, o.N);
+        c.drawFlag = true;
+        c.PC += 2;
+    }
+
+    static void op8XY0(Chip8& c, const Operands& o) { c.V[o.X] = c.V[o.Y];                                                              c.PC += 2; } // LD
+    static void op8XY1(Chip8& c, const Operands& o) { c.V[o.X] |= c.V[o.Y]; if constexpr (c_quirks.logicResetsVF) c.V[0xF] = 0;        c.PC += 2; } // OR
+    static void op8XY2(Chip8& c, const Operands& o) { c.V[o.X] &= c.V[o.Y]; if constexpr (c_quirks.logicResetsVF) c.V[0xF] = 0;        c.PC += 2; } // AND
+    static void op8XY3(Chip8& c, const Operands& o) { c.V[o.X] ^= c.V[o.Y]; if constexpr (c_quirks.logicResetsVF) c.V[0xF] = 0;        c.PC += 2; } // XOR
+    static void op8XY4(Chip8& c, const Operands& o) { c.V[0xF] = ((c.V[o.X] + c.V[o.Y]) > 0xFF) ? 1 : 0; c.V[o.X] += c.V[o.Y];          c.PC += 2; } // ADD
+    static void op8XY5(Chip8& c, const Operands& o) { c.V[0xF] = (c.V[o.X] > c.V[o.Y]) ? 1 : 0;          c.V[o.X] -= c.V[o.Y];          c.PC += 2; } // SUB
+    static void op8XY6(Chip8& c, const Operands& o) { shiftSource(c, o); c.V[0xF] = (c.V[o.X] & LSB) ? 1 : 0; c.V[o.X] >>= 1;             c.PC += 2; } // SHR
+    static void op8XY7(Chip8& c, const Operands& o) { c.V[0xF] = (c.V[o.Y] > c.V[o.X]) ? 1 : 0;          c.V[o.X] = c.V[o.Y] - c.V[o.X]; c.PC += 2; } // SUBN
+    static void op8XYE(Chip8& c, const Operands& o) { shiftSource(c, o); c.V[0xF] = (c.V[o.X] & MSB) ? 1 : 0; c.V[o.X] <<= 1;             c.PC += 2; } // SHL
+
+    static void shiftSource(Chip8& c, const Operands& o) { if constexpr (c_quirks.shiftUsesVY) c.V[o.X] = c.V[o.Y]; }
+
+    static void opEX9E(Chip8& c, const Operands& o) { c.PC += (c.isKeyPressed(c.V[o.X]))  ? 4 : 2; } // SKP
+    static void opEXA1(Chip8& c, const Operands& o) { c.PC += (!c.isKeyPressed(c.V[o.X])) ? 4 : 2; } // SKNP
+
+    static void opFX07(Chip8& c, const Operands& o) { c.V[o.X] = c.delayTimer; c.PC += 2; } // LD
+    static void opFX0A(Chip8& c, const Operands& o)                                           // LD
+    {
+        if (c.keys != 0)
+        {
+            c.V[o.X] = c.firstPressedKey();
+            c.PC += 2;
+        }
+    }
+    static void opFX15(Chip8& c, const Operands& o) { c.delayTimer = c.V[o.X]; c.PC += 2; } // LD
+    static void opFX18(Chip8& c, const Operands& o) { c.soundTimer = c.V[o.X]; c.PC += 2; } // LD
+    static void opFX1E(Chip8& c, const Operands& o) { const twoByte result = c.I + c.V[o.X]; c.V[0xF] = (result > 0xFFF) ? 1 : 0; c.I += c.V[o.X]; c.PC += 2; } // ADD
+    static void opFX29(Chip8& c, const Operands& o) { c.I = c.V[o.X] * 5; c.PC += 2; } // LD
+    static void opFX33(Chip8& c, const Operands& o) { c.invalidateCode(c.I, 3);     c.memory[c.I] = c.V[o.X] / 100; c.memory[c.I + 1] = (c.V[o.X] / 10) % 10; c.memory[c.I + 2] = (c.V[o.X] % 100) % 10; c.PC += 2; } // LD (BCD)
+    static void opFX55(Chip8& c, const Operands& o) { c.invalidateCode(c.I, o.X + 1); std::copy_n(c.V.begin(), o.X + 1, c.memory.begin() + c.I); if constexpr (c_quirks.loadStoreIncrementsI) c.I += o.X + 1; c.PC += 2; } // LD
+    static void opF002(Chip8& c, const Operands&)   { c.loadAudioPattern(); c.PC += 2; } // AUDIO (XO-CHIP)
+    static void opFX3A(Chip8& c, const Operands& o) { c.audioPitch = c.V[o.X]; c.PC += 2; } // PITCH (XO-CHIP)
+    static void opFX65(Chip8& c, const Operands& o) { std::copy_n(c.memory.begin() + c.I, o.X + 1, c.V.begin());   if constexpr (c_quirks.loadStoreIncrementsI) c.I += o.X + 1; c.PC += 2; } // LD
+
+    // Second level lookup done once at translation time, so cached blocks call the final handler directly.
+    static Handler resolve(twoByte opCode)
+    {
+        switch (opCode >> 12)
+        {
+            case 0x0: return table0[opCode & 0x00FF];
+            case 0x8: return table8[opCode & 0x000F];
+            case 0xE: return tableE[opCode & 0x00FF];
+            case 0xF: return tableF[opCode & 0x00FF];
+            default:  return primary[opCode >> 12];
+        }
+    }
+
+    // Jumps, calls, returns, key waits and memory stores end a basic block. Conditional skips don't:
+    // the block keeps running while the skip falls through and is left as soon as one is taken.
+    static bool endsBlock(Handler handler)
+    {
+        return handler == &op00EE || handler == &op1NNN || handler == &op2NNN || handler == &opBNNN ||
+               handler == &opFX0A || handler == &opFX33 || handler == &opFX55;
+    }
+
+    static constexpr std::array<Handler, 16> primary = makeDispatchTable<16, Handler>(&trap,
+    {
+        { 0x0, &group0 }, { 0x1, &op1NNN }, { 0x2, &op2NNN }, { 0x3, &op3XNN },
+        { 0x4, &op4XNN }, { 0x5, &op5XY0 }, { 0x6, &op6XNN }, { 0x7, &op7XNN },
+        { 0x8, &group8 }, { 0x9, &op9XY0 }, { 0xA, &opANNN }, { 0xB, &opBNNN },
+        { 0xC, &opCXNN }, { 0xD, &opDXYN }, { 0xE, &groupE }, { 0xF, &groupF },
+    });
+
+    static constexpr std::array<Handler, 256> table0 = makeDispatchTable<256, Handler>(&trap,
+    {
+        { 0xE0, &op00E0 }, { 0xEE, &op00EE },
+    });
+
+    static constexpr std::array<Handler, 16> table8 = makeDispatchTable<16, Handler>(&trap,
+    {
+        { 0x0, &op8XY0 }, { 0x1, &op8XY1 }, { 0x2, &op8XY2 }, { 0x3, &op8XY3 },
+        { 0x4, &op8XY4 }, { 0x5, &op8XY5 }, { 0x6, &op8XY6 }, { 0x7, &op8XY7 },
+        { 0xE, &op8XYE },
+    });
+
+    static constexpr std::array<Handler, 256> tableE = makeDispatchTable<256, Handler>(&trap,
+    {
+        { 0x9E, &opEX9E }, { 0xA1, &opEXA1 },
+    });
+
+    static constexpr std::array<Handler, 256> tableF = makeDispatchTable<256, Handler>(&trap,
+    {
+        { 0x07, &opFX07 }, { 0x0A, &opFX0A }, { 0x15, &opFX15 }, { 0x18, &opFX18 },
+        { 0x1E, &opFX1E }, { 0x29, &opFX29 }, { 0x33, &opFX33 }, { 0x55, &opFX55 },
+        { 0x65, &opFX65 },
+        { 0x02, (Profile == QuirkProfile::XoChip) ? &opF002 : &trap },
+        { 0x3A, (Profile == QuirkProfile::XoChip) ? &opFX3A : &trap },
+    });
+
+    static bool isDefined(twoByte opCode) { return resolve(opCode) != &trap; }
+
+    static constexpr Core core = { primary.data(), &resolve, &endsBlock, &isDefined };
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+const Chip8::Core& Chip8::getCore(QuirkProfile profile)
+{
+    switch (profile)
+    {
+        case QuirkProfile::CosmacVip: return JumpTable<QuirkProfile::CosmacVip>::core;
+        case QuirkProfile::SuperChip: return JumpTable<QuirkProfile::SuperChip>::core;
+        case QuirkProfile::XoChip:    return JumpTable<QuirkProfile::XoChip>::core;
+        default:                      return JumpTable<QuirkProfile::Chip8>::core;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Cache of translated basic blocks, indexed by the address of their first instruction.
+struct Chip8::BlockCache
+{
+    static constexpr unsigned int c_maxBlockLength        = 64;
+    static constexpr unsigned int c_maxCachedInstructions = 64 * 1024;     // Invalidated blocks aren't reclaimed, start over past this size.
+    static constexpr int          c_noBlock               = -1;
+
+    struct Instruction
+    {
+        OpHandler handler;
+        Operands  operands;     // Passed to the handler as they are, nothing is decoded again.
+    };
+
+    struct Block
+    {
+        twoByte start;          // Address of the first instruction.
+        twoByte end;            // Address one past the last instruction.
+        unsigned int firstInstruction;
+        unsigned int numInstructions;
+        bool dropped;           // Its code was overwritten, it's no longer the entry at its start address.
+        int  successorPC;       // Where the last run of the block left PC (c_noBlock when unlinked) and the block
+        int  successor;         // there, followed without a blockAt lookup when the next run leaves the same way.
+    };
+
+    BlockCache() { clear(); }
+
+    // Keeps the capacity of the vectors, so flushing (loadState(), resets) doesn't reallocate them.
+    void clear()
+    {
+        blockAt.fill(c_noBlock);
+        codeMap.fill(0);
+        blocks.clear();
+        instructions.clear();
+        lastBlock = c_noBlock;
+    }
+
+    std::array<int, c_memorySize>  blockAt;     // Block index starting at each address, or c_noBlock.
+    std::array<twoByte, c_memorySize> codeMap;  // Number of cached blocks covering each address, stores only invalidate when non zero.
+
+    std::vector<Block>       blocks;
+    std::vector<Instruction> instructions;
+    int                      lastBlock;     // Block run last, linked to the one that runs after it (across runs too).
+};
+
+// 35 opcodes, all two bytes long.
+const std::map<twoByte, Chip8::MapHandler> Chip8::opCodesTable
+{
+    { 0x0000, [](Chip8& c) { if (c.dispatch(opCode0Table, twoByte(c.NN))) c.PC += 2; } }, // Go to Op-Code table 0 (System Operations) (0x00E0, 0x00EE)
+    { 0x1000, [](Chip8& c) { c.PC = c.NNN;                                } }, // JMP:  1NNN - Jumps to address NNN.
+    { 0x2000, [](Chip8& c) { c.pushStack(c.PC); c.PC = c.NNN;             } }, // CALL: 2NNN - Calls subroutine at NNN.
+    { 0x3000, [](Chip8& c) { c.PC += (c.V[c.X] == c.NN)     ? 4 : 2;      } }, // SE:   3XNN - Skip next instruction if Vx == NN.
+    { 0x4000, [](Chip8& c) { c.PC += (c.V[c.X] != c.NN)     ? 4 : 2;      } }, // SNE:  4XNN - Skip next instruction if Vx != NN.
+    { 0x5000, [](Chip8& c) { c.PC += (c.V[c.X] == c.V[c.Y]) ? 4 : 2;      } }, // SE:   5XY0 - Skip next instruction if Vx == Vy.
+    { 0x6000, [](Chip8& c) { c.V[c.X] = c.NN;                  c.PC += 2; } }, // LD:   6XNN - Set Vx = NN
+    { 0x7000, [](Chip8& c) { c.V[c.X] += c.NN;                 c.PC += 2; } }, // ADD:  7XNN - Set Vx = Vx + NN. (Carry flag is not changed)
+    { 0x8000, [](Chip8& c) { if (c.dispatch(opCode8Table, c.N))          c.PC += 2; } }, // Go to Op-Code table 8 (Arithmetic Operations)
+    { 0x9000, [](Chip8& c) { c.PC += (c.V[c.X] != c.V[c.Y]) ? 4 : 2;      } }, // SNE:  9XY0 - Skip next instruction if Vx != Vy.
+    { 0xA000, [](Chip8& c) { c.I = c.NNN;                      c.PC += 2; } }, // LD:   ANNN - Set I = NNN.
+    { 0xB000, [](Chip8& c) { c.PC = c.NNN + c.V[c.quirks.jumpUsesVX ? c.X : 0]; } }, // JMP:  BNNN - PC = NNN + V0 (BXNN - PC = XNN + Vx with the jump quirk).
+    { 0xC000, [](Chip8& c) { c.V[c.X] = c.randomNext() & c.NN; c.PC += 2; } }, // RND:  CXNN - Set Vx = random() & NN.
+    { 0xD000, [](Chip8& c) { if (c.quirks.displayWait) { if (!c.vblank) return; c.vblank = false; } CHIP8_PROFILE_DRAW(c, c.N); c.draw(); c.drawFlag = true; c.PC += 2; } }, // DRW:  DXYN - Draws a sprite at memory location I at coordinate (Vx, Vy) that has a width of 8 pixels and a height of N pixels.
+    { 0xE000, [](Chip8& c) { c.dispatch(opCodeETable, twoByte(c.NN));     } }, // Go to Op-Code table E (Input Operations)
+    { 0xF000, [](Chip8& c) { c.dispatch(opCodeFTable, twoByte(c.NN));     } }, // Go to Op-Code table F (System Operations)
+};
+
+const std::map<twoByte, Chip8::MapHandler> Chip8::opCode0Table
+{
+    { 0x00E0, [](Chip8& c) { c.clearDisplay(); c.drawFlag = true; } }, // CLS: Clear the display.
+    { 0x00EE, [](Chip8& c) { c.PC = c.popStack();                 } }, // RET: Return from a subroutine.
+};
+
+const std::map<byte, Chip8::MapHandler> Chip8::opCode8Table
+{
+    { 0x0000, [](Chip8& c) { c.V[c.X] = c.V[c.Y];                                                         } }, // LD:   8XY0 - Set Vx = Vy.
+    { 0x0001, [](Chip8& c) { c.V[c.X] |= c.V[c.Y]; if (c.quirks.logicResetsVF) c.V[0xF] = 0;               } }, // OR:   8XY1 - Set Vx = Vx | Vy.
+    { 0x0002, [](Chip8& c) { c.V[c.X] &= c.V[c.Y]; if (c.quirks.logicResetsVF) c.V[0xF] = 0;               } }, // AND:  8XY2 - Set Vx = Vx & Vy.
+    { 0x0003, [](Chip8& c) { c.V[c.X] ^= c.V[c.Y]; if (c.quirks.logicResetsVF) c.V[0xF] = 0;               } }, // XOR:  8XY3 - Set Vx = Vx ^ Vy.
+    { 0x0004, [](Chip8& c) { c.V[0xF] = ((c.V[c.X] + c.V[c.Y]) > 0xFF) ? 1 : 0; c.V[c.X] += c.V[c.Y];      } }, // ADD:  8XY4 - Set Vx = Vx + Vy, set VF = carry.
+    { 0x0005, [](Chip8& c) { c.V[0xF] = (c.V[c.X] > c.V[c.Y]) ? 1 : 0;          c.V[c.X] -= c.V[c.Y];      } }, // SUB:  8XY5 - Set Vx = Vx - Vy, set VF = NOT borrow.
+    { 0x0006, [](Chip8& c) { if (c.quirks.shiftUsesVY) c.V[c.X] = c.V[c.Y]; c.V[0xF] = (c.V[c.X] & LSB) ? 1 : 0; c.V[c.X] >>= 1; } }, // SHR:  8XY6 - Set Vx = Vx >> 1 (Vx is divided by 2). If the least significant bit of Vx is 1, then VF is set to 1, otherwise 0.
+    { 0x0007, [](Chip8& c) { c.V[0xF] = (c.V[c.Y] > c.V[c.X]) ? 1 : 0;          c.V[c.X] = c.V[c.Y] - c.V[c.X]; } }, // SUBN: 8XY7 - Set Vx = Vy - Vx, set VF = NOT borrow.
+    { 0x000E, [](Chip8& c) { if (c.quirks.shiftUsesVY) c.V[c.X] = c.V[c.Y]; c.V[0xF] = (c.V[c.X] & MSB) ? 1 : 0; c.V[c.X] <<= 1; } }, // SHR:  8XYE - Set Vx = Vx << 1 (Vx is multiplied by 2). If the most significant bit of Vx is 1, then VF is set to 1, otherwise 0.
+};
+
+const std::map<twoByte, Chip8::MapHandler> Chip8::opCodeETable
+{
+    { 0x009E, [](Chip8& c) { c.PC += (c.isKeyPressed(c.V[c.X]))  ? 4 : 2; } }, // SKP:  EX9E - Skip the next instruction if the key stored in Vx is pressed.
+    { 0x00A1, [](Chip8& c) { c.PC += (!c.isKeyPressed(c.V[c.X])) ? 4 : 2; } }, // SKNP: EXA1 - Skip next instruction if key stored in Vx is not pressed.
+};
+
+const std::map<twoByte, Chip8::MapHandler> Chip8::opCodeFTable
+{
+    { 0x0007, [](Chip8& c) { c.V[c.X] = c.delayTimer;                                                                                      c.PC += 2; } }, // LD:  FX07 - Set Vx = delay timer value.
+    { 0x000A, [](Chip8& c) { if (c.keys != 0) { c.V[c.X] = c.firstPressedKey();                                                           c.PC += 2; } } }, // LD:  FX0A - If a key is pressed, store the value of the key in Vx.
+    { 0x0015, [](Chip8& c) { c.delayTimer = c.V[c.X];                                                                                      c.PC += 2; } }, // LD:  FX15 - Set delay timer = Vx.
+    { 0x0018, [](Chip8& c) { c.soundTimer = c.V[c.X];                                                                                      c.PC += 2; } }, // LD:  FX18 - Set sound timer = Vx.
+    { 0x001E, [](Chip8& c) { const twoByte result = c.I + c.V[c.X]; c.V[0xF] = (result > 0xFFF) ? 1 : 0; c.I += c.V[c.X];                 c.PC += 2; } }, // ADD: FX1E - Set I = I + Vx.
+    { 0x0029, [](Chip8& c) { c.I = c.V[c.X] * 5;                                                                                           c.PC += 2; } }, // LD:  FX29 - Sets I = location of the sprite for the character in Vx. Characters 0-F (in hex) are represented by a 4x5 font
+    { 0x0033, [](Chip8& c) { c.memory[c.I] = c.V[c.X] / 100; c.memory[c.I + 1] = (c.V[c.X] / 10) % 10; c.memory[c.I + 2] = (c.V[c.X] % 100) % 10; c.PC += 2; } }, // LD:  FX33 - Store the BCD representation (https://en.wikipedia.org/wiki/Binary-coded_decimal) of Vx in memory locations I, I+1, and I+2.
+    { 0x0055, [](Chip8& c) { std::copy_n(c.V.begin(),            c.X + 1, c.memory.begin() + c.I); if (c.quirks.loadStoreIncrementsI) c.I += c.X + 1; c.PC += 2; } }, // LD:  FX55 - Store registers V0 through Vx in memory starting at location I.
+    { 0x0065, [](Chip8& c) { std::copy_n(c.memory.begin() + c.I, c.X + 1, c.V.begin());            if (c.quirks.loadStoreIncrementsI) c.I += c.X + 1; c.PC += 2; } }, // LD:  FX65 - Fill registers V0 through Vx from memory starting at location I.
+    { 0x0002, [](Chip8& c) { if (c.quirkProfile != QuirkProfile::XoChip) { c.trap(c.opCode); return; } c.loadAudioPattern(); c.PC += 2; } }, // AUDIO: F002 - XO-CHIP only, load the 16 byte audio pattern from memory starting at location I.
+    { 0x003A, [](Chip8& c) { if (c.quirkProfile != QuirkProfile::XoChip) { c.trap(c.opCode); return; } c.audioPitch = c.V[c.X];                                                      c.PC += 2; } }, // PITCH: FX3A - XO-CHIP only, set the audio pattern playback pitch to Vx.
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
 Chip8::Chip8()
-    : randomGenerator(std::random_device()())
-    , randomDistribution(0, 0xFF)
+    : Chip8(std::random_device()())
 {
     
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
+Chip8::Chip8(unsigned int randomSeed)
+    : Chip8State()
+    , Chip8Operands()
+    , core(&getCore(quirkProfile))
+{
+    setRandomSeed(randomSeed);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Chip8::~Chip8() = default;
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::setRandomSeed(unsigned int randomSeed)
+{
+    // xorshift32 never leaves the zero state, spread the seed with a splitmix32 step instead.
+    std::uint32_t seed = randomSeed + 0x9E3779B9u;
+    seed = (seed ^ (seed >> 16)) * 0x85EBCA6Bu;
+    seed = (seed ^ (seed >> 13)) * 0xC2B2AE35u;
+    seed =  seed ^ (seed >> 16);
+
+    randomState = (seed != 0) ? seed : 0x9E3779B9u;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Chip8::Chip8(const Chip8& other)
+    : Chip8State(other)
+    , Chip8Operands(other)
+    , dispatchMode(other.dispatchMode)
+    , quirkProfile(other.quirkProfile)
+    , quirks(other.quirks)
+    , core(other.core)
+    , idleSkipping(other.idleSkipping)
+    , skippedCycles(other.skippedCycles)
+    , trapped(other.trapped)
+    , trappedOpCode(other.trappedOpCode)
+    , dirtyRows(other.dirtyRows)
+    , takenDisplay(other.takenDisplay)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Chip8& Chip8::operator=(const Chip8& other)
+{
+    if (this == &other)
+        return *this;
+
+    static_cast<Chip8State&>(*this)    = other;
+    static_cast<Chip8Operands&>(*this) = other;
+
+    dispatchMode  = other.dispatchMode;
+    quirkProfile  = other.quirkProfile;
+    quirks        = other.quirks;
+    core          = other.core;
+    idleSkipping  = other.idleSkipping;
+    skippedCycles = other.skippedCycles;
+    trapped       = other.trapped;
+    trappedOpCode = other.trappedOpCode;
+    dirtyRows     = other.dirtyRows;
+    takenDisplay  = other.takenDisplay;
+
+    // Blocks decoded from the previous memory contents are stale now.
+    flushBlockCache();
+
+    return *this;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Chip8::Chip8(Chip8&&) noexcept = default;
+Chip8& Chip8::operator=(Chip8&&) noexcept = default;
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Chip8::parseDispatchMode(const std::string& name, DispatchMode& mode)
+{
+    if (name == "map")
+        mode = DispatchMode::OpCodeMap;
+    else if (name == "table")
+        mode = DispatchMode::JumpTable;
+    else if (name == "blocks")
+        mode = DispatchMode::CachedBlocks;
+    else
+        return false;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::setDispatchMode(DispatchMode mode)
+{
+    dispatchMode = mode;
+
+    // Other engines don't keep the cache coherent with memory writes, the next blocks run starts from an empty one.
+    blockCache.reset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Chip8::parseQuirkProfile(const std::string& name, QuirkProfile& profile)
+{
+    if (name == "chip8")
+        profile = QuirkProfile::Chip8;
+    else if (name == "vip")
+        profile = QuirkProfile::CosmacVip;
+    else if (name == "schip")
+        profile = QuirkProfile::SuperChip;
+    else if (name == "xochip")
+        profile = QuirkProfile::XoChip;
+    else
+        return false;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::setQuirkProfile(QuirkProfile profile)
+{
+    quirkProfile = profile;
+    quirks       = getQuirks(profile);
+    core         = &getCore(profile);
+
+    // Cached blocks point to the handlers of the previous core.
+    flushBlockCache();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 bool Chip8::loadGame(const std::string& name)
 {
-    // Open file in bynary mode
-    std::ifstream inputFileStream(name, std::ios::binary);
+    // Open file in bynary mode, at the end to get its size
+    std::ifstream inputFileStream(name, std::ios::binary | std::ios::ate);
 
     if (inputFileStream.fail())
         return false;
 
-    // Load the game in memory from location: 0x200
-    unsigned int i = 0x200;
-    char currentFileByte;
+    // Games bigger than the program area would write past the end of memory
+    const std::streamoff size = inputFileStream.tellg();
 
-    while (inputFileStream.read(&currentFileByte, sizeof(currentFileByte)))
+    if (size < 0 || size > static_cast<std::streamoff>(c_maxRomSize))
+        return false;
+
+    // Load the game in memory from location: 0x200, in one read
+    inputFileStream.seekg(0);
+
+    if (!inputFileStream.read(reinterpret_cast<char*>(&memory[c_programStart]), size))
+        return false;
+
+    flushBlockCache();
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Chip8::loadGame(const std::vector<byte>& rom)
+{
+    // Load an already read game in memory from location: 0x200
+    if (rom.size() > c_maxRomSize)
+        return false;
+
+    std::copy(rom.begin(), rom.end(), memory.begin() + c_programStart);
+
+    flushBlockCache();
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::loadState(const Chip8State& snapshot)
+{
+    static_cast<Chip8State&>(*this) = snapshot;
+
+    dirtyRows = ~0u;
+
+    // Memory may hold different code now.
+    flushBlockCache();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    struct SaveStateHeader
     {
-        memory[i] = currentFileByte;
-        ++i;
-    }
+        std::uint32_t magic;
+        std::uint16_t version;
+        std::uint16_t reserved;
+        std::uint32_t stateSize;
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::vector<byte> Chip8::saveState() const
+{
+    const SaveStateHeader header = { c_saveStateMagic, c_saveStateVersion, 0, sizeof(Chip8State) };
+
+    std::vector<byte> blob(sizeof(SaveStateHeader) + sizeof(Chip8State));
+    std::memcpy(blob.data(), &header, sizeof(SaveStateHeader));
+    std::memcpy(blob.data() + sizeof(SaveStateHeader), static_cast<const Chip8State*>(this), sizeof(Chip8State));
+
+    return blob;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Chip8::loadState(const std::vector<byte>& blob)
+{
+    if (blob.size() != sizeof(SaveStateHeader) + sizeof(Chip8State))
+        return false;
+
+    SaveStateHeader header;
+    std::memcpy(&header, blob.data(), sizeof(SaveStateHeader));
+
+    if (header.magic != c_saveStateMagic || header.version != c_saveStateVersion || header.stateSize != sizeof(Chip8State))
+        return false;
+
+    Chip8State snapshot;
+    std::memcpy(&snapshot, blob.data() + sizeof(SaveStateHeader), sizeof(Chip8State));
+
+    loadState(snapshot);
 
     return true;
 }
@@ -36,10 +553,11 @@ bool Chip8::loadGame(const std::string& name)
 void Chip8::initialize()
 {
     // Clear stack, V registers, memory and display
-    stack = std::stack<twoByte>();
+    stack.fill(0);
+    SP = 0;
     V.fill(0);
     memory.fill(0);
-    display.resize(c_displaySize, 0);
+    display.fill(0);
 
     // Initialize opcode accessors  
     opCode = 0;
@@ -53,10 +571,13 @@ void Chip8::initialize()
     PC = 0x200;
     I  = 0;
 
-    // Reset timers
+    // Reset timers and audio
     delayTimer = 0;
     soundTimer = 0;
 
+    audioPattern.fill(0);
+    audioPitch = 64;
+
     // Load Font Set into memory
     // Fontset examples:
     //  HEX     BIN          RESULT      HEX     BIN         RESULT
@@ -88,19 +609,69 @@ void Chip8::initialize()
     std::copy(fontSet.begin(), fontSet.end(), memory.begin());
 
     // Reset Draw Flag
-    drawFlag = true;
+    drawFlag  = true;
+    vblank    = false;
+    dirtyRows = ~0u;
+
+    flushBlockCache();
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
 void Chip8::emulateCycle()
 {
+#ifdef CHIP8_DEBUGGER
+    if (debugger)
+    {
+        runDebugged(1);
+        return;
+    }
+#endif
+
+    if (dispatchMode == DispatchMode::CachedBlocks)
+    {
+        runCachedBlocks(1);
+        return;
+    }
+
     fetchOpcode();
     decodeAndExecuteOpcode();
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
+void Chip8::emulateCycles(unsigned int count)
+{
+#ifdef CHIP8_DEBUGGER
+    if (debugger)
+    {
+        runDebugged(count);
+        return;
+    }
+#endif
+
+    if (dispatchMode == DispatchMode::CachedBlocks)
+    {
+        runCachedBlocks(count);
+        return;
+    }
+
+    while (count > 0)
+    {
+        const twoByte pc = PC;
+
+        fetchOpcode();
+        decodeAndExecuteOpcode();
+        --count;
+
+        // Idle waits only start where an instruction stays put or jumps back.
+        if (PC <= pc && idleSkipping)
+            skipIdleCycles(pc, count);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 void Chip8::fetchOpcode()
 {
     // Op-Code structure example:   |   Shift memory[PC] to the left 8 bits:   |    Bitwise OR with memory[PC + 1]:
@@ -108,7 +679,7 @@ void Chip8::fetchOpcode()
     // memory[PC]     == 0xA2       |   10100010   1010001000000000     BIN    |            11110000 =  0x00F0
     // memory[PC + 1] == 0xF0       |                                          |    ------------------
     //                              |                                          |    1010001011110000    0xA2F0
-    opCode = memory[PC] << 8 | memory[PC + 1];
+    opCode = readInstruction(PC);
 
     NNN = opCode & 0x0FFF;
     NN  = opCode & 0x00FF;
@@ -121,53 +692,526 @@ void Chip8::fetchOpcode()
 
 void Chip8::decodeAndExecuteOpcode()
 {
+    CHIP8_PROFILE_INSTRUCTION(opCode);
+    CHIP8_TRACE_INSTRUCTION(opCode);
+
+    if (dispatchMode != DispatchMode::OpCodeMap)
+    {
+        core->primary[opCode >> 12](*this, *this);
+        return;
+    }
+
     const twoByte instructionIndex = opCode & 0xF000;
-    opCodesTable[instructionIndex]();
+    dispatch(opCodesTable, instructionIndex);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::runCachedBlocks(unsigned int count)
+{
+    if (!blockCache)
+        blockCache = std::make_unique<BlockCache>();
+
+    BlockCache& cache = *blockCache;
+
+    int previousIndex = cache.lastBlock;
+
+    while (count > 0)
+    {
+        int blockIndex = BlockCache::c_noBlock;
+
+        if (previousIndex != BlockCache::c_noBlock)
+        {
+            const BlockCache::Block& previous = cache.blocks[previousIndex];
+
+            // Links to dropped blocks are cut when they are dropped.
+            if (previous.successorPC == PC)
+                blockIndex = previous.successor;
+        }
+
+        if (blockIndex == BlockCache::c_noBlock)
+        {
+            const twoByte address = PC & (c_memorySize - 1);
+
+            blockIndex = cache.blockAt[address];
+
+            if (blockIndex == BlockCache::c_noBlock)
+            {
+                blockIndex = translateBlock(address);
+
+                // With a previous block the new one can only be the first when the cache started over.
+                if (blockIndex == 0)
+                    previousIndex = BlockCache::c_noBlock;
+            }
+
+            if (previousIndex != BlockCache::c_noBlock)
+            {
+                BlockCache::Block& previous = cache.blocks[previousIndex];
+                previous.successorPC = PC;
+                previous.successor   = blockIndex;
+            }
+        }
+
+        // Run the block, or what the cycle budget allows of it, until a taken skip leaves the straight-line path.
+        // Stores end a block, so any invalidation they cause happens after the last instruction read from the block.
+        const BlockCache::Block& block = cache.blocks[blockIndex];
+        const unsigned int numInstructions = std::min(block.numInstructions, count);
+        const BlockCache::Instruction* instruction = &cache.instructions[block.firstInstruction];
+
+        // PC is only wrapped for the lookup, past the end of memory the block runs at the unwrapped addresses.
+        unsigned int executed = 0;
+        twoByte nextPC = PC;
+
+        while (executed < numInstructions && PC == nextPC)
+        {
+            CHIP8_PROFILE_INSTRUCTION(instruction->operands.opCode);
+            CHIP8_TRACE_INSTRUCTION(instruction->operands.opCode);
+
+            instruction->handler(*this, instruction->operands);
+
+            ++instruction;
+            ++executed;
+            nextPC += 2;
+        }
+
+        count -= executed;
+        previousIndex = blockIndex;
+
+        // Blocks hold at least one instruction and start at PC, so one always runs. The last one counts as fetched,
+        // for getOpCode() and the idle check.
+        if (executed == 0)
+            break;
+
+        opCode = instruction[-1].operands.opCode;
+
+        if (PC <= nextPC - 2 && idleSkipping)
+            skipIdleCycles(static_cast<twoByte>(nextPC - 2), count);
+    }
+
+    cache.lastBlock = previousIndex;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int Chip8::translateBlock(twoByte address)
+{
+    BlockCache& cache = *blockCache;
+
+    if (cache.instructions.size() > BlockCache::c_maxCachedInstructions)
+        cache.clear();
+
+    // Decode straight-line instructions until one that ends the block.
+    BlockCache::Block block = {};
+    block.start            = address;
+    block.firstInstruction = static_cast<unsigned int>(cache.instructions.size());
+    block.successorPC      = BlockCache::c_noBlock;
+    block.successor        = BlockCache::c_noBlock;
+
+    unsigned int end = address;
+
+    // Blocks stop at the end of memory. One starting at the last address still holds its instruction, whose
+    // second byte wraps around to address 0 as fetchOpcode() reads it.
+    while (block.numInstructions < BlockCache::c_maxBlockLength)
+    {
+        BlockCache::Instruction instruction;
+        instruction.operands = decode(readInstruction(end));
+        instruction.handler  = core->resolve(instruction.operands.opCode);
+
+        cache.instructions.push_back(instruction);
+        ++block.numInstructions;
+        end += 2;
+
+        if (core->endsBlock(instruction.handler) || end >= c_memorySize)
+            break;
+    }
+
+    block.end = static_cast<twoByte>(end);
+
+    for (unsigned int covered = block.start; covered < block.end; ++covered)
+        ++cache.codeMap[covered & (c_memorySize - 1)];
+
+    const int blockIndex = static_cast<int>(cache.blocks.size());
+    cache.blocks.push_back(block);
+    cache.blockAt[address] = blockIndex;
+
+    return blockIndex;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef CHIP8_DEBUGGER
+void Chip8::runDebugged(unsigned int count)
+{
+    // One instruction at a time, the cached blocks engine runs its instructions through the jump table.
+    while (count > 0)
+    {
+        if (debugger->checkInstruction(describeNextInstruction()))
+            return;
+
+        fetchOpcode();
+        decodeAndExecuteOpcode();
+        --count;
+
+        debugger->onExecuted(PC, SP);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Debugger::Instruction Chip8::describeNextInstruction() const
+{
+    Debugger::Instruction instruction = {};
+    instruction.pc           = PC;
+    instruction.opCode       = readInstruction(PC);
+    instruction.stackPointer = SP;
+    instruction.defined      = core->isDefined(instruction.opCode);
+    instruction.accessStart  = I;
+
+    const byte x = (instruction.opCode & 0x0F00) >> 8;
+
+    // The memory the instruction will read or write, as its handler does it.
+    switch (instruction.opCode & 0xF0FF)
+    {
+        case 0xF033: instruction.access = Debugger::Write; instruction.accessLength = 3;                    break;
+        case 0xF055: instruction.access = Debugger::Write; instruction.accessLength = x + 1;                break;
+        case 0xF065: instruction.access = Debugger::Read;  instruction.accessLength = x + 1;                break;
+        case 0xF002: instruction.access = Debugger::Read;  instruction.accessLength = c_audioPatternSize;   break;
+
+        default:
+        {
+            // DXYN reads its rows, the ones clipping keeps, unless it waits for the vertical blank.
+            if ((instruction.opCode & 0xF000) != 0xD000 || (quirks.displayWait && !vblank))
+                break;
+
+            const unsigned int yStart = V[(instruction.opCode & 0x00F0) >> 4] % c_displayHeight;
+            const unsigned int numRows = instruction.opCode & 0x000F;
+
+            instruction.access       = Debugger::Read;
+            instruction.accessLength = quirks.clipSprites ? std::min(numRows, c_displayHeight - yStart) : numRows;
+            break;
+        }
+    }
+
+    if (!instruction.defined)
+        instruction.accessLength = 0;
+
+    return instruction;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Chip8::isIdleLoopBody(twoByte start, twoByte jump) const
+{
+    const unsigned int length = jump - start;   // start is before jump.
+
+    if ((length & 1) != 0 || length > 2 * (c_maxIdleLoopLength - 1))
+        return false;
+
+    // Instructions that only read registers, timers, keys or memory, and only write V, I and the timers.
+    // None of them jumps: a pass through the body moves forward until the jump back or out past it.
+    for (unsigned int address = start; address < jump; address += 2)
+    {
+        const twoByte instruction = readInstruction(address);
+
+        switch (instruction >> 12)
+        {
+            case 0x3: case 0x4: case 0x5: case 0x6: case 0x7: case 0x9: case 0xA:
+                break;
+
+            case 0x8:
+                if ((instruction & 0x000F) > 0x7 && (instruction & 0x000F) != 0xE)
+                    return false;
+                break;
+
+            case 0xE:
+                if ((instruction & 0x00FF) != 0x9E && (instruction & 0x00FF) != 0xA1)
+                    return false;
+                break;
+
+            case 0xF:
+                switch (instruction & 0x00FF)
+                {
+                    case 0x07: case 0x15: case 0x18: case 0x1E: case 0x29: case 0x65:
+                        break;
+
+                    default:
+                        return false;
+                }
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::skipIdleCycles(twoByte pc, unsigned int& count)
+{
+    // pc is the address of the instruction just executed (opCode), which left PC at or before it. Keys,
+    // timers and vblank are constant until emulateCycles() returns.
+#ifdef CHIP8_PROFILER
+    if (profiler)
+        return;
+#endif
+
+#ifdef CHIP8_TRACER
+    if (tracer)
+        return;
+#endif
+
+    if (PC == pc)
+    {
+        // FX0A without a key, DXYN waiting for the vertical blank or a jump to itself: nothing changes any more.
+        // Calls and returns that land on themselves still move the stack pointer.
+        if ((opCode & 0xF000) != 0x2000 && opCode != 0x00EE)
+        {
+            skippedCycles += count;
+            count = 0;
+        }
+
+        return;
+    }
+
+    if ((opCode & 0xF000) != 0x1000 || !isIdleLoopBody(PC, pc))
+        return;
+
+    // A jump back to a short loop without side effects. Run one pass for real: if it stays in the loop and
+    // reaches the jump again with the same registers and timers, the machine is exactly where it was when
+    // the pass started, and every following pass repeats it.
+    const twoByte start = PC;
+    const std::array<byte, c_numRegisters> startV = V;
+    const twoByte startI          = I;
+    const byte    startDelayTimer = delayTimer;
+    const byte    startSoundTimer = soundTimer;
+
+    unsigned int period = 0;
+
+    while (count > 0 && PC >= start && PC <= pc)
+    {
+        const twoByte address = PC;
+
+        fetchOpcode();
+        decodeAndExecuteOpcode();
+        --count;
+        ++period;
+
+        if (address == pc)
+        {
+            if (V == startV && I == startI && delayTimer == startDelayTimer && soundTimer == startSoundTimer)
+            {
+                const unsigned int skipped = count - count % period;
+
+                skippedCycles += skipped;
+                count         -= skipped;
+            }
+
+            return;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::invalidateCode(unsigned int address, unsigned int length)
+{
+    if (!blockCache)
+        return;
+
+    BlockCache& cache = *blockCache;
+    const unsigned int end = std::min(address + length, c_memorySize);
+
+    bool touchesCode = false;
+
+    for (unsigned int i = address; i < end; ++i)
+        touchesCode |= (cache.codeMap[i] != 0);
+
+    if (!touchesCode)
+        return;
+
+    // Drop every block overlapping the written range, the translation is redone on the next visit.
+    for (std::size_t blockIndex = 0; blockIndex < cache.blocks.size(); ++blockIndex)
+    {
+        BlockCache::Block& block = cache.blocks[blockIndex];
+
+        // Skip blocks already dropped and the ones outside the range. Only the block at the last address goes
+        // past the end, by the byte it reads at address 0.
+        const bool overlaps = (block.end > address && block.start < end) || (block.end > c_memorySize && address < block.end - c_memorySize);
+
+        if (block.dropped || !overlaps)
+            continue;
+
+        block.dropped = true;
+        cache.blockAt[block.start] = BlockCache::c_noBlock;
+
+        for (unsigned int covered = block.start; covered < block.end; ++covered)
+            --cache.codeMap[covered & (c_memorySize - 1)];
+    }
+
+    for (BlockCache::Block& block : cache.blocks)
+    {
+        if (block.successor != BlockCache::c_noBlock && cache.blocks[block.successor].dropped)
+        {
+            block.successorPC = BlockCache::c_noBlock;
+            block.successor   = BlockCache::c_noBlock;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::flushBlockCache()
+{
+    if (blockCache)
+        blockCache->clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::trap(twoByte undefinedOpCode)
+{
+    // Skip the undefined instruction and keep running, the caller can inspect the trap.
+    trapped       = true;
+    trappedOpCode = undefinedOpCode;
+    PC += 2;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
 void Chip8::updateTimers(bool& playSound)
 {
+    vblank = true;
+
     if (delayTimer > 0)
         --delayTimer;
 
     if (soundTimer > 0)
-    {
-        if (soundTimer == 1)
-            playSound = true;
-
         --soundTimer;
-    }
+
+    // The buzzer sounds for as many ticks as the value the sound timer was set to.
+    playSound = (soundTimer > 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Chip8::hasAudioPattern() const
+{
+    return std::any_of(audioPattern.begin(), audioPattern.end(), [](byte value) { return value != 0; });
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
 void Chip8::draw()
+{
+    if (quirks.clipSprites)
+        drawSprite<true>(X, Y, N);
+    else
+        drawSprite<false>(X, Y, N);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<bool ClipSprites>
+void Chip8::drawSprite(byte x, byte y, byte rows)
 {
     V[0xF] = 0;
 
-    for (unsigned int yPos = 0; yPos < N; ++yPos)
+    // The start position always wraps. Then, wrapping sprites continue on the other side: rows modulo the
+    // height, columns by rotating the row word. Clipped sprites lose what is past the right and bottom edges.
+    const unsigned int xStart = V[x] % c_displayWidth;
+    const unsigned int yStart = V[y] % c_displayHeight;
+
+    const unsigned int numRows = ClipSprites ? std::min<unsigned int>(rows, c_displayHeight - yStart) : rows;
+
+    for (unsigned int yPos = 0; yPos < numRows; ++yPos)
     {
-        const byte rowDrawStart = memory[I + yPos];
-        const unsigned int spritePos1D = V[X] + (V[Y] + yPos) * c_displayWidth; // 2D to 1D indexing
+        // Place the 8 pixels of the sprite row at the top of the word and move them to their column.
+        const std::uint64_t spriteRow = static_cast<std::uint64_t>(memory[I + yPos]) << (c_displayWidth - 8);
+        const std::uint64_t pixels    = ClipSprites ? (spriteRow >> xStart)
+                                                    : (spriteRow >> xStart) | (spriteRow << ((c_displayWidth - xStart) % c_displayWidth));
+
+        const unsigned int row = (yStart + yPos) % c_displayHeight;
+        std::uint64_t& displayRow = display[row];
+
+        // Register collision
+        if (displayRow & pixels)
+            V[0xF] = 1;
+
+        // Set pixels (XOR)
+        displayRow ^= pixels;
+        dirtyRows  |= 1u << row;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::clearDisplay()
+{
+    for (unsigned int row = 0; row < c_displayHeight; ++row)
+    {
+        if (display[row] != 0)
+            dirtyRows |= 1u << row;
+
+        display[row] = 0;
+    }
+}
 
-        for (unsigned int xPos = 0; xPos < 8; ++xPos)
+/////////////////////////////////////////////////////////////////////////////
+
+std::uint32_t Chip8::takeChangedRows()
+{
+    std::uint32_t changedRows = 0;
+
+    for (unsigned int row = 0; row < c_displayHeight; ++row)
+    {
+        if ((dirtyRows & (1u << row)) && display[row] != takenDisplay[row])
         {
-            // Check if the current evaluated pixel is set to 1 (check bit from MSB to LSB each iteration)
-            if ((rowDrawStart & (MSB >> xPos)) != 0)
-            {
-                const unsigned int pixelPos = (spritePos1D + xPos) % c_displaySize;
+            changedRows |= 1u << row;
+            takenDisplay[row] = display[row];
+        }
+    }
 
-                // Register collision
-                if (display[pixelPos] == 0xFF)
-                    V[0xF] = 1;
+    dirtyRows = 0;
 
-                // Set pixel (XOR)
-                display[pixelPos] ^= 0xFF;
-            }
+    return changedRows;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Chip8::expandDisplay(const DisplayRows& rows, std::vector<byte>& pixels)
+{
+    pixels.resize(c_displaySize);
+
+    for (unsigned int y = 0; y < c_displayHeight; ++y)
+    {
+        const std::uint64_t row = rows[y];
+
+        for (unsigned int x = 0; x < c_displayWidth; ++x)
+            pixels[y * c_displayWidth + x] = ((row >> (c_displayWidth - 1 - x)) & 1) ? 0xFF : 0x00;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::uint64_t Chip8::hashDisplay(const DisplayRows& rows)
+{
+    // FNV-1a over the framebuffer, used to compare runs without keeping the frames around.
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (const std::uint64_t row : rows)
+    {
+        for (unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            hash ^= (row >> shift) & 0xFF;
+            hash *= 0x100000001B3ull;
         }
     }
+
+    return hash;
 }
 
 /////////////////////////////////////////////////////////////////////////////
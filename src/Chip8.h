@@ -1,13 +1,24 @@
 #pragma once
 #include <array>
+#include <cstdint>
 #include <functional>
 #include <map>
-#include <random>
-#include <stack>
+#include <memory>
+#include <string>
 #include <vector>
+#include "Chip8State.h"
 
-typedef unsigned char  byte;
-typedef unsigned short twoByte;
+#ifdef CHIP8_PROFILER
+#include "Profiler.h"
+#endif
+
+#ifdef CHIP8_DEBUGGER
+#include "Debugger.h"
+#endif
+
+#ifdef CHIP8_TRACER
+#include "Tracer.h"
+#endif
 
 // Resources:
 // https://en.wikipedia.org/wiki/CHIP-8
@@ -16,132 +27,341 @@ typedef unsigned short twoByte;
 // http://mattmik.com/files/chip8/mastering/chip8.html
 // https://www.youtube.com/watch?v=rpLoS7B6T94
 
-class Chip8
+// Fields of one decoded instruction. Chip8 keeps the last fetched one in this base, cached blocks keep one per
+// instruction, and the jump table handlers read whichever they are given.
+struct Chip8Operands
+{
+    twoByte opCode;     // The instruction to execute by the interpreter
+
+    twoByte NNN;        // NNN - A 12 bit value, the lowest 12 bits of the instruction
+    byte    NN;         // NN  - An 8 bit value, the lowest 8  bits of the instruction
+    byte    N;          // N   - A 4 bit value,  any of the last three 4 bits of the instruction
+    byte    X;          // X   - A 4 bit value,  the lower   4 bits of the high byte of the instruction
+    byte    Y;          // Y   - A 4 bit value,  the upper   4 bits of the low  byte of the instruction
+};
+
+// The machine state lives in the Chip8State base so it can be snapshotted as one block of plain data.
+class Chip8 : private Chip8State, private Chip8Operands
 {
 
 public:
     Chip8();
+    explicit Chip8(unsigned int randomSeed);  // Deterministic instance, doesn't touch std::random_device.
+    ~Chip8();
+
+    // Copies clone the whole machine without any allocation (the block cache is not copied, the copy
+    // rebuilds its own on first use).
+    Chip8(const Chip8& other);
+    Chip8& operator=(const Chip8& other);
+    Chip8(Chip8&&) noexcept;
+    Chip8& operator=(Chip8&&) noexcept;
 
-    // System Specifications:
-    static constexpr unsigned int c_stackLevels   = 16;                                  // The stack is only used to store return addresses when subroutines are called.
-    static constexpr unsigned int c_numRegisters  = 16;                                  // 16 8-bit data registers named from V0 to VF.
-    static constexpr unsigned int c_memorySize    = 4096;                                // 4096 memory locations (4K) of 8 bits (a byte) each. 0x000 - 0x1FF is system reserved, 0x200 - 0xFFF is for program ROM and work RAM.
+    // System Specifications (see Chip8State.h):
+    using Chip8State::c_stackLevels;
+    using Chip8State::c_numRegisters;
+    using Chip8State::c_memorySize;
+    using Chip8State::c_programStart;
+    using Chip8State::c_maxRomSize;
 
-    static constexpr unsigned int c_displayWidth  = 64;
-    static constexpr unsigned int c_displayHeight = 32;
-    static constexpr unsigned int c_displaySize   = c_displayWidth * c_displayHeight;    // Display resolution is 64x32 pixels, color is monochrome.
+    using Chip8State::c_displayWidth;
+    using Chip8State::c_displayHeight;
+    using Chip8State::c_displaySize;
+    using Chip8State::DisplayRows;
+
+    using Chip8State::c_numKeys;
+    using Chip8State::c_fontSetSize;
+    using Chip8State::c_audioPatternSize;
 
-    static constexpr unsigned int c_numKeys       = 16;                                  // Input is done with a hex keyboard that has 16 keys which range from 0 to F.
-    static constexpr unsigned int c_fontSetSize   = 16 * 5;                              // 4x5 pixel font set(0 - F).
-    
     static constexpr byte MSB = 0x80;
     static constexpr byte LSB = 0x01;
 
+    // Opcode dispatch engines, selectable at runtime so they can be A/B compared.
+    enum class DispatchMode
+    {
+        OpCodeMap,      // Reference interpreter: std::map lookups into std::function handlers.
+        JumpTable,      // Two-level table of plain function pointers generated at compile time.
+        CachedBlocks    // Straight-line runs of instructions decoded once into cached basic blocks (direct threaded code).
+    };
+
+    static bool parseDispatchMode(const std::string& name, DispatchMode& mode);    // "map", "table" or "blocks".
+
+    // Behaviours that differ between CHIP-8 interpreters, and that games written for one of them rely on.
+    struct Quirks
+    {
+        bool shiftUsesVY;           // 8XY6/8XYE: Vx = Vy before the shift (COSMAC VIP), otherwise Vx is shifted in place.
+        bool loadStoreIncrementsI;  // FX55/FX65: I is left at I + X + 1 (COSMAC VIP), otherwise I is unchanged.
+        bool clipSprites;           // DXYN: sprites are cut at the screen edges, otherwise they wrap around.
+        bool jumpUsesVX;            // BNNN is BXNN: jump to XNN + Vx (SUPER-CHIP), otherwise to NNN + V0.
+        bool logicResetsVF;         // 8XY1/8XY2/8XY3 clear VF (COSMAC VIP).
+        bool displayWait;           // DXYN waits for the next 60 Hz vertical blank before drawing (COSMAC VIP).
+    };
+
+    // Each profile is a separately compiled core (for the table and blocks engines), no quirk is tested at run time.
+    enum class QuirkProfile
+    {
+        Chip8,          // This emulator's historical behaviour.
+        CosmacVip,      // Original COSMAC VIP interpreter.
+        SuperChip,      // SUPER-CHIP 1.1 (HP48).
+        XoChip          // XO-CHIP (adds the F002 and FX3A audio opcodes).
+    };
+
+    static constexpr Quirks getQuirks(QuirkProfile profile)
+    {
+        //                                          shiftVY  incI   clip   BXNN   VFreset wait
+        switch (profile)
+        {
+            case QuirkProfile::CosmacVip: return { true,   true,  true,  false, true,  true  };
+            case QuirkProfile::SuperChip: return { false,  false, true,  true,  false, false };
+            case QuirkProfile::XoChip:    return { true,   true,  false, false, false, false };
+            default:                      return { false,  true,  false, false, false, false };
+        }
+    }
+
+    static bool parseQuirkProfile(const std::string& name, QuirkProfile& profile);    // "chip8", "vip", "schip" or "xochip".
+
     bool loadGame(const std::string& name);
+    bool loadGame(const std::vector<byte>& rom);
     void initialize();
     void emulateCycle();
+    void emulateCycles(unsigned int count);
 
     void fetchOpcode();
     void decodeAndExecuteOpcode();
-    void updateTimers(bool& playSound);
+    void updateTimers(bool& playSound);     // playSound is set while the sound timer runs, until the next update.
 
-    void draw();
+    void draw();        // DXYN with the current operands, clipped or wrapped as the quirk profile says.
+    void clearDisplay();
 
     constexpr void setDrawFlagFalse()  { drawFlag = false; }
     constexpr bool getDrawFlag() const { return drawFlag;  }
 
-    const std::vector<byte>& getDisplay() const { return display; }
+    // Rows whose pixels differ from the display at the previous call (bit y for row y). Only rows drawn
+    // to or cleared since then are compared, and a sprite erased and redrawn in between cancels out.
+    std::uint32_t takeChangedRows();
 
-    void setKeys(const std::vector<bool>& updatedKeys) { std::copy(updatedKeys.begin(), updatedKeys.end(), keys.begin()); }
+    const DisplayRows& getDisplayRows() const { return display; }
+    void getDisplay(std::vector<byte>& pixels) const { expandDisplay(display, pixels); }
 
-private:
-    twoByte randomNext() { return randomDistribution(randomGenerator); }
+    static void expandDisplay(const DisplayRows& rows, std::vector<byte>& pixels);  // One byte per pixel (0x00 or 0xFF).
+    std::uint64_t getDisplayHash() const { return hashDisplay(display); }
+    static std::uint64_t hashDisplay(const DisplayRows& rows);
 
-    std::mt19937 randomGenerator;
-    std::uniform_int_distribution<twoByte> randomDistribution;
+    // Sound: on while the sound timer is non zero. XO-CHIP games may also load a pattern to play instead of the plain tone.
+    bool isSoundActive() const { return soundTimer > 0; }
+    const std::array<byte, c_audioPatternSize>& getAudioPattern() const { return audioPattern; }
+    byte getAudioPitch() const { return audioPitch; }
+    bool hasAudioPattern() const;
 
-    std::stack<twoByte> stack;
+    const std::array<byte, c_numRegisters>& getRegisters() const { return V; }
+    twoByte getI()  const { return I;  }
+    twoByte getPC() const { return PC; }
+    twoByte getOpCode() const { return opCode; }   // Last fetched instruction.
 
-    std::array<byte, c_numRegisters> V;
-    std::array<byte, c_memorySize>   memory;
-    std::array<bool, c_numKeys>      keys;
+    // Save states. The raw Chip8State copy is the fast path (rewind, checkpoints in memory), the blob
+    // adds a versioned header for storing or sending it. Blobs use the native layout of the build.
+    static constexpr std::uint32_t c_saveStateMagic   = 0x53533843;    // "C8SS"
+    static constexpr std::uint16_t c_saveStateVersion = 3;
 
-    std::vector<byte>  display;
+    const Chip8State& getState() const { return *this; }
+    void saveState(Chip8State& snapshot) const { snapshot = *this; }
+    void loadState(const Chip8State& snapshot);
 
-    twoByte opCode;     // The instruction to execute by the interpreter
+    std::vector<byte> saveState() const;
+    bool loadState(const std::vector<byte>& blob);
 
-    twoByte NNN;        // NNN - A 12 bit value, the lowest 12 bits of the instruction
-    byte    NN;         // NN  - An 8 bit value, the lowest 8  bits of the instruction
-    byte    N;          // N   - A 4 bit value,  any of the last three 4 bits of the instruction
-    byte    X;          // X   - A 4 bit value,  the lower   4 bits of the high byte of the instruction
-    byte    Y;          // Y   - A 4 bit value,  the upper   4 bits of the low  byte of the instruction
+    // Independent copy of the running machine, continuing from exactly this point (see PagedSnapshot.h to
+    // keep many branched states in memory).
+    Chip8 fork() const { return *this; }
+
+    void setKeys(twoByte keyMask) { keys = keyMask; }     // Bit k set while key k is pressed.
+    void setRandomSeed(unsigned int randomSeed);         // Restarts the CXNN generator as Chip8(randomSeed) starts it.
+
+    void setDispatchMode(DispatchMode mode);
+    DispatchMode getDispatchMode() const     { return dispatchMode; }
+
+    // Usually chosen when loading a game, from the profile its hash has in the ROM library index.
+    void setQuirkProfile(QuirkProfile profile);
+    QuirkProfile getQuirkProfile() const     { return quirkProfile; }
+
+    // Idle skipping: FX0A waiting for a key, DXYN waiting for the vertical blank and short loops that only
+    // poll the delay timer or the keys can't get anywhere before the next updateTimers() or setKeys(), so
+    // emulateCycles() skips the rest of its count once it finds the machine in one. The state afterwards
+    // is bit identical to running every instruction. Off while a profiler or a tracer is attached.
+    void setIdleSkipping(bool enabled)     { idleSkipping = enabled; }
+    bool getIdleSkipping() const           { return idleSkipping; }
+    std::uint64_t getSkippedCycles() const { return skippedCycles; }     // Instructions skipped so far.
 
-    twoByte PC;         // PC - Program Counter
-    twoByte I;          // I  - 16bit register (For memory address) (Similar to void pointer)
+    // An undefined opcode doesn't stop the machine: it is skipped and remembered here.
+    bool    hasTrapped() const       { return trapped; }
+    twoByte getTrappedOpCode() const { return trappedOpCode; }
+    void    clearTrap()              { trapped = false; }
 
-    byte delayTimer;    // Delay timer: This timer is intended to be used for timing the events of games. Its value can be set and read. Count down at 60 hertz, until they reach 0.
-    byte soundTimer;    // Sound timer: This timer is used for sound effects. When its value is nonzero, a beeping sound is made. Count down at 60 hertz, until they reach 0.
+#ifdef CHIP8_PROFILER
+    // Every instruction executed from now on is reported to profiler (nullptr to stop). Not copied by fork().
+    void setProfiler(Profiler* newProfiler) { profiler = newProfiler; }
+    Profiler* getProfiler() const           { return profiler; }
+#endif
 
-    bool drawFlag;      // Since the system doesn't draw every cycle, we need to set a draw flag to update the screen.
+#ifdef CHIP8_DEBUGGER
+    // While attached (nullptr to detach), emulateCycles() runs one checked instruction at a time and returns
+    // early when the debugger stops, idle skipping is off. Not copied by fork().
+    void setDebugger(Debugger* newDebugger) { debugger = newDebugger; }
+    Debugger* getDebugger() const           { return debugger; }
+#endif
 
+#ifdef CHIP8_TRACER
+    // Every instruction executed from now on is recorded by tracer (nullptr to stop), idle skipping is off.
+    // Call Tracer::finish() with getState() to complete the last record. Not copied by fork().
+    void setTracer(Tracer* newTracer) { tracer = newTracer; }
+    Tracer* getTracer() const         { return tracer; }
+#endif
 
-    // 35 opcodes, all two bytes long.
-    std::map<twoByte, std::function<void()>> opCodesTable
+private:
+    template<QuirkProfile Profile>
+    struct JumpTable;
+    struct BlockCache;
+
+    // Handlers read their operands from here: the jump table engine passes the Chip8Operands base as fetchOpcode()
+    // filled it, cached blocks the copy decoded when they were translated.
+    using Operands = Chip8Operands;
+
+    static constexpr Operands decode(twoByte instruction)
     {
-        { 0x0000, [this]() { opCode0Table[NN]();           PC += 2; } }, // Go to Op-Code table 0 (System Operations) (0x00E0, 0x00EE)
-        { 0x1000, [this]() { PC = NNN;                              } }, // JMP:  1NNN - Jumps to address NNN.
-        { 0x2000, [this]() { stack.push(PC); PC = NNN;              } }, // CALL: 2NNN - Calls subroutine at NNN.
-        { 0x3000, [this]() { PC += (V[X] == NN)   ? 4 : 2;          } }, // SE:   3XNN - Skip next instruction if Vx == NN.
-        { 0x4000, [this]() { PC += (V[X] != NN)   ? 4 : 2;          } }, // SNE:  4XNN - Skip next instruction if Vx != NN.
-        { 0x5000, [this]() { PC += (V[X] == V[Y]) ? 4 : 2;          } }, // SE:   5XY0 - Skip next instruction if Vx == Vy.
-        { 0x6000, [this]() { V[X] = NN;                    PC += 2; } }, // LD:   6XNN - Set Vx = NN
-        { 0x7000, [this]() { V[X] += NN;                   PC += 2; } }, // ADD:  7XNN - Set Vx = Vx + NN. (Carry flag is not changed)
-        { 0x8000, [this]() { opCode8Table[N]();            PC += 2; } }, // Go to Op-Code table 8 (Arithmetic Operations)
-        { 0x9000, [this]() { PC += (V[X] != V[Y]) ? 4 : 2;          } }, // SNE:  9XY0 - Skip next instruction if Vx != Vy.
-        { 0xA000, [this]() { I = NNN;                      PC += 2; } }, // LD:   ANNN - Set I = NNN.
-        { 0xB000, [this]() { PC = NNN + V[0];                       } }, // JMP:  BNNN - PC = NNN + V0.
-        { 0xC000, [this]() { V[X] = randomNext() & NN;     PC += 2; } }, // RND:  CXNN - Set Vx = random() & NN.
-        { 0xD000, [this]() { draw(); drawFlag = true;      PC += 2; } }, // DRW:  DXYN - Draws a sprite at memory location I at coordinate (Vx, Vy) that has a width of 8 pixels and a height of N pixels.
-        { 0xE000, [this]() { opCodeETable[NN]();                    } }, // Go to Op-Code table E (Input Operations)
-        { 0xF000, [this]() { opCodeFTable[NN]();                    } }, // Go to Op-Code table F (System Operations)
-    };
+        return { instruction,
+                 static_cast<twoByte>(instruction & 0x0FFF),
+                 static_cast<byte>(instruction & 0x00FF),
+                 static_cast<byte>(instruction & 0x000F),
+                 static_cast<byte>((instruction & 0x0F00) >> 8),
+                 static_cast<byte>((instruction & 0x00F0) >> 4) };
+    }
+
+    using OpHandler  = void (*)(Chip8&, const Operands&);
+    using MapHandler = std::function<void(Chip8&)>;
 
-    std::map<twoByte, std::function<void()>> opCode0Table
+    // Entry points of the jump table core compiled for one quirk profile.
+    struct Core
     {
-        { 0x00E0, [this]() { std::fill(display.begin(), display.end(), 0); drawFlag = true; } }, // CLS: Clear the display.             
-        { 0x00EE, [this]() { PC = stack.top(); stack.pop();                                 } }, // RET: Return from a subroutine.
+        const OpHandler* primary;               // Indexed by the highest nibble of the opcode.
+        OpHandler (*resolve)(twoByte opCode);   // Final handler of an opcode, for the block translator.
+        bool (*endsBlock)(OpHandler handler);
+        bool (*isDefined)(twoByte opCode);      // False for the opcodes that trap.
     };
 
-    std::map<byte, std::function<void()>> opCode8Table
+    static const Core& getCore(QuirkProfile profile);
+
+    template<bool ClipSprites>
+    void drawSprite(byte x, byte y, byte rows);
+
+    void trap(twoByte undefinedOpCode);
+
+    void runCachedBlocks(unsigned int count);
+    int  translateBlock(twoByte address);
+
+#ifdef CHIP8_DEBUGGER
+    void runDebugged(unsigned int count);
+    Debugger::Instruction describeNextInstruction() const;
+#endif
+
+    static constexpr unsigned int c_maxIdleLoopLength = 8;     // Instructions of a spin loop, its jump back included.
+
+    bool isIdleLoopBody(twoByte start, twoByte jump) const;
+    void skipIdleCycles(twoByte pc, unsigned int& count);
+    void invalidateCode(unsigned int address, unsigned int length);
+    void flushBlockCache();
+
+    template<typename Key>
+    bool dispatch(const std::map<Key, MapHandler>& table, Key key);
+
+    byte randomNext()
     {
-        { 0x0000, [this]() { V[X] = V[Y];                                                 } }, // LD:   8XY0 - Set Vx = Vy.
-        { 0x0001, [this]() { V[X] |= V[Y];                                                } }, // OR:   8XY1 - Set Vx = Vx | Vy.
-        { 0x0002, [this]() { V[X] &= V[Y];                                                } }, // AND:  8XY2 - Set Vx = Vx & Vy.
-        { 0x0003, [this]() { V[X] ^= V[Y];                                                } }, // XOR:  8XY3 - Set Vx = Vx ^ Vy.
-        { 0x0004, [this]() { V[0xF] = ((V[X] + V[Y]) > 0xFF) ? 1 : 0; V[X] += V[Y];       } }, // ADD:  8XY4 - Set Vx = Vx + Vy, set VF = carry.
-        { 0x0005, [this]() { V[0xF] = (V[X] > V[Y]) ? 1 : 0;          V[X] -= V[Y];       } }, // SUB:  8XY5 - Set Vx = Vx - Vy, set VF = NOT borrow.
-        { 0x0006, [this]() { V[0xF] = (V[X] & LSB)  ? 1 : 0;          V[X] >>= 1;         } }, // SHR:  8XY6 - Set Vx = Vx >> 1 (Vx is divided by 2). If the least significant bit of Vx is 1, then VF is set to 1, otherwise 0.
-        { 0x0007, [this]() { V[0xF] = (V[Y] > V[X]) ? 1 : 0;          V[X] = V[Y] - V[X]; } }, // SUBN: 8XY7 - Set Vx = Vy - Vx, set VF = NOT borrow.
-        { 0x000E, [this]() { V[0xF] = (V[X] & MSB)  ? 1 : 0;          V[X] <<= 1;         } }, // SHR:  8XYE - Set Vx = Vx << 1 (Vx is multiplied by 2). If the most significant bit of Vx is 1, then VF is set to 1, otherwise 0.
-    };
+        // xorshift32: state fits in the snapshot and runs are reproducible from the seed.
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return static_cast<byte>(randomState >> 24);
+    }
 
-    std::map<twoByte, std::function<void()>> opCodeETable
+    // XO-CHIP F002: the 16 byte pattern at I, the addresses wrap around memory.
+    void loadAudioPattern()
     {
-        { 0x009E, [this]() { PC += (keys[V[X]])  ? 4 : 2; } }, // SKP:  EX9E - Skip the next instruction if the key stored in Vx is pressed.
-        { 0x00A1, [this]() { PC += (!keys[V[X]]) ? 4 : 2; } }, // SKNP: EXA1 - Skip next instruction if key stored in Vx is not pressed.
-    };
+        for (unsigned int i = 0; i < c_audioPatternSize; ++i)
+            audioPattern[i] = memory[(I + i) & (c_memorySize - 1)];
+    }
 
-    std::map<twoByte, std::function<void()>> opCodeFTable
+    // The instruction at address. The second byte of one at the last address, and code past the end of memory,
+    // wrap around to the start.
+    twoByte readInstruction(unsigned int address) const
     {
-        { 0x0007, [this]() { V[X] = delayTimer;                                                                             PC += 2; } }, // LD: FX07 - Set Vx = delay timer value.
-        { 0x000A, [this]() { auto it = std::find(keys.begin(), keys.end(), true);                                                         
-                             if (it != keys.end()) { V[X] = static_cast<byte>(std::distance(keys.begin(), it)); PC += 2; }           } }, // LD:  FX0A - If a key is pressed, store the value of the key in Vx.
-        { 0x0015, [this]() { delayTimer = V[X];                                                                             PC += 2; } }, // LD:  FX15 - Set delay timer = Vx.
-        { 0x0018, [this]() { soundTimer = V[X];                                                                             PC += 2; } }, // LD:  FX18 - Set sound timer = Vx.
-        { 0x001E, [this]() { const twoByte result = I + V[X]; V[0xF] = (result > 0xFFF) ? 1 : 0; I += V[X];                 PC += 2; } }, // ADD: FX1E - Set I = I + Vx.
-        { 0x0029, [this]() { I = V[X] * 5;                                                                                  PC += 2; } }, // LD:  FX29 - Sets I = location of the sprite for the character in Vx. Characters 0-F (in hex) are represented by a 4x5 font
-        { 0x0033, [this]() { memory[I] = V[X] / 100; memory[I + 1] = (V[X] / 10) % 10; memory[I + 2] = (V[X] % 100) % 10;   PC += 2; } }, // LD:  FX33 - Store the BCD representation (https://en.wikipedia.org/wiki/Binary-coded_decimal) of Vx in memory locations I, I+1, and I+2.
-        { 0x0055, [this]() { std::copy_n(V.begin(),          X + 1, memory.begin() + I); I += X + 1;                        PC += 2; } }, // LD:  FX55 - Store registers V0 through Vx in memory starting at location I.
-        { 0x0065, [this]() { std::copy_n(memory.begin() + I, X + 1, V.begin());          I += X + 1;                        PC += 2; } }, // LD:  FX65 - Fill registers V0 through Vx from memory starting at location I.
-    };
+        return static_cast<twoByte>(memory[address & (c_memorySize - 1)] << 8 | memory[(address + 1) & (c_memorySize - 1)]);
+    }
+
+    bool isKeyPressed(byte key) const { return ((keys >> (key & 0xF)) & 1) != 0; }
+
+    byte firstPressedKey() const
+    {
+        byte key = 0;
+
+        while (key < c_numKeys - 1 && !isKeyPressed(key))
+            ++key;
+
+        return key;
+    }
+
+    void pushStack(twoByte address) { stack[SP & (c_stackLevels - 1)] = address; ++SP; }
+    twoByte popStack()              { --SP; return stack[SP & (c_stackLevels - 1)]; }
+
+    DispatchMode dispatchMode = DispatchMode::JumpTable;
+
+    QuirkProfile quirkProfile = QuirkProfile::Chip8;
+    Quirks       quirks       = getQuirks(QuirkProfile::Chip8);     // Run time copy for the reference map engine.
+    const Core*  core;
+
+    bool          idleSkipping  = true;
+    std::uint64_t skippedCycles = 0;
+
+    bool    trapped       = false;  // Set when an undefined opcode was executed.
+    twoByte trappedOpCode = 0;      // Last undefined opcode executed.
+
+    std::unique_ptr<BlockCache> blockCache;     // Allocated on the first run in DispatchMode::CachedBlocks.
+
+    std::uint32_t dirtyRows = ~0u;              // Rows written by DXYN or CLS since the last takeChangedRows().
+    DisplayRows   takenDisplay = {};            // Display as of the last takeChangedRows().
+
+#ifdef CHIP8_PROFILER
+    Profiler* profiler = nullptr;
+#endif
+
+#ifdef CHIP8_DEBUGGER
+    Debugger* debugger = nullptr;
+#endif
+
+#ifdef CHIP8_TRACER
+    Tracer* tracer = nullptr;
+#endif
+
+    // Reference dispatch tables for DispatchMode::OpCodeMap (defined in Chip8.cpp). They are shared by all
+    // instances and their handlers take the machine to run on, so an instance never points to itself.
+    static const std::map<twoByte, MapHandler> opCodesTable;
+    static const std::map<twoByte, MapHandler> opCode0Table;
+    static const std::map<byte,    MapHandler> opCode8Table;
+    static const std::map<twoByte, MapHandler> opCodeETable;
+    static const std::map<twoByte, MapHandler> opCodeFTable;
 };
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename Key>
+bool Chip8::dispatch(const std::map<Key, MapHandler>& table, Key key)
+{
+    // Look the handler up without inserting an empty entry for undefined opcodes.
+    const auto it = table.find(key);
+
+    if (it == table.end())
+    {
+        trap(opCode);
+        return false;
+    }
+
+    it->second(*this);
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+typedef unsigned char  byte;
+typedef unsigned short twoByte;
+
+// Everything that defines a running CHIP-8 machine. Plain data only: a snapshot is a single memcpy.
+struct Chip8State
+{
+    // System Specifications:
+    static constexpr unsigned int c_stackLevels   = 16;                                  // The stack is only used to store return addresses when subroutines are called.
+    static constexpr unsigned int c_numRegisters  = 16;                                  // 16 8-bit data registers named from V0 to VF.
+    static constexpr unsigned int c_memorySize    = 4096;                                // 4096 memory locations (4K) of 8 bits (a byte) each. 0x000 - 0x1FF is system reserved, 0x200 - 0xFFF is for program ROM and work RAM.
+    static constexpr unsigned int c_programStart  = 0x200;                               // Games are loaded and start executing here.
+    static constexpr unsigned int c_maxRomSize    = c_memorySize - c_programStart;
+
+    static constexpr unsigned int c_displayWidth  = 64;
+    static constexpr unsigned int c_displayHeight = 32;
+    static constexpr unsigned int c_displaySize   = c_displayWidth * c_displayHeight;    // Display resolution is 64x32 pixels, color is monochrome.
+
+    using DisplayRows = std::array<std::uint64_t, c_displayHeight>;                      // One bit per pixel, one word per row. The MSB is the leftmost pixel.
+
+    static constexpr unsigned int c_numKeys       = 16;                                  // Input is done with a hex keyboard that has 16 keys which range from 0 to F.
+    static constexpr unsigned int c_fontSetSize   = 16 * 5;                              // 4x5 pixel font set(0 - F).
+
+    static constexpr unsigned int c_audioPatternSize = 16;                               // XO-CHIP 1-bit audio pattern, 128 samples.
+
+    std::array<byte, c_memorySize>      memory;
+    DisplayRows                         display;
+    std::array<twoByte, c_stackLevels>  stack;      // Return addresses, stack[SP - 1] is the top.
+    std::array<byte, c_numRegisters>    V;
+
+    twoByte keys;           // Keypad state, bit k is set while key k is pressed.
+
+    twoByte PC;             // PC - Program Counter
+    twoByte I;              // I  - 16bit register (For memory address) (Similar to void pointer)
+
+    byte SP;                // Stack pointer: number of return addresses pushed (the call depth).
+
+    byte delayTimer;        // Delay timer: This timer is intended to be used for timing the events of games. Its value can be set and read. Count down at 60 hertz, until they reach 0.
+    byte soundTimer;        // Sound timer: This timer is used for sound effects. When its value is nonzero, a beeping sound is made. Count down at 60 hertz, until they reach 0.
+
+    std::array<byte, c_audioPatternSize> audioPattern;  // XO-CHIP: pattern loaded by F002, all zero until then.
+    byte audioPitch;                                    // XO-CHIP: pattern playback pitch set by FX3A.
+
+    bool drawFlag;          // Since the system doesn't draw every cycle, we need to set a draw flag to update the screen.
+    bool vblank;            // Set by every 60 Hz timer update, taken by DXYN when the display wait quirk is on.
+
+    std::uint32_t randomState;  // xorshift32 generator state used by CXNN, never 0.
+};
+
+static_assert(std::is_trivially_copyable<Chip8State>::value, "Chip8State must stay plain data, snapshots are raw copies");
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cstdio>
+#include "Debugger.h"
+
+Debugger::Debugger()
+    : stopOnUnknownOpCode(true)
+    , mode(Mode::Run)
+    , stopped(false)
+    , resuming(false)
+    , stepsLeft(0)
+    , returnAddress(0)
+    , returnStackPointer(0)
+    , executedInstructions(0)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::setWatchpoint(twoByte address, unsigned int length, Access access, bool enabled)
+{
+    for (unsigned int offset = 0; offset < length; ++offset)
+    {
+        const unsigned int watched = (address + offset) & (Chip8State::c_memorySize - 1);
+
+        if (access & Read)
+            readWatches[watched] = enabled;
+
+        if (access & Write)
+            writeWatches[watched] = enabled;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Debugger::hasWatchpoint(twoByte address, Access access) const
+{
+    const unsigned int watched = address & (Chip8State::c_memorySize - 1);
+
+    return ((access & Read) && readWatches[watched]) || ((access & Write) && writeWatches[watched]);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::pause()
+{
+    if (!stopped)
+        stopAt(StopReason::Pause, stop.pc);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::resume()
+{
+    start(Mode::Run);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::step(unsigned int count)
+{
+    stepsLeft = std::max(count, 1u);
+    start(Mode::Step);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::stepOver(twoByte pc, twoByte opCode, byte stackPointer)
+{
+    if ((opCode & 0xF000) != 0x2000)
+    {
+        step(1);
+        return;
+    }
+
+    // The call returns to the next instruction with the stack back at its current depth.
+    returnAddress      = static_cast<twoByte>(pc + 2);
+    returnStackPointer = stackPointer;
+    start(Mode::StepOver);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::start(Mode newMode)
+{
+    // A pause isn't tied to an instruction, a breakpoint where it happened still counts.
+    mode     = newMode;
+    resuming = stopped && stop.reason != StopReason::Pause;
+    stopped  = false;
+    stop     = Stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::stopAt(StopReason reason, twoByte pc, twoByte opCode, twoByte address)
+{
+    stopped      = true;
+    stop.reason  = reason;
+    stop.pc      = pc;
+    stop.opCode  = opCode;
+    stop.address = address;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Debugger::checkInstruction(const Instruction& instruction)
+{
+    if (stopped)
+        return true;
+
+    // Where a pause() from now on happens.
+    stop.pc = instruction.pc;
+
+    if (resuming)
+    {
+        resuming = false;
+        return false;
+    }
+
+    if (breakpoints[instruction.pc & (Chip8State::c_memorySize - 1)])
+    {
+        stopAt(StopReason::Breakpoint, instruction.pc);
+        return true;
+    }
+
+    if (!instruction.defined && stopOnUnknownOpCode)
+    {
+        stopAt(StopReason::UnknownOpCode, instruction.pc, instruction.opCode);
+        return true;
+    }
+
+    twoByte address = 0;
+
+    if ((instruction.access & Read) && findWatched(readWatches, instruction.accessStart, instruction.accessLength, address))
+    {
+        stopAt(StopReason::ReadWatch, instruction.pc, instruction.opCode, address);
+        return true;
+    }
+
+    if ((instruction.access & Write) && findWatched(writeWatches, instruction.accessStart, instruction.accessLength, address))
+    {
+        stopAt(StopReason::WriteWatch, instruction.pc, instruction.opCode, address);
+        return true;
+    }
+
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Debugger::onExecuted(twoByte pc, byte stackPointer)
+{
+    ++executedInstructions;
+
+    if (mode == Mode::Step && --stepsLeft == 0)
+    {
+        mode = Mode::Run;
+        stopAt(StopReason::Step, pc);
+    }
+    else if (mode == Mode::StepOver && pc == returnAddress && stackPointer == returnStackPointer)
+    {
+        mode = Mode::Run;
+        stopAt(StopReason::Step, pc);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Debugger::findWatched(const AddressBits& watches, unsigned int start, unsigned int length, twoByte& address) const
+{
+    const unsigned int end = std::min(start + length, Chip8State::c_memorySize);
+
+    for (unsigned int watched = start; watched < end; ++watched)
+    {
+        if (watches[watched])
+        {
+            address = static_cast<twoByte>(watched);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::string Debugger::getStopReasonName(StopReason reason)
+{
+    switch (reason)
+    {
+        case StopReason::None:          return "running";
+        case StopReason::Pause:         return "paused";
+        case StopReason::Step:          return "step";
+        case StopReason::Breakpoint:    return "breakpoint";
+        case StopReason::ReadWatch:     return "read watchpoint";
+        case StopReason::WriteWatch:    return "write watchpoint";
+        case StopReason::UnknownOpCode: return "unknown opcode";
+    }
+
+    return "?";
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::string Debugger::disassemble(twoByte opCode, bool jumpUsesVX)
+{
+    const unsigned int x   = (opCode >> 8) & 0xF;
+    const unsigned int y   = (opCode >> 4) & 0xF;
+    const unsigned int n   = opCode & 0xF;
+    const unsigned int nn  = opCode & 0xFF;
+    const unsigned int nnn = opCode & 0xFFF;
+
+    char text[32] = "???";
+
+    switch (opCode >> 12)
+    {
+        case 0x0:
+            if (opCode == 0x00E0)
+                std::snprintf(text, sizeof(text), "CLS");
+            else if (opCode == 0x00EE)
+                std::snprintf(text, sizeof(text), "RET");
+            break;
+
+        case 0x1: std::snprintf(text, sizeof(text), "JMP 0x%03X", nnn);              break;
+        case 0x2: std::snprintf(text, sizeof(text), "CALL 0x%03X", nnn);             break;
+        case 0x3: std::snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, nn);        break;
+        case 0x4: std::snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, nn);       break;
+        case 0x5: if (n == 0) std::snprintf(text, sizeof(text), "SE V%X, V%X", x, y);  break;
+        case 0x6: std::snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, nn);        break;
+        case 0x7: std::snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, nn);       break;
+        case 0x9: if (n == 0) std::snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+        case 0xA: std::snprintf(text, sizeof(text), "LD I, 0x%03X", nnn);            break;
+        case 0xB: std::snprintf(text, sizeof(text), "JMP V%X, 0x%03X", jumpUsesVX ? x : 0, nnn);  break;
+        case 0xC: std::snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, nn);       break;
+        case 0xD: std::snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n);    break;
+
+        case 0x8:
+        {
+            static const char* const c_mnemonics[16] = { "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr };
+
+            if (c_mnemonics[n] != nullptr)
+                std::snprintf(text, sizeof(text), "%s V%X, V%X", c_mnemonics[n], x, y);
+            break;
+        }
+
+        case 0xE:
+            if (nn == 0x9E)
+                std::snprintf(text, sizeof(text), "SKP V%X", x);
+            else if (nn == 0xA1)
+                std::snprintf(text, sizeof(text), "SKNP V%X", x);
+            break;
+
+        case 0xF:
+            switch (nn)
+            {
+                case 0x02: std::snprintf(text, sizeof(text), "AUDIO");                 break;
+                case 0x07: std::snprintf(text, sizeof(text), "LD V%X, DT", x);         break;
+                case 0x0A: std::snprintf(text, sizeof(text), "LD V%X, K", x);          break;
+                case 0x15: std::snprintf(text, sizeof(text), "LD DT, V%X", x);         break;
+                case 0x18: std::snprintf(text, sizeof(text), "LD ST, V%X", x);         break;
+                case 0x1E: std::snprintf(text, sizeof(text), "ADD I, V%X", x);         break;
+                case 0x29: std::snprintf(text, sizeof(text), "LD F, V%X", x);          break;
+                case 0x33: std::snprintf(text, sizeof(text), "LD B, V%X", x);          break;
+                case 0x3A: std::snprintf(text, sizeof(text), "PITCH V%X", x);          break;
+                case 0x55: std::snprintf(text, sizeof(text), "LD [I], V0-V%X", x);     break;
+                case 0x65: std::snprintf(text, sizeof(text), "LD V0-V%X, [I]", x);     break;
+            }
+            break;
+    }
+
+    return text;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,121 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include "Chip8State.h"
+
+// Breakpoints, memory watchpoints and step control for a running Chip8. Chip8 only calls it when built
+// with CHIP8_DEBUGGER defined, otherwise the hooks compile to nothing and attaching a debugger isn't
+// available. While one is attached, emulateCycles() checks every instruction before running it and
+// returns early when the debugger stops; a stopped debugger lets no instruction run until resumed.
+//
+// Breakpoints and watchpoints are one bit per address, a check is a bitmap lookup. Watchpoints cover the
+// data accesses of the instructions (FX33, FX55, FX65, DXYN and F002), not instruction fetches, and stop
+// before the instruction that would make the access.
+class Debugger
+{
+public:
+    enum Access : unsigned int
+    {
+        Read      = 1,
+        Write     = 2,
+        ReadWrite = Read | Write
+    };
+
+    enum class StopReason
+    {
+        None,
+        Pause,              // pause() called.
+        Step,               // The instructions of step() or stepOver() are done.
+        Breakpoint,
+        ReadWatch,
+        WriteWatch,
+        UnknownOpCode       // Stop before an opcode the quirk profile doesn't define.
+    };
+
+    struct Stop
+    {
+        StopReason reason = StopReason::None;
+        twoByte    pc      = 0;     // Address of the next instruction to run.
+        twoByte    opCode  = 0;     // Instruction at pc (watchpoints and unknown opcodes), 0 otherwise.
+        twoByte    address = 0;     // First watched address hit.
+    };
+
+    // What Chip8 tells about the instruction it is about to run.
+    struct Instruction
+    {
+        twoByte      pc;
+        twoByte      opCode;
+        byte         stackPointer;
+        bool         defined;           // The opcode exists in the quirk profile.
+        unsigned int accessStart;       // Memory range the instruction reads or writes, accessLength 0 for none.
+        unsigned int accessLength;
+        Access       access;
+    };
+
+    Debugger();
+
+    void setBreakpoint(twoByte address, bool enabled)   { breakpoints[address & (Chip8State::c_memorySize - 1)] = enabled; }
+    bool hasBreakpoint(twoByte address) const           { return breakpoints[address & (Chip8State::c_memorySize - 1)]; }
+
+    void setWatchpoint(twoByte address, unsigned int length, Access access, bool enabled);
+    bool hasWatchpoint(twoByte address, Access access) const;
+
+    void clearBreakpoints()                             { breakpoints.reset(); }
+    void clearWatchpoints()                             { readWatches.reset(); writeWatches.reset(); }
+
+    void setStopOnUnknownOpCode(bool enabled)           { stopOnUnknownOpCode = enabled; }
+    bool getStopOnUnknownOpCode() const                 { return stopOnUnknownOpCode; }
+
+    // Execution control. The instruction a stop happened on runs without checks when execution resumes,
+    // so continuing from a breakpoint doesn't stop on it again.
+    void pause();
+    void resume();                                      // Run until a breakpoint, watchpoint or unknown opcode.
+    void step(unsigned int count = 1);                  // Stop after count instructions.
+    void stepOver(twoByte pc, twoByte opCode, byte stackPointer);   // Like step(), but a call (2NNN) runs until it returns.
+
+    bool isStopped() const              { return stopped; }
+    const Stop& getStop() const         { return stop; }
+
+    std::uint64_t getExecutedInstructions() const { return executedInstructions; }     // Instructions run while attached.
+
+    static std::string getStopReasonName(StopReason reason);
+    static std::string disassemble(twoByte opCode, bool jumpUsesVX = false);    // "LD V3, 0x1F" style, "???" for undefined opcodes.
+                                                                                // jumpUsesVX reads BNNN as BXNN (Chip8::Quirks).
+
+    // Chip8 side: checkInstruction() before each instruction (true to not run it), onExecuted() after it.
+    bool checkInstruction(const Instruction& instruction);
+    void onExecuted(twoByte pc, byte stackPointer);
+
+private:
+    using AddressBits = std::bitset<Chip8State::c_memorySize>;
+
+    enum class Mode
+    {
+        Run,
+        Step,
+        StepOver
+    };
+
+    void stopAt(StopReason reason, twoByte pc, twoByte opCode = 0, twoByte address = 0);
+    void start(Mode newMode);
+
+    bool findWatched(const AddressBits& watches, unsigned int start, unsigned int length, twoByte& address) const;
+
+    AddressBits breakpoints;
+    AddressBits readWatches;
+    AddressBits writeWatches;
+
+    bool stopOnUnknownOpCode;
+
+    Mode mode;
+    bool stopped;
+    bool resuming;                      // The next instruction is the one stopped on, it runs unchecked.
+    Stop stop;
+
+    unsigned int stepsLeft;
+    twoByte      returnAddress;         // Step over: stop when the call returns here, at this stack depth.
+    byte         returnStackPointer;
+
+    std::uint64_t executedInstructions;
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Chip8State.h"
+
+// Layout shared by EnvironmentServer and its clients (training loops stepping many games at once).
+//
+// The server creates a shared memory mapping (see SharedMemory.h) that holds everything exchanged per
+// step, and listens on a Unix socket that only carries fixed size requests and responses:
+//
+//   Header                                      at 0
+//   InstanceControl[numInstances]               at controlOffset, written by the client
+//   Observation[ringSlots][numInstances]        at observationOffset, written by the server
+//   Chip8State[numInstances]                    at snapshotOffset, one snapshot slot per instance
+//
+// A step: the client writes the keys (and reset, save or restore flags) of every instance in its control
+// entry, sends a Request and waits for the Response. By then every instance ran the frames and its
+// observation is in the ring slot the response names. Slots are reused round robin, so the observations
+// of the last ringSlots steps stay readable (frame stacking) while the client fills the next request.
+// Nothing is copied through the socket and the server allocates nothing per step.
+//
+// Everything is in the native byte order and layout of the build: client and server run on one machine.
+namespace Environment
+{
+    constexpr std::uint32_t c_magic   = 0x56453843;     // "C8EV"
+    constexpr std::uint16_t c_version = 1;
+
+    constexpr unsigned int c_maxRewards = 8;
+
+    // A value the game keeps in memory (score, lives, level), read into every observation.
+    struct RewardSource
+    {
+        enum Format : byte
+        {
+            Binary  = 0,    // size bytes, big endian like the CHIP-8 itself.
+            Decimal = 1     // size bytes of one decimal digit each, most significant first (as FX33 stores them).
+        };
+
+        twoByte address = 0;
+        byte    size    = 1;    // 1 to 4.
+        byte    format  = Binary;
+    };
+
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint16_t version;
+        std::uint16_t headerSize;
+
+        std::uint32_t numInstances;
+        std::uint32_t ringSlots;
+        std::uint32_t cyclesPerFrame;       // Instructions per frame, each frame ends with a 60 Hz timer update.
+        std::uint32_t numRewards;
+
+        std::uint64_t romHash;              // See RomLibrary.h.
+        std::uint32_t seed;                 // Instance n starts with RNG seed seed + n.
+        byte          quirkProfile;         // Chip8::QuirkProfile and Chip8::DispatchMode values.
+        byte          dispatchMode;
+        std::uint16_t reserved;
+
+        std::uint64_t controlOffset;        // Byte offsets from the start of the mapping.
+        std::uint64_t observationOffset;
+        std::uint64_t snapshotOffset;
+        std::uint32_t observationSize;      // Bytes from one observation to the next.
+        std::uint32_t snapshotSize;         // sizeof(Chip8State) of the server build.
+
+        RewardSource  rewards[c_maxRewards];
+    };
+
+    // Control flags, cleared by the server once the step is done. Reset and restore happen before the frames
+    // of the step (in that order), save after them.
+    constexpr byte c_reset   = 0x01;        // Restart the game with RNG seed InstanceControl::seed.
+    constexpr byte c_restore = 0x02;        // Load the instance's snapshot slot (which the client may have written).
+    constexpr byte c_save    = 0x04;        // Copy the state after the frames into the snapshot slot.
+
+    struct InstanceControl
+    {
+        twoByte       keys;     // Key mask held down during the step, bit k for key k.
+        byte          flags;
+        byte          reserved;
+        std::uint32_t seed;     // For c_reset.
+    };
+
+    // Observation flags.
+    constexpr byte c_drawn   = 0x01;        // The game drew during the step.
+    constexpr byte c_trapped = 0x02;        // The game ran an undefined opcode during the step (it was skipped).
+    constexpr byte c_sound   = 0x04;        // The sound timer is running.
+    constexpr byte c_started = 0x08;        // The step started from a reset or a restored snapshot.
+
+    struct alignas(64) Observation
+    {
+        Chip8State::DisplayRows display;    // One bit per pixel, one 64 bit word per row, MSB leftmost.
+        byte          V[Chip8State::c_numRegisters];
+        twoByte       I;
+        twoByte       PC;
+        byte          SP;
+        byte          delayTimer;
+        byte          soundTimer;
+        byte          flags;
+        std::uint32_t rewards[c_maxRewards];    // Values of Header::rewards after the step.
+        std::uint64_t frame;                    // Frames since the last reset or restore.
+    };
+
+    enum class Command : std::uint32_t
+    {
+        Step     = 1,   // Run frames frames on every instance (0 to only apply the control flags and observe).
+        Shutdown = 2    // Stop the server.
+    };
+
+    struct Request
+    {
+        Command       command;
+        std::uint32_t frames;
+    };
+
+    enum class Status : std::uint32_t
+    {
+        Ok         = 0,
+        BadRequest = 1
+    };
+
+    struct Response
+    {
+        Status        status;
+        std::uint32_t slot;         // Ring slot holding the observations.
+        std::uint64_t sequence;     // Steps completed since the server started.
+    };
+
+    // Sizes and offsets of a mapping for numInstances instances and ringSlots slots.
+    inline std::size_t alignOffset(std::size_t offset) { return (offset + 63) & ~std::size_t(63); }
+
+    inline std::size_t getControlOffset()                              { return alignOffset(sizeof(Header)); }
+    inline std::size_t getObservationOffset(unsigned int numInstances) { return alignOffset(getControlOffset() + numInstances * sizeof(InstanceControl)); }
+
+    inline std::size_t getSnapshotOffset(unsigned int numInstances, unsigned int ringSlots)
+    {
+        return alignOffset(getObservationOffset(numInstances) + static_cast<std::size_t>(ringSlots) * numInstances * sizeof(Observation));
+    }
+
+    inline std::size_t getMappingSize(unsigned int numInstances, unsigned int ringSlots)
+    {
+        return getSnapshotOffset(numInstances, ringSlots) + numInstances * sizeof(Chip8State);
+    }
+}
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include "EnvironmentServer.h"
+
+#if defined(_WIN32)
+#error "EnvironmentServer needs POSIX sockets"
+#endif
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+#ifdef MSG_NOSIGNAL
+    constexpr int c_sendFlags = MSG_NOSIGNAL;      // A client gone mid step isn't worth a SIGPIPE.
+#else
+    constexpr int c_sendFlags = 0;
+#endif
+
+    std::uint32_t readReward(const Chip8State& state, const Environment::RewardSource& source)
+    {
+        std::uint32_t value = 0;
+
+        for (unsigned int i = 0; i < source.size; ++i)
+        {
+            const byte digit = state.memory[(source.address + i) & (Chip8State::c_memorySize - 1)];
+            value = (source.format == Environment::RewardSource::Decimal) ? value * 10 + digit : (value << 8) | digit;
+        }
+
+        return value;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool EnvironmentServer::open(const Options& newOptions, const RomImage& rom, std::string& error)
+{
+    close();
+    options = newOptions;
+
+    if (options.numInstances == 0 || options.numInstances > c_maxInstances)
+    {
+        error = "instance count out of range";
+        return false;
+    }
+
+    if (options.ringSlots == 0 || options.ringSlots > c_maxRingSlots)
+    {
+        error = "ring size out of range";
+        return false;
+    }
+
+    if (options.cyclesPerFrame == 0 || options.rewards.size() > Environment::c_maxRewards)
+    {
+        error = "bad frame length or too many rewards";
+        return false;
+    }
+
+    for (const Environment::RewardSource& reward : options.rewards)
+    {
+        if (reward.size == 0 || reward.size > 4)
+        {
+            error = "reward sizes are 1 to 4 bytes";
+            return false;
+        }
+    }
+
+    // Instances are set up like a BatchRunner instance, so a client can reproduce any of them with a Chip8.
+    instances.reserve(options.numInstances);
+
+    for (unsigned int index = 0; index < options.numInstances; ++index)
+    {
+        instances.emplace_back(options.seed + index);
+
+        Chip8& chip8 = instances.back().chip8;
+        chip8.initialize();
+        chip8.setDispatchMode(options.dispatchMode);
+        chip8.setQuirkProfile(options.quirkProfile);
+
+        if (!chip8.loadGame(rom.data))
+        {
+            error = "cannot load " + rom.name;
+            instances.clear();
+            return false;
+        }
+    }
+
+    startState = instances.front().chip8.getState();
+
+    if (!sharedMemory.create(options.sharedMemoryName, Environment::getMappingSize(options.numInstances, options.ringSlots), error))
+    {
+        instances.clear();
+        return false;
+    }
+
+    byte* const base = static_cast<byte*>(sharedMemory.getData());
+    std::memset(base, 0, sharedMemory.getSize());
+
+    header       = new (base) Environment::Header();
+    controls     = reinterpret_cast<Environment::InstanceControl*>(base + Environment::getControlOffset());
+    observations = reinterpret_cast<Environment::Observation*>(base + Environment::getObservationOffset(options.numInstances));
+    snapshots    = reinterpret_cast<Chip8State*>(base + Environment::getSnapshotOffset(options.numInstances, options.ringSlots));
+
+    header->magic             = Environment::c_magic;
+    header->version           = Environment::c_version;
+    header->headerSize        = static_cast<std::uint16_t>(sizeof(Environment::Header));
+    header->numInstances      = options.numInstances;
+    header->ringSlots         = options.ringSlots;
+    header->cyclesPerFrame    = options.cyclesPerFrame;
+    header->numRewards        = static_cast<std::uint32_t>(options.rewards.size());
+    header->romHash           = rom.hash;
+    header->seed              = options.seed;
+    header->quirkProfile      = static_cast<byte>(options.quirkProfile);
+    header->dispatchMode      = static_cast<byte>(options.dispatchMode);
+    header->controlOffset     = Environment::getControlOffset();
+    header->observationOffset = Environment::getObservationOffset(options.numInstances);
+    header->snapshotOffset    = Environment::getSnapshotOffset(options.numInstances, options.ringSlots);
+    header->observationSize   = sizeof(Environment::Observation);
+    header->snapshotSize      = sizeof(Chip8State);
+
+    std::copy(options.rewards.begin(), options.rewards.end(), header->rewards);
+
+    // Until the client saves its own, the snapshot slots hold the starting states.
+    for (unsigned int index = 0; index < options.numInstances; ++index)
+        instances[index].chip8.saveState(snapshots[index]);
+
+    if (!options.socketPath.empty() && !openSocket(options.socketPath, error))
+    {
+        close();
+        return false;
+    }
+
+    stopRequested.store(false, std::memory_order_relaxed);
+    stopping = false;
+
+    for (unsigned int worker = 1; worker < std::min(options.threads, options.numInstances); ++worker)
+        workers.emplace_back(&EnvironmentServer::workerLoop, this);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void EnvironmentServer::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    stepReady.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    workers.clear();
+
+    if (listenSocket >= 0)
+    {
+        ::close(listenSocket);
+        unlink(options.socketPath.c_str());
+        listenSocket = -1;
+    }
+
+    // Clients that already mapped the memory keep their mapping, the name goes away with the server.
+    sharedMemory.close();
+    header       = nullptr;
+    controls     = nullptr;
+    observations = nullptr;
+    snapshots    = nullptr;
+
+    instances.clear();
+    sequence = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool EnvironmentServer::openSocket(const std::string& path, std::string& error)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        error = "socket path too long " + path;
+        return false;
+    }
+
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listenSocket < 0)
+    {
+        error = "cannot create socket";
+        return false;
+    }
+
+    // A socket file left by a server that didn't exit cleanly would make bind() fail.
+    unlink(path.c_str());
+
+    if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 1) != 0)
+    {
+        error = "cannot listen on " + path + " (" + std::strerror(errno) + ")";
+        ::close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool EnvironmentServer::serve(std::string& error)
+{
+    if (listenSocket < 0)
+    {
+        error = "no socket";
+        return false;
+    }
+
+    while (!stopRequested.load(std::memory_order_relaxed))
+    {
+        const int client = accept(listenSocket, nullptr, nullptr);
+
+        if (client < 0)
+        {
+            // Interrupted by a signal: requestStop() may have been called.
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            error = std::string("accept failed (") + std::strerror(errno) + ")";
+            return false;
+        }
+
+        const bool shutdown = serveClient(client);
+        ::close(client);
+
+        if (shutdown)
+            break;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool EnvironmentServer::serveClient(int client)
+{
+    Environment::Request request;
+
+    while (!stopRequested.load(std::memory_order_relaxed))
+    {
+        // Requests are a few bytes, but a stream socket may still split them.
+        std::size_t received = 0;
+
+        while (received < sizeof(request))
+        {
+            const ssize_t count = recv(client, reinterpret_cast<char*>(&request) + received, sizeof(request) - received, 0);
+
+            if (count > 0)
+                received += static_cast<std::size_t>(count);
+            else if (count < 0 && errno == EINTR && !stopRequested.load(std::memory_order_relaxed))
+                continue;
+            else
+                return false;   // Client gone (or stop requested): wait for the next one.
+        }
+
+        Environment::Response response = { Environment::Status::BadRequest, 0, sequence };
+
+        if (request.command == Environment::Command::Step)
+            response = step(request.frames);
+        else if (request.command == Environment::Command::Shutdown)
+            response.status = Environment::Status::Ok;
+
+        if (send(client, &response, sizeof(response), c_sendFlags) != static_cast<ssize_t>(sizeof(response)))
+            return false;
+
+        if (request.command == Environment::Command::Shutdown)
+            return true;
+    }
+
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Environment::Response EnvironmentServer::step(unsigned int stepFrames)
+{
+    const std::uint32_t slot = static_cast<std::uint32_t>(sequence % options.ringSlots);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames           = stepFrames;
+        stepObservations = observations + static_cast<std::size_t>(slot) * options.numInstances;
+        nextInstance.store(0, std::memory_order_relaxed);
+        activeWorkers = static_cast<unsigned int>(workers.size());
+        ++generation;
+    }
+
+    stepReady.notify_all();
+
+    runInstances();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stepDone.wait(lock, [this] { return activeWorkers == 0; });
+    }
+
+    ++sequence;
+
+    return { Environment::Status::Ok, slot, sequence };
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void EnvironmentServer::workerLoop()
+{
+    std::uint64_t lastGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stepReady.wait(lock, [this, lastGeneration] { return stopping || generation != lastGeneration; });
+
+            if (stopping)
+                return;
+
+            lastGeneration = generation;
+        }
+
+        runInstances();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (--activeWorkers == 0)
+                stepDone.notify_one();
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void EnvironmentServer::runInstances()
+{
+    // One instance at a time: a step of one instance is thousands of instructions, the counter is cheap.
+    for (unsigned int index = nextInstance.fetch_add(1, std::memory_order_relaxed); index < options.numInstances;
+         index = nextInstance.fetch_add(1, std::memory_order_relaxed))
+    {
+        stepInstance(index);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void EnvironmentServer::stepInstance(unsigned int index)
+{
+    Instance& instance = instances[index];
+    Chip8& chip8 = instance.chip8;
+    Environment::InstanceControl& control = controls[index];
+
+    const byte controlFlags = control.flags;
+    byte flags = 0;
+
+    if (controlFlags & Environment::c_reset)
+    {
+        chip8.loadState(startState);
+        chip8.setRandomSeed(control.seed);
+        instance.frame = 0;
+        flags |= Environment::c_started;
+    }
+
+    if (controlFlags & Environment::c_restore)
+    {
+        chip8.loadState(snapshots[index]);
+        instance.frame = 0;
+        flags |= Environment::c_started;
+    }
+
+    if (flags & Environment::c_started)
+    {
+        chip8.clearTrap();
+        chip8.setDrawFlagFalse();
+    }
+
+    chip8.setKeys(control.keys);
+
+    bool playSound = false;
+
+    for (unsigned int frame = 0; frame < frames; ++frame)
+    {
+        chip8.emulateCycles(options.cyclesPerFrame);
+        chip8.updateTimers(playSound);
+    }
+
+    instance.frame += frames;
+
+    if (controlFlags & Environment::c_save)
+        chip8.saveState(snapshots[index]);
+
+    if (chip8.getDrawFlag())
+    {
+        flags |= Environment::c_drawn;
+        chip8.setDrawFlagFalse();
+    }
+
+    if (chip8.hasTrapped())
+    {
+        flags |= Environment::c_trapped;
+        chip8.clearTrap();
+    }
+
+    const Chip8State& state = chip8.getState();
+
+    if (state.soundTimer > 0)
+        flags |= Environment::c_sound;
+
+    Environment::Observation& observation = stepObservations[index];
+    observation.display    = state.display;
+    std::copy(state.V.begin(), state.V.end(), observation.V);
+    observation.I          = state.I;
+    observation.PC         = state.PC;
+    observation.SP         = state.SP;
+    observation.delayTimer = state.delayTimer;
+    observation.soundTimer = state.soundTimer;
+    observation.flags      = flags;
+    observation.frame      = instance.frame;
+
+    for (std::size_t reward = 0; reward < options.rewards.size(); ++reward)
+        observation.rewards[reward] = readReward(state, options.rewards[reward]);
+
+    control.flags = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "EnvironmentProtocol.h"
+#include "RomLibrary.h"
+#include "SharedMemory.h"
+
+// Local server for training workloads: a pool of instances of one game, stepped in batches by a client
+// over a Unix socket, with the controls, observations and snapshots in shared memory (the layout is in
+// EnvironmentProtocol.h). POSIX only.
+//
+// A step spreads the instances over a fixed set of worker threads (the calling thread included). Each
+// instance applies its control flags, runs the frames, writes its observation straight into the ring slot
+// and saves its snapshot, so a step costs no allocation and no copy beyond the observation itself.
+class EnvironmentServer
+{
+public:
+    struct Options
+    {
+        unsigned int numInstances   = 64;
+        unsigned int ringSlots      = 4;
+        unsigned int cyclesPerFrame = 10;
+        unsigned int seed           = 0;
+        unsigned int threads        = std::thread::hardware_concurrency();
+        Chip8::QuirkProfile quirkProfile = Chip8::QuirkProfile::Chip8;
+        Chip8::DispatchMode dispatchMode = Chip8::DispatchMode::CachedBlocks;
+        std::vector<Environment::RewardSource> rewards;
+        std::string sharedMemoryName = "chip8_env";
+        std::string socketPath       = "/tmp/chip8_env.sock";      // Empty to only step in process.
+    };
+
+    static constexpr unsigned int c_maxInstances = 4096;
+    static constexpr unsigned int c_maxRingSlots = 64;
+
+    EnvironmentServer() = default;
+    ~EnvironmentServer() { close(); }
+
+    EnvironmentServer(const EnvironmentServer&)            = delete;
+    EnvironmentServer& operator=(const EnvironmentServer&) = delete;
+
+    // Loads the game into every instance, creates the shared memory and the socket, starts the workers.
+    bool open(const Options& options, const RomImage& rom, std::string& error);
+    void close();
+
+    // Serves one client at a time until a Shutdown request or requestStop(). False on socket errors.
+    bool serve(std::string& error);
+
+    // Async signal safe: makes serve() return at its next wait for a client or a request.
+    void requestStop() { stopRequested.store(true, std::memory_order_relaxed); }
+
+    // What a Step request does, for stepping in process.
+    Environment::Response step(unsigned int frames);
+
+    Environment::Header& getHeader() const { return *header; }
+
+private:
+    struct Instance
+    {
+        Chip8         chip8;
+        std::uint64_t frame = 0;
+
+        explicit Instance(unsigned int seed) : chip8(seed) {}
+    };
+
+    bool openSocket(const std::string& path, std::string& error);
+    bool serveClient(int client);       // True when the client asked for a shutdown.
+
+    void workerLoop();
+    void runInstances();                // Takes instances of the current step until none is left.
+    void stepInstance(unsigned int index);
+
+    Options options;
+    std::vector<Instance> instances;
+    Chip8State startState;              // Every instance after loading the game, reset seeds apart.
+
+    SharedMemory sharedMemory;
+    Environment::Header*          header       = nullptr;
+    Environment::InstanceControl* controls     = nullptr;
+    Environment::Observation*     observations = nullptr;
+    Chip8State*                   snapshots    = nullptr;
+
+    std::uint64_t sequence = 0;
+
+    // Current step, published to the workers under mutex.
+    unsigned int                frames           = 0;
+    Environment::Observation*   stepObservations = nullptr;
+    std::atomic<unsigned int>   nextInstance{0};
+
+    std::vector<std::thread> workers;
+    std::mutex               mutex;
+    std::condition_variable  stepReady;
+    std::condition_variable  stepDone;
+    std::uint64_t            generation    = 0;     // Steps published to the workers.
+    unsigned int             activeWorkers = 0;     // Workers still running the current step.
+    bool                     stopping      = false;
+
+    int listenSocket = -1;
+    std::atomic<bool> stopRequested{false};
+};
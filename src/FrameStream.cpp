@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include "ByteOrder.h"
+#include "FrameStream.h"
+
+namespace
+{
+    constexpr std::size_t c_headerSize       = 4 + 2 + 1 + 1 + 4;
+    constexpr std::size_t c_recordHeaderSize = 4 + 1 + 2;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void FrameStream::toBitmap(const Chip8State::DisplayRows& rows, Bitmap& bitmap)
+{
+    for (unsigned int row = 0; row < Chip8State::c_displayHeight; ++row)
+    {
+        for (unsigned int column = 0; column < 8; ++column)
+            bitmap[row * 8 + column] = static_cast<byte>(rows[row] >> (56 - 8 * column));
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void FrameStream::fromBitmap(const Bitmap& bitmap, Chip8State::DisplayRows& rows)
+{
+    for (unsigned int row = 0; row < Chip8State::c_displayHeight; ++row)
+    {
+        std::uint64_t bits = 0;
+
+        for (unsigned int column = 0; column < 8; ++column)
+            bits = (bits << 8) | bitmap[row * 8 + column];
+
+        rows[row] = bits;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::size_t FrameStream::encodeRle(const Bitmap& bitmap, byte* payload)
+{
+    std::size_t size = 0;
+    std::size_t i = 0;
+
+    while (i < c_bitmapSize)
+    {
+        const std::size_t start = i;
+
+        if (bitmap[i] == 0)
+        {
+            while (i < c_bitmapSize && i - start < 128 && bitmap[i] == 0)
+                ++i;
+
+            payload[size++] = static_cast<byte>(i - start - 1);
+        }
+        else
+        {
+            // Literals run on over single zeros, a zero run only pays off from two bytes on.
+            while (i < c_bitmapSize && i - start < 128 && (bitmap[i] != 0 || (i + 1 < c_bitmapSize && bitmap[i + 1] != 0)))
+                ++i;
+
+            payload[size++] = static_cast<byte>(0x7F + (i - start));
+
+            for (std::size_t j = start; j < i; ++j)
+                payload[size++] = bitmap[j];
+        }
+    }
+
+    return size;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool FrameStream::decodeRle(const byte* payload, std::size_t size, Bitmap& bitmap)
+{
+    std::size_t position = 0;
+    std::size_t i = 0;
+
+    while (i < size)
+    {
+        const byte token = payload[i++];
+
+        if (token < 0x80)
+        {
+            const std::size_t count = token + 1u;
+
+            if (position + count > c_bitmapSize)
+                return false;
+
+            std::fill_n(bitmap.begin() + position, count, 0);
+            position += count;
+        }
+        else
+        {
+            const std::size_t count = token - 0x7Fu;
+
+            if (position + count > c_bitmapSize || i + count > size)
+                return false;
+
+            std::copy_n(payload + i, count, bitmap.begin() + position);
+            position += count;
+            i        += count;
+        }
+    }
+
+    return position == c_bitmapSize;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+FrameStreamWriter::FrameStreamWriter(Overflow overflow, std::size_t queueCapacity) : overflow(overflow), queue(queueCapacity), stopping(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+FrameStreamWriter::~FrameStreamWriter()
+{
+    std::string error;
+    close(error);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool FrameStreamWriter::open(const std::string& path, std::string& error)
+{
+    outputFile.open(path, std::ios::binary | std::ios::trunc);
+
+    std::vector<byte> header;
+    writeLittleEndian(header, FrameStream::c_magic, 4);
+    writeLittleEndian(header, FrameStream::c_version, 2);
+    writeLittleEndian(header, Chip8State::c_displayWidth, 1);
+    writeLittleEndian(header, Chip8State::c_displayHeight, 1);
+    writeLittleEndian(header, 0, 4);
+
+    outputFile.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    if (!outputFile)
+    {
+        error = "can't write " + path;
+        outputFile.close();
+        return false;
+    }
+
+    writeFailed     = false;
+    submittedFrames = 0;
+    droppedFrames   = 0;
+    stopping.store(false, std::memory_order_relaxed);
+
+    writerThread = std::thread(&FrameStreamWriter::writeFrames, this);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool FrameStreamWriter::close(std::string& error)
+{
+    if (!writerThread.joinable())
+        return true;
+
+    stopping.store(true, std::memory_order_release);
+    writerThread.join();
+
+    outputFile.close();
+
+    if (writeFailed || outputFile.fail())
+    {
+        error = "frame stream write failed";
+        return false;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void FrameStreamWriter::submit(std::uint32_t frame, const Chip8State::DisplayRows& rows)
+{
+    ++submittedFrames;
+
+    Frame* slot = queue.getWriteSlot();
+
+    while (slot == nullptr)
+    {
+        if (overflow == Overflow::DropFrame)
+        {
+            ++droppedFrames;
+            return;
+        }
+
+        std::this_thread::yield();
+        slot = queue.getWriteSlot();
+    }
+
+    slot->number = frame;
+    slot->rows   = rows;
+    queue.push();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void FrameStreamWriter::writeFrames()
+{
+    FrameStream::Bitmap previous = {};
+    FrameStream::Bitmap delta;
+    std::array<byte, FrameStream::c_maxPayloadSize> payload;
+    std::vector<byte> record;
+    unsigned int recordsSinceKeyFrame = c_keyFrameInterval;
+
+    record.reserve(c_recordHeaderSize + FrameStream::c_maxPayloadSize);
+
+    while (true)
+    {
+        const Frame* frame = queue.getReadSlot();
+
+        if (frame == nullptr)
+        {
+            // Checked before the last look at the queue, so frames submitted before close() are all written.
+            if (stopping.load(std::memory_order_acquire) && queue.getReadSlot() == nullptr)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        FrameStream::Bitmap bitmap;
+        FrameStream::toBitmap(frame->rows, bitmap);
+
+        const std::uint32_t number = frame->number;
+        queue.pop();
+
+        const bool keyFrame = (recordsSinceKeyFrame >= c_keyFrameInterval);
+        recordsSinceKeyFrame = keyFrame ? 1 : recordsSinceKeyFrame + 1;
+
+        for (unsigned int i = 0; i < FrameStream::c_bitmapSize; ++i)
+            delta[i] = keyFrame ? bitmap[i] : static_cast<byte>(bitmap[i] ^ previous[i]);
+
+        previous = bitmap;
+
+        const std::size_t payloadSize = FrameStream::encodeRle(delta, payload.data());
+
+        record.clear();
+        writeLittleEndian(record, number, 4);
+        writeLittleEndian(record, keyFrame ? FrameStream::c_keyFrame : 0, 1);
+        writeLittleEndian(record, payloadSize, 2);
+        record.insert(record.end(), payload.begin(), payload.begin() + payloadSize);
+
+        outputFile.write(reinterpret_cast<const char*>(record.data()), record.size());
+
+        if (!outputFile)
+            writeFailed = true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool FrameStreamReader::open(const std::string& path, std::string& error)
+{
+    std::ifstream inputFile(path, std::ios::binary);
+
+    if (inputFile.fail())
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(inputFile), std::istreambuf_iterator<char>());
+    offset = 0;
+    bitmap = {};
+
+    if (data.size() < c_headerSize || readLittleEndian(data, offset, 4) != FrameStream::c_magic || readLittleEndian(data, offset, 2) != FrameStream::c_version)
+    {
+        error = path + " is not a version " + std::to_string(FrameStream::c_version) + " frame stream";
+        return false;
+    }
+
+    if (readLittleEndian(data, offset, 1) != Chip8State::c_displayWidth || readLittleEndian(data, offset, 1) != Chip8State::c_displayHeight)
+    {
+        error = path + " has an unsupported resolution";
+        return false;
+    }
+
+    offset += 4;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool FrameStreamReader::next(std::uint32_t& frame, Chip8State::DisplayRows& rows, std::string& error)
+{
+    if (offset == data.size())
+        return false;
+
+    if (data.size() - offset < c_recordHeaderSize)
+    {
+        error = "truncated record";
+        return false;
+    }
+
+    frame = static_cast<std::uint32_t>(readLittleEndian(data, offset, 4));
+    const bool keyFrame = (readLittleEndian(data, offset, 1) & FrameStream::c_keyFrame) != 0;
+    const std::size_t payloadSize = static_cast<std::size_t>(readLittleEndian(data, offset, 2));
+
+    FrameStream::Bitmap delta;
+
+    if (data.size() - offset < payloadSize || !FrameStream::decodeRle(data.data() + offset, payloadSize, delta))
+    {
+        error = "damaged record for frame " + std::to_string(frame);
+        return false;
+    }
+
+    offset += payloadSize;
+
+    for (unsigned int i = 0; i < FrameStream::c_bitmapSize; ++i)
+        bitmap[i] = keyFrame ? delta[i] : static_cast<byte>(bitmap[i] ^ delta[i]);
+
+    FrameStream::fromBitmap(bitmap, rows);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,104 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8State.h"
+#include "SpscQueue.h"
+
+// Compressed stream of the frames a run draws, for CI and batch runs that need to look at the output
+// without a window. Each frame is stored as the XOR of its bitmap with the previous frame's, run length
+// encoded: a mostly static screen costs a few bytes per frame.
+//
+// File layout, little endian: "C8FS", version (u16), width (u8), height (u8), reserved (u32), then one
+// record per frame: number of the frame it was drawn in (u32), flags (u8), payload size (u16) and the payload. The payload is the
+// RLE of the 256 byte bitmap (row by row, leftmost pixel in the MSB of the first byte of its row), XORed
+// with the previous record's bitmap unless the record is a key frame. RLE tokens: 0x00-0x7F are followed
+// by nothing and stand for 1-128 zero bytes, 0x80-0xFF are followed by 1-128 literal bytes.
+namespace FrameStream
+{
+    constexpr std::uint32_t c_magic   = 0x53463843;     // "C8FS"
+    constexpr std::uint16_t c_version = 1;
+
+    constexpr byte c_keyFrame = 0x01;                   // Record flag: payload isn't a delta.
+
+    constexpr unsigned int c_bitmapSize     = Chip8State::c_displaySize / 8;
+    constexpr unsigned int c_maxPayloadSize = c_bitmapSize + (c_bitmapSize + 127) / 128;
+
+    using Bitmap = std::array<byte, c_bitmapSize>;
+
+    void toBitmap(const Chip8State::DisplayRows& rows, Bitmap& bitmap);
+    void fromBitmap(const Bitmap& bitmap, Chip8State::DisplayRows& rows);
+
+    std::size_t encodeRle(const Bitmap& bitmap, byte* payload);     // Writes at most c_maxPayloadSize bytes.
+    bool        decodeRle(const byte* payload, std::size_t size, Bitmap& bitmap);
+}
+
+// Emulation side sink of a frame stream. submit() copies the frame into a bounded lock-free queue and
+// returns, a background thread encodes the frames and writes them to disk. When the queue is full, real
+// time runs drop the frame (and count it) rather than stall emulation; headless runs that want every frame
+// wait for the writer to free a slot instead. Deltas are always taken against the last frame written, so
+// the stream stays decodable either way.
+class FrameStreamWriter
+{
+public:
+    enum class Overflow
+    {
+        DropFrame,
+        Wait
+    };
+
+    explicit FrameStreamWriter(Overflow overflow = Overflow::DropFrame, std::size_t queueCapacity = 1024);
+    ~FrameStreamWriter();
+
+    bool open(const std::string& path, std::string& error);
+    bool close(std::string& error);      // Writes the queued frames and stops the writer thread.
+
+    bool isOpen() const { return writerThread.joinable(); }
+
+    // Called from a single thread, the emulation one. Frame numbers are the caller's, usually timer ticks.
+    void submit(std::uint32_t frame, const Chip8State::DisplayRows& rows);
+
+    std::uint64_t getSubmittedFrames() const { return submittedFrames; }
+    std::uint64_t getDroppedFrames() const   { return droppedFrames; }
+
+private:
+    struct Frame
+    {
+        std::uint32_t           number;
+        Chip8State::DisplayRows rows;
+    };
+
+    void writeFrames();
+
+    static constexpr unsigned int c_keyFrameInterval = 600;    // Records between key frames, to resync.
+
+    const Overflow overflow;
+    SpscQueue<Frame> queue;
+    std::thread writerThread;
+    std::atomic<bool> stopping;
+
+    std::ofstream outputFile;
+    bool writeFailed = false;
+
+    std::uint64_t submittedFrames = 0;
+    std::uint64_t droppedFrames   = 0;
+};
+
+// Sequential reader of a frame stream, for the decoder tool.
+class FrameStreamReader
+{
+public:
+    bool open(const std::string& path, std::string& error);
+
+    // False at the end of the stream, or with error set when a record is damaged.
+    bool next(std::uint32_t& frame, Chip8State::DisplayRows& rows, std::string& error);
+
+private:
+    std::vector<byte> data;
+    std::size_t offset = 0;
+    FrameStream::Bitmap bitmap = {};
+};
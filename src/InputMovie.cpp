@@ -0,0 +1,127 @@
+#include <fstream>
+#include <iterator>
+#include "ByteOrder.h"
+#include "Chip8.h"
+#include "InputMovie.h"
+#include "Scheduler.h"
+
+namespace
+{
+    constexpr std::size_t c_headerSize = 4 + 2 + 1 + 1 + 4 + 4 + 8 + 4 + 4;
+    constexpr std::size_t c_eventSize  = 4 + 2;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void InputMovie::record(std::uint32_t frame, twoByte keys)
+{
+    const twoByte previousKeys = events.empty() ? 0 : events.back().keys;
+
+    if (keys != previousKeys)
+        events.push_back({ frame, keys });
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool InputMovie::save(const std::string& path, std::string& error) const
+{
+    std::vector<byte> data;
+    data.reserve(c_headerSize + events.size() * c_eventSize);
+
+    writeLittleEndian(data, c_magic, 4);
+    writeLittleEndian(data, c_version, 2);
+    writeLittleEndian(data, quirkProfile, 1);
+    writeLittleEndian(data, 0, 1);
+    writeLittleEndian(data, seed, 4);
+    writeLittleEndian(data, instructionsPerSecond, 4);
+    writeLittleEndian(data, romHash, 8);
+    writeLittleEndian(data, frameCount, 4);
+    writeLittleEndian(data, events.size(), 4);
+
+    for (const Event& event : events)
+    {
+        writeLittleEndian(data, event.frame, 4);
+        writeLittleEndian(data, event.keys, 2);
+    }
+
+    std::ofstream outputFile(path, std::ios::binary);
+    outputFile.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+    if (!outputFile)
+    {
+        error = "can't write " + path;
+        return false;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool InputMovie::load(const std::string& path, std::string& error)
+{
+    std::ifstream inputFile(path, std::ios::binary);
+
+    if (inputFile.fail())
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    const std::vector<byte> data((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
+    std::size_t offset = 0;
+
+    if (data.size() < c_headerSize || readLittleEndian(data, offset, 4) != c_magic || readLittleEndian(data, offset, 2) != c_version)
+    {
+        error = path + " is not a version " + std::to_string(c_version) + " movie";
+        return false;
+    }
+
+    quirkProfile = static_cast<byte>(readLittleEndian(data, offset, 1));
+    offset += 1;
+
+    // Callers cast it straight to Chip8::QuirkProfile, only profiles this build has a core for are accepted.
+    if (quirkProfile > static_cast<byte>(Chip8::QuirkProfile::XoChip))
+    {
+        error = path + " uses unknown quirk profile " + std::to_string(quirkProfile);
+        return false;
+    }
+
+    seed                  = static_cast<std::uint32_t>(readLittleEndian(data, offset, 4));
+    instructionsPerSecond = static_cast<std::uint32_t>(readLittleEndian(data, offset, 4));
+    romHash               = readLittleEndian(data, offset, 8);
+    frameCount            = static_cast<std::uint32_t>(readLittleEndian(data, offset, 4));
+
+    // Recordings are made at a speed the Scheduler accepts, any other would replay differently from the run.
+    if (instructionsPerSecond < Scheduler::c_minInstructionsPerSecond || instructionsPerSecond > Scheduler::c_maxInstructionsPerSecond)
+    {
+        error = path + " runs at an unsupported " + std::to_string(instructionsPerSecond) + " instructions per second";
+        return false;
+    }
+
+    const std::size_t numEvents = static_cast<std::size_t>(readLittleEndian(data, offset, 4));
+
+    if (data.size() != c_headerSize + numEvents * c_eventSize)
+    {
+        error = path + " is truncated";
+        return false;
+    }
+
+    events.resize(numEvents);
+
+    for (std::size_t i = 0; i < numEvents; ++i)
+    {
+        events[i].frame = static_cast<std::uint32_t>(readLittleEndian(data, offset, 4));
+        events[i].keys  = static_cast<twoByte>(readLittleEndian(data, offset, 2));
+
+        if (i > 0 && events[i].frame < events[i - 1].frame)
+        {
+            error = path + " has events out of frame order";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Chip8State.h"
+
+// Input log of a run ("movie"): the key mask at every emulated frame where it changed, plus everything
+// else that decides the run (RNG seed, instructions per second, quirk profile, ROM hash). Keys are only
+// applied at frame boundaries, right after the 60 Hz timer update, so replaying a movie reproduces the
+// run bit for bit whatever the engine or the host speed.
+//
+// File layout, little endian: "C8MV", version (u16), quirk profile (u8), reserved (u8), seed (u32),
+// instructions per second (u32), ROM hash (u64), frame count (u32), event count (u32), then the events
+// as frame (u32) and key mask (u16).
+class InputMovie
+{
+public:
+    static constexpr std::uint32_t c_magic   = 0x564D3843;     // "C8MV"
+    static constexpr std::uint16_t c_version = 1;
+
+    struct Event
+    {
+        std::uint32_t frame;    // Keys used from this frame on. Frame f runs between timer updates f and f + 1.
+        twoByte       keys;
+    };
+
+    std::uint32_t seed                  = 0;
+    std::uint32_t instructionsPerSecond = 600;
+    std::uint64_t romHash               = 0;
+    byte          quirkProfile          = 0;    // Chip8::QuirkProfile
+    std::uint32_t frameCount            = 0;    // Frames recorded, replays run this many.
+
+    // Recording: call at every frame boundary with the keys for that frame, only changes are stored.
+    void record(std::uint32_t frame, twoByte keys);
+
+    const std::vector<Event>& getEvents() const { return events; }
+
+    bool save(const std::string& path, std::string& error) const;
+    bool load(const std::string& path, std::string& error);
+
+    // Sequential replay, frames asked in increasing order.
+    class Player
+    {
+    public:
+        explicit Player(const InputMovie& movie) : events(movie.events), nextEvent(0), keys(0) {}
+
+        twoByte getKeys(std::uint32_t frame)
+        {
+            while (nextEvent < events.size() && events[nextEvent].frame <= frame)
+                keys = events[nextEvent++].keys;
+
+            return keys;
+        }
+
+    private:
+        const std::vector<Event>& events;
+        std::size_t nextEvent;
+        twoByte keys;
+    };
+
+private:
+    std::vector<Event> events;
+};
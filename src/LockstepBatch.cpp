@@ -0,0 +1,833 @@
+#include <algorithm>
+#include <bitset>
+#include "LockstepBatch.h"
+
+#if !defined(CHIP8_LOCKSTEP_SCALAR) && defined(__AVX2__)
+#define LOCKSTEP_AVX2
+#include <immintrin.h>
+#elif !defined(CHIP8_LOCKSTEP_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LOCKSTEP_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    using LaneMask = LockstepBatch::LaneMask;
+
+    constexpr unsigned int c_lanes = LockstepBatch::c_maxLanes;
+
+    unsigned int lowestLane(LaneMask lanes)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, lanes);
+        return index;
+#else
+        return static_cast<unsigned int>(__builtin_ctz(lanes));
+#endif
+    }
+
+    template<typename Function>
+    void forEachLane(LaneMask lanes, Function function)
+    {
+        while (lanes != 0)
+        {
+            function(lowestLane(lanes));
+            lanes &= lanes - 1;
+        }
+    }
+
+    // One byte per lane: the registers, timers and memory rows of all the lanes. Comparisons return a mask
+    // vector (0xFF or 0x00 per lane), flags are 0 or 1 like the values stored in VF.
+#if defined(LOCKSTEP_AVX2)
+
+    using ByteLanes = __m256i;
+
+    ByteLanes load(const byte* lanes)            { return _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes)); }
+    void      store(byte* lanes, ByteLanes value) { _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value); }
+    ByteLanes broadcast(byte value)              { return _mm256_set1_epi8(static_cast<char>(value)); }
+
+    ByteLanes add(ByteLanes a, ByteLanes b)    { return _mm256_add_epi8(a, b); }
+    ByteLanes sub(ByteLanes a, ByteLanes b)    { return _mm256_sub_epi8(a, b); }
+    ByteLanes bitAnd(ByteLanes a, ByteLanes b) { return _mm256_and_si256(a, b); }
+    ByteLanes bitOr(ByteLanes a, ByteLanes b)  { return _mm256_or_si256(a, b); }
+    ByteLanes bitXor(ByteLanes a, ByteLanes b) { return _mm256_xor_si256(a, b); }
+    ByteLanes shiftRight1(ByteLanes a)         { return _mm256_and_si256(_mm256_srli_epi16(a, 1), broadcast(0x7F)); }
+    ByteLanes decrement(ByteLanes a)           { return _mm256_subs_epu8(a, broadcast(1)); }     // Stops at 0.
+
+    ByteLanes equal(ByteLanes a, ByteLanes b)       { return _mm256_cmpeq_epi8(a, b); }
+    ByteLanes lessOrEqual(ByteLanes a, ByteLanes b) { return _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b); }  // Unsigned.
+    ByteLanes flagIf(ByteLanes mask)                { return _mm256_and_si256(mask, broadcast(1)); }
+    ByteLanes flagUnless(ByteLanes mask)            { return _mm256_andnot_si256(mask, broadcast(1)); }
+
+    ByteLanes select(ByteLanes mask, ByteLanes a, ByteLanes b) { return _mm256_blendv_epi8(b, a, mask); }
+
+    ByteLanes toVector(LaneMask lanes)
+    {
+        // Byte n / 8 of the mask to every byte of lane group n / 8, then test bit n % 8.
+        const __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(lanes)),
+                                                   _mm256_setr_epi64x(0x0000000000000000, 0x0101010101010101, 0x0202020202020202, 0x0303030303030303));
+        const __m256i bits   = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ull));
+        return _mm256_cmpeq_epi8(_mm256_and_si256(spread, bits), bits);
+    }
+
+    LaneMask toLaneMask(ByteLanes mask) { return static_cast<LaneMask>(_mm256_movemask_epi8(mask)); }
+
+    // Lanes whose 16 bit value (PC, I, keys) is value.
+    LaneMask wordsEqual(const twoByte* words, twoByte value)
+    {
+        const __m256i target = _mm256_set1_epi16(static_cast<short>(value));
+        const __m256i low    = _mm256_cmpeq_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(words)), target);
+        const __m256i high   = _mm256_cmpeq_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(words + 16)), target);
+
+        // Packing works per 128 bit half, put the lanes back in order before taking the mask.
+        return toLaneMask(_mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8));
+    }
+
+    // 0xFFFF in the words of lanes 16 * half to 16 * half + 15 that are in lanes.
+    __m256i toWordVector(LaneMask lanes, unsigned int half)
+    {
+        const __m256i bits = _mm256_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+                                               0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, static_cast<short>(0x8000));
+
+        return _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16(static_cast<short>(lanes >> (16 * half))), bits), bits);
+    }
+
+    void setWords(twoByte* words, LaneMask lanes, twoByte value)
+    {
+        for (unsigned int half = 0; half < 2; ++half)
+        {
+            if (((lanes >> (16 * half)) & 0xFFFF) == 0)
+                continue;
+
+            __m256i* target = reinterpret_cast<__m256i*>(words + half * 16);
+            _mm256_store_si256(target, _mm256_blendv_epi8(_mm256_load_si256(target), _mm256_set1_epi16(static_cast<short>(value)), toWordVector(lanes, half)));
+        }
+    }
+
+    void subtractWords(twoByte* words, LaneMask lanes, twoByte value)
+    {
+        const __m256i values = _mm256_set1_epi16(static_cast<short>(value));
+
+        for (unsigned int half = 0; half < 2; ++half)
+        {
+            __m256i* target = reinterpret_cast<__m256i*>(words + half * 16);
+            _mm256_store_si256(target, _mm256_sub_epi16(_mm256_load_si256(target), _mm256_and_si256(toWordVector(lanes, half), values)));
+        }
+    }
+
+    twoByte minWord(const twoByte* words, LaneMask lanes)
+    {
+        // The words of the other lanes count as 0xFFFF.
+        const __m256i all  = _mm256_set1_epi8(-1);
+        const __m256i low  = _mm256_or_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(words)),      _mm256_xor_si256(toWordVector(lanes, 0), all));
+        const __m256i high = _mm256_or_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(words + 16)), _mm256_xor_si256(toWordVector(lanes, 1), all));
+        const __m256i both = _mm256_min_epu16(low, high);
+
+        return static_cast<twoByte>(_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_min_epu16(_mm256_castsi256_si128(both), _mm256_extracti128_si256(both, 1)))));
+    }
+
+#elif defined(LOCKSTEP_SSE2)
+
+    struct ByteLanes
+    {
+        __m128i low;    // Lanes 0-15.
+        __m128i high;   // Lanes 16-31.
+    };
+
+    template<typename Operation>
+    ByteLanes apply(ByteLanes a, ByteLanes b, Operation operation) { return { operation(a.low, b.low), operation(a.high, b.high) }; }
+
+    ByteLanes load(const byte* lanes)            { return { _mm_load_si128(reinterpret_cast<const __m128i*>(lanes)), _mm_load_si128(reinterpret_cast<const __m128i*>(lanes + 16)) }; }
+    void      store(byte* lanes, ByteLanes value) { _mm_store_si128(reinterpret_cast<__m128i*>(lanes), value.low); _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 16), value.high); }
+    ByteLanes broadcast(byte value)              { const __m128i all = _mm_set1_epi8(static_cast<char>(value)); return { all, all }; }
+
+    ByteLanes add(ByteLanes a, ByteLanes b)    { return apply(a, b, [](__m128i x, __m128i y) { return _mm_add_epi8(x, y); }); }
+    ByteLanes sub(ByteLanes a, ByteLanes b)    { return apply(a, b, [](__m128i x, __m128i y) { return _mm_sub_epi8(x, y); }); }
+    ByteLanes bitAnd(ByteLanes a, ByteLanes b) { return apply(a, b, [](__m128i x, __m128i y) { return _mm_and_si128(x, y); }); }
+    ByteLanes bitOr(ByteLanes a, ByteLanes b)  { return apply(a, b, [](__m128i x, __m128i y) { return _mm_or_si128(x, y); }); }
+    ByteLanes bitXor(ByteLanes a, ByteLanes b) { return apply(a, b, [](__m128i x, __m128i y) { return _mm_xor_si128(x, y); }); }
+    ByteLanes shiftRight1(ByteLanes a)         { return apply(a, broadcast(0x7F), [](__m128i x, __m128i y) { return _mm_and_si128(_mm_srli_epi16(x, 1), y); }); }
+    ByteLanes decrement(ByteLanes a)           { return apply(a, broadcast(1), [](__m128i x, __m128i y) { return _mm_subs_epu8(x, y); }); }
+
+    ByteLanes equal(ByteLanes a, ByteLanes b)       { return apply(a, b, [](__m128i x, __m128i y) { return _mm_cmpeq_epi8(x, y); }); }
+    ByteLanes lessOrEqual(ByteLanes a, ByteLanes b) { return apply(a, b, [](__m128i x, __m128i y) { return _mm_cmpeq_epi8(_mm_max_epu8(x, y), y); }); }
+    ByteLanes flagIf(ByteLanes mask)                { return apply(mask, broadcast(1), [](__m128i x, __m128i y) { return _mm_and_si128(x, y); }); }
+    ByteLanes flagUnless(ByteLanes mask)            { return apply(mask, broadcast(1), [](__m128i x, __m128i y) { return _mm_andnot_si128(x, y); }); }
+
+    ByteLanes select(ByteLanes mask, ByteLanes a, ByteLanes b)
+    {
+        return { _mm_or_si128(_mm_and_si128(mask.low, a.low), _mm_andnot_si128(mask.low, b.low)),
+                 _mm_or_si128(_mm_and_si128(mask.high, a.high), _mm_andnot_si128(mask.high, b.high)) };
+    }
+
+    __m128i toVector16(unsigned int lanes)
+    {
+        // Repeat byte n / 8 of the 16 lane mask over 8 bytes, then test bit n % 8.
+        __m128i spread = _mm_cvtsi32_si128(static_cast<int>(lanes));
+        spread = _mm_unpacklo_epi8(spread, spread);
+        spread = _mm_unpacklo_epi16(spread, spread);
+        spread = _mm_unpacklo_epi32(spread, spread);
+
+        const __m128i bits = _mm_set_epi32(static_cast<int>(0x80402010), 0x08040201, static_cast<int>(0x80402010), 0x08040201);
+        return _mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits);
+    }
+
+    ByteLanes toVector(LaneMask lanes) { return { toVector16(lanes & 0xFFFF), toVector16(lanes >> 16) }; }
+
+    LaneMask toLaneMask(ByteLanes mask)
+    {
+        return static_cast<LaneMask>(_mm_movemask_epi8(mask.low)) | (static_cast<LaneMask>(_mm_movemask_epi8(mask.high)) << 16);
+    }
+
+    LaneMask wordsEqual(const twoByte* words, twoByte value)
+    {
+        const __m128i target = _mm_set1_epi16(static_cast<short>(value));
+        LaneMask lanes = 0;
+
+        for (unsigned int quarter = 0; quarter < 4; quarter += 2)
+        {
+            const __m128i first  = _mm_cmpeq_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(words + quarter * 8)), target);
+            const __m128i second = _mm_cmpeq_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(words + quarter * 8 + 8)), target);
+
+            lanes |= static_cast<LaneMask>(_mm_movemask_epi8(_mm_packs_epi16(first, second))) << (quarter * 8);
+        }
+
+        return lanes;
+    }
+
+    // 0xFFFF in the words of lanes 8 * quarter to 8 * quarter + 7 that are in lanes.
+    __m128i toWordVector(LaneMask lanes, unsigned int quarter)
+    {
+        const __m128i bits = _mm_setr_epi16(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+        return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(static_cast<short>((lanes >> (8 * quarter)) & 0xFF)), bits), bits);
+    }
+
+    void setWords(twoByte* words, LaneMask lanes, twoByte value)
+    {
+        const __m128i values = _mm_set1_epi16(static_cast<short>(value));
+
+        for (unsigned int quarter = 0; quarter < 4; ++quarter)
+        {
+            if (((lanes >> (8 * quarter)) & 0xFF) == 0)
+                continue;
+
+            __m128i* target    = reinterpret_cast<__m128i*>(words + quarter * 8);
+            const __m128i mask = toWordVector(lanes, quarter);
+            _mm_store_si128(target, _mm_or_si128(_mm_and_si128(mask, values), _mm_andnot_si128(mask, _mm_load_si128(target))));
+        }
+    }
+
+    void subtractWords(twoByte* words, LaneMask lanes, twoByte value)
+    {
+        const __m128i values = _mm_set1_epi16(static_cast<short>(value));
+
+        for (unsigned int quarter = 0; quarter < 4; ++quarter)
+        {
+            __m128i* target = reinterpret_cast<__m128i*>(words + quarter * 8);
+            _mm_store_si128(target, _mm_sub_epi16(_mm_load_si128(target), _mm_and_si128(toWordVector(lanes, quarter), values)));
+        }
+    }
+
+    twoByte minWord(const twoByte* words, LaneMask lanes)
+    {
+        // SSE2 only has a signed minimum: flip the sign bits around it. The words of the other lanes count as 0xFFFF.
+        const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+        const __m128i all  = _mm_set1_epi8(-1);
+
+        __m128i minimum = _mm_set1_epi16(0x7FFF);
+
+        for (unsigned int quarter = 0; quarter < 4; ++quarter)
+        {
+            const __m128i value = _mm_or_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(words + quarter * 8)), _mm_xor_si128(toWordVector(lanes, quarter), all));
+            minimum = _mm_min_epi16(minimum, _mm_xor_si128(value, sign));
+        }
+
+        minimum = _mm_min_epi16(minimum, _mm_srli_si128(minimum, 8));
+        minimum = _mm_min_epi16(minimum, _mm_srli_si128(minimum, 4));
+        minimum = _mm_min_epi16(minimum, _mm_srli_si128(minimum, 2));
+
+        return static_cast<twoByte>(_mm_cvtsi128_si32(minimum) ^ 0x8000);
+    }
+
+#else
+
+    // Portable fallback: the same operations as loops over the lanes.
+    struct ByteLanes
+    {
+        std::array<byte, c_lanes> lane;
+    };
+
+    template<typename Operation>
+    ByteLanes apply(ByteLanes a, ByteLanes b, Operation operation)
+    {
+        ByteLanes result;
+
+        for (unsigned int i = 0; i < c_lanes; ++i)
+            result.lane[i] = static_cast<byte>(operation(a.lane[i], b.lane[i]));
+
+        return result;
+    }
+
+    ByteLanes load(const byte* lanes)            { ByteLanes value; std::copy_n(lanes, c_lanes, value.lane.begin()); return value; }
+    void      store(byte* lanes, ByteLanes value) { std::copy_n(value.lane.begin(), c_lanes, lanes); }
+    ByteLanes broadcast(byte value)              { ByteLanes all; all.lane.fill(value); return all; }
+
+    ByteLanes add(ByteLanes a, ByteLanes b)    { return apply(a, b, [](byte x, byte y) { return x + y; }); }
+    ByteLanes sub(ByteLanes a, ByteLanes b)    { return apply(a, b, [](byte x, byte y) { return x - y; }); }
+    ByteLanes bitAnd(ByteLanes a, ByteLanes b) { return apply(a, b, [](byte x, byte y) { return x & y; }); }
+    ByteLanes bitOr(ByteLanes a, ByteLanes b)  { return apply(a, b, [](byte x, byte y) { return x | y; }); }
+    ByteLanes bitXor(ByteLanes a, ByteLanes b) { return apply(a, b, [](byte x, byte y) { return x ^ y; }); }
+    ByteLanes shiftRight1(ByteLanes a)         { return apply(a, a, [](byte x, byte) { return x >> 1; }); }
+    ByteLanes decrement(ByteLanes a)           { return apply(a, a, [](byte x, byte) { return (x > 0) ? x - 1 : 0; }); }
+
+    ByteLanes equal(ByteLanes a, ByteLanes b)       { return apply(a, b, [](byte x, byte y) { return (x == y) ? 0xFF : 0x00; }); }
+    ByteLanes lessOrEqual(ByteLanes a, ByteLanes b) { return apply(a, b, [](byte x, byte y) { return (x <= y) ? 0xFF : 0x00; }); }
+    ByteLanes flagIf(ByteLanes mask)                { return apply(mask, mask, [](byte x, byte) { return x & 1; }); }
+    ByteLanes flagUnless(ByteLanes mask)            { return apply(mask, mask, [](byte x, byte) { return ~x & 1; }); }
+
+    ByteLanes select(ByteLanes mask, ByteLanes a, ByteLanes b)
+    {
+        ByteLanes result;
+
+        for (unsigned int i = 0; i < c_lanes; ++i)
+            result.lane[i] = mask.lane[i] ? a.lane[i] : b.lane[i];
+
+        return result;
+    }
+
+    ByteLanes toVector(LaneMask lanes)
+    {
+        ByteLanes mask;
+
+        for (unsigned int i = 0; i < c_lanes; ++i)
+            mask.lane[i] = ((lanes >> i) & 1) ? 0xFF : 0x00;
+
+        return mask;
+    }
+
+    LaneMask toLaneMask(ByteLanes mask)
+    {
+        LaneMask lanes = 0;
+
+        for (unsigned int i = 0; i < c_lanes; ++i)
+            lanes |= static_cast<LaneMask>(mask.lane[i] >> 7) << i;
+
+        return lanes;
+    }
+
+    LaneMask wordsEqual(const twoByte* words, twoByte value)
+    {
+        LaneMask lanes = 0;
+
+        for (unsigned int i = 0; i < c_lanes; ++i)
+            lanes |= static_cast<LaneMask>(words[i] == value) << i;
+
+        return lanes;
+    }
+
+    void setWords(twoByte* words, LaneMask lanes, twoByte value)
+    {
+        forEachLane(lanes, [&](unsigned int lane) { words[lane] = value; });
+    }
+
+    void subtractWords(twoByte* words, LaneMask lanes, twoByte value)
+    {
+        forEachLane(lanes, [&](unsigned int lane) { words[lane] = static_cast<twoByte>(words[lane] - value); });
+    }
+
+    twoByte minWord(const twoByte* words, LaneMask lanes)
+    {
+        twoByte minimum = 0xFFFF;
+        forEachLane(lanes, [&](unsigned int lane) { minimum = std::min(minimum, words[lane]); });
+        return minimum;
+    }
+
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+LockstepBatch::LockstepBatch(Chip8::QuirkProfile profile)
+    : memory()
+    , display()
+    , stack()
+    , V()
+    , audioPattern()
+    , keys()
+    , PC()
+    , I()
+    , SP()
+    , delayTimer()
+    , soundTimer()
+    , audioPitch()
+    , randomState()
+    , trappedOpCode()
+    , quirkProfile(profile)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void LockstepBatch::loadLane(unsigned int lane, const Chip8State& state)
+{
+    for (unsigned int address = 0; address < Chip8State::c_memorySize; ++address)
+        memory[address][lane] = state.memory[address];
+
+    for (unsigned int row = 0; row < Chip8State::c_displayHeight; ++row)
+        display[row][lane] = state.display[row];
+
+    for (unsigned int level = 0; level < Chip8State::c_stackLevels; ++level)
+        stack[level][lane] = state.stack[level];
+
+    for (unsigned int reg = 0; reg < Chip8State::c_numRegisters; ++reg)
+        V[reg][lane] = state.V[reg];
+
+    for (unsigned int i = 0; i < Chip8State::c_audioPatternSize; ++i)
+        audioPattern[i][lane] = state.audioPattern[i];
+
+    keys[lane]        = state.keys;
+    PC[lane]          = state.PC;
+    I[lane]           = state.I;
+    SP[lane]          = state.SP;
+    delayTimer[lane]  = state.delayTimer;
+    soundTimer[lane]  = state.soundTimer;
+    audioPitch[lane]  = state.audioPitch;
+    randomState[lane] = state.randomState;
+
+    const LaneMask bit = LaneMask(1) << lane;
+
+    drawFlags    = state.drawFlag ? (drawFlags | bit)   : (drawFlags & ~bit);
+    vblankLanes  = state.vblank   ? (vblankLanes | bit) : (vblankLanes & ~bit);
+    trappedLanes &= ~bit;
+    activeLanes  |= bit;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void LockstepBatch::saveLane(unsigned int lane, Chip8State& state) const
+{
+    for (unsigned int address = 0; address < Chip8State::c_memorySize; ++address)
+        state.memory[address] = memory[address][lane];
+
+    for (unsigned int row = 0; row < Chip8State::c_displayHeight; ++row)
+        state.display[row] = display[row][lane];
+
+    for (unsigned int level = 0; level < Chip8State::c_stackLevels; ++level)
+        state.stack[level] = stack[level][lane];
+
+    for (unsigned int reg = 0; reg < Chip8State::c_numRegisters; ++reg)
+        state.V[reg] = V[reg][lane];
+
+    for (unsigned int i = 0; i < Chip8State::c_audioPatternSize; ++i)
+        state.audioPattern[i] = audioPattern[i][lane];
+
+    state.keys        = keys[lane];
+    state.PC          = PC[lane];
+    state.I           = I[lane];
+    state.SP          = SP[lane];
+    state.delayTimer  = delayTimer[lane];
+    state.soundTimer  = soundTimer[lane];
+    state.audioPitch  = audioPitch[lane];
+    state.randomState = randomState[lane];
+    state.drawFlag    = ((drawFlags >> lane) & 1) != 0;
+    state.vblank      = ((vblankLanes >> lane) & 1) != 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void LockstepBatch::getDisplayRows(unsigned int lane, Chip8State::DisplayRows& rows) const
+{
+    for (unsigned int row = 0; row < Chip8State::c_displayHeight; ++row)
+        rows[row] = display[row][lane];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void LockstepBatch::emulateCycles(unsigned int count)
+{
+    // Lanes count their instructions in 16 bits, longer runs are split (lanes don't interact, this changes nothing).
+    constexpr unsigned int c_maxRun = 0xFFFF;
+
+    for (; count > 0; count -= std::min(count, c_maxRun))
+    {
+        switch (quirkProfile)
+        {
+            case Chip8::QuirkProfile::CosmacVip: run<Chip8::QuirkProfile::CosmacVip>(std::min(count, c_maxRun)); break;
+            case Chip8::QuirkProfile::SuperChip: run<Chip8::QuirkProfile::SuperChip>(std::min(count, c_maxRun)); break;
+            case Chip8::QuirkProfile::XoChip:    run<Chip8::QuirkProfile::XoChip>(std::min(count, c_maxRun));    break;
+            default:                             run<Chip8::QuirkProfile::Chip8>(std::min(count, c_maxRun));     break;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<Chip8::QuirkProfile Profile>
+void LockstepBatch::run(unsigned int count)
+{
+    if (activeLanes == 0)
+        return;
+
+    // A step executes one instruction for a group of lanes, a lane is done when it has executed count.
+    alignas(32) Lanes<twoByte> remaining;
+    remaining.fill(static_cast<twoByte>(count));
+
+    LaneMask pending = activeLanes;
+
+    while (pending != 0)
+    {
+        // Usually every pending lane is at the same address. When not, the lowest address runs first,
+        // so lanes behind on a common path catch up with the others.
+        twoByte pc = PC[lowestLane(pending)];
+        LaneMask group = wordsEqual(PC.data(), pc) & pending;
+
+        if (group != pending)
+        {
+            pc    = minWord(PC.data(), pending);
+            group = wordsEqual(PC.data(), pc) & pending;
+        }
+
+        // The group keeps running while it is the one at the lowest address, until one of its lanes is done
+        // or they split up. Its next address is known without looking at the lanes.
+        const LaneMask others       = pending & ~group;
+        const unsigned int limit    = (others != 0) ? minWord(PC.data(), others) : 0x10000;
+        const unsigned int numSteps = minWord(remaining.data(), group);
+        unsigned int step = 0;
+
+        while (step < numSteps)
+        {
+            // Lanes that stored different code at that address run their own instruction in a later step.
+            const unsigned int address = pc & (Chip8State::c_memorySize - 1);
+            const unsigned int next    = (address + 1) & (Chip8State::c_memorySize - 1);
+            const unsigned int leader  = lowestLane(group);
+            const byte high = memory[address][leader];
+            const byte low  = memory[next][leader];
+
+            const LaneMask sameCode = group & toLaneMask(bitAnd(equal(load(memory[address].data()), broadcast(high)), equal(load(memory[next].data()), broadcast(low))));
+
+            if (sameCode != group)
+            {
+                if (step > 0)
+                    break;
+
+                group = sameCode;
+            }
+
+            const int nextPC = execute<Profile>(static_cast<twoByte>(high << 8 | low), pc, group);
+            ++step;
+
+            if (nextPC == c_diverged || static_cast<unsigned int>(nextPC) >= limit)
+                break;
+
+            pc = static_cast<twoByte>(nextPC);
+        }
+
+        subtractWords(remaining.data(), group, static_cast<twoByte>(step));
+        pending &= ~wordsEqual(remaining.data(), 0);
+
+        steps += step;
+    }
+
+    laneInstructions += static_cast<std::uint64_t>(count) * std::bitset<c_maxLanes>(activeLanes).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<Chip8::QuirkProfile Profile>
+int LockstepBatch::execute(twoByte opCode, twoByte pc, LaneMask group)
+{
+    // Same instruction definitions as Chip8::JumpTable, applied to every lane of group. Returns the address
+    // all of them continue at, or c_diverged.
+    constexpr Chip8::Quirks c_quirks = Chip8::getQuirks(Profile);
+
+    const twoByte NNN = opCode & 0x0FFF;
+    const byte    NN  = opCode & 0x00FF;
+    const byte    N   = opCode & 0x000F;
+    const byte    X   = (opCode & 0x0F00) >> 8;
+    const byte    Y   = (opCode & 0x00F0) >> 4;
+
+    const ByteLanes lanes = toVector(group);
+
+    const auto readV  = [&](unsigned int reg) { return load(V[reg].data()); };
+    const auto writeV = [&](unsigned int reg, ByteLanes value) { store(V[reg].data(), select(lanes, value, load(V[reg].data()))); };
+
+    const auto jump = [&](LaneMask jumping, twoByte address)
+    {
+        setWords(PC.data(), jumping, address);
+
+        if (jumping == group)
+            return static_cast<int>(address);
+
+        return (jumping == 0) ? static_cast<int>(pc) : c_diverged;
+    };
+
+    const auto advance = [&](LaneMask advancing) { return jump(advancing, static_cast<twoByte>(pc + 2)); };
+
+    const auto skipIf = [&](LaneMask skipping)
+    {
+        skipping &= group;
+        advance(group & ~skipping);
+        setWords(PC.data(), skipping, static_cast<twoByte>(pc + 4));
+
+        if (skipping == 0 || skipping == group)
+            return static_cast<int>(static_cast<twoByte>(pc + ((skipping == 0) ? 2 : 4)));
+
+        return c_diverged;
+    };
+
+    const auto pressedLanes = [&]()
+    {
+        LaneMask pressed = 0;
+        forEachLane(group, [&](unsigned int lane) { pressed |= static_cast<LaneMask>((keys[lane] >> (V[X][lane] & 0xF)) & 1) << lane; });
+        return pressed;
+    };
+
+    switch (opCode >> 12)
+    {
+        case 0x0:
+            if (opCode == 0x00E0)                                                                       // CLS
+            {
+                for (auto& row : display)
+                    forEachLane(group, [&](unsigned int lane) { row[lane] = 0; });
+
+                drawFlags |= group;
+                return advance(group);
+            }
+
+            if (opCode == 0x00EE)                                                                       // RET
+            {
+                forEachLane(group, [&](unsigned int lane)
+                {
+                    --SP[lane];
+                    PC[lane] = static_cast<twoByte>(stack[SP[lane] & (Chip8State::c_stackLevels - 1)][lane] + 2);
+                });
+
+                return c_diverged;
+            }
+
+            return trap(opCode, pc, group);
+
+        case 0x1: return jump(group, NNN);                                                              // JMP
+        case 0x2:                                                                                       // CALL
+            forEachLane(group, [&](unsigned int lane) { stack[SP[lane] & (Chip8State::c_stackLevels - 1)][lane] = pc; ++SP[lane]; });
+            return jump(group, NNN);
+
+        case 0x3: return skipIf(toLaneMask(equal(readV(X), broadcast(NN))));                            // SE
+        case 0x4: return skipIf(~toLaneMask(equal(readV(X), broadcast(NN))));                           // SNE
+        case 0x5: return skipIf(toLaneMask(equal(readV(X), readV(Y))));                                 // SE
+        case 0x6: writeV(X, broadcast(NN));                return advance(group);                       // LD
+        case 0x7: writeV(X, add(readV(X), broadcast(NN))); return advance(group);                       // ADD
+
+        case 0x8:
+            switch (N)
+            {
+                case 0x0: writeV(X, readV(Y)); break;                                                   // LD
+                case 0x1: writeV(X, bitOr(readV(X), readV(Y)));  if (c_quirks.logicResetsVF) writeV(0xF, broadcast(0)); break;  // OR
+                case 0x2: writeV(X, bitAnd(readV(X), readV(Y))); if (c_quirks.logicResetsVF) writeV(0xF, broadcast(0)); break;  // AND
+                case 0x3: writeV(X, bitXor(readV(X), readV(Y))); if (c_quirks.logicResetsVF) writeV(0xF, broadcast(0)); break;  // XOR
+
+                // Each step reloads its operands, VF may be one of them.
+                case 0x4: writeV(0xF, flagUnless(lessOrEqual(readV(X), add(readV(X), readV(Y))))); writeV(X, add(readV(X), readV(Y))); break;  // ADD
+                case 0x5: writeV(0xF, flagUnless(lessOrEqual(readV(X), readV(Y))));                writeV(X, sub(readV(X), readV(Y))); break;  // SUB
+                case 0x7: writeV(0xF, flagUnless(lessOrEqual(readV(Y), readV(X))));                writeV(X, sub(readV(Y), readV(X))); break;  // SUBN
+                case 0x6:                                                                                                                      // SHR
+                    if (c_quirks.shiftUsesVY)
+                        writeV(X, readV(Y));
+
+                    writeV(0xF, bitAnd(readV(X), broadcast(1)));
+                    writeV(X, shiftRight1(readV(X)));
+                    break;
+                case 0xE:                                                                                                                      // SHL
+                    if (c_quirks.shiftUsesVY)
+                        writeV(X, readV(Y));
+
+                    writeV(0xF, flagIf(lessOrEqual(broadcast(0x80), readV(X))));
+                    writeV(X, add(readV(X), readV(X)));
+                    break;
+
+                default:
+                    return trap(opCode, pc, group);
+            }
+
+            return advance(group);
+
+        case 0x9: return skipIf(~toLaneMask(equal(readV(X), readV(Y))));                                // SNE
+        case 0xA: setWords(I.data(), group, NNN); return advance(group);                                // LD
+
+        case 0xB:                                                                                       // JMP
+            forEachLane(group, [&](unsigned int lane) { PC[lane] = static_cast<twoByte>(NNN + V[c_quirks.jumpUsesVX ? X : 0][lane]); });
+            return c_diverged;
+
+        case 0xC:                                                                                       // RND
+            forEachLane(group, [&](unsigned int lane) { V[X][lane] = randomNext(lane) & NN; });
+            return advance(group);
+
+        case 0xD:                                                                                       // DRW
+        {
+            // With the display wait quirk, lanes without a vertical blank since their last draw stay on the instruction.
+            LaneMask drawing = group;
+
+            if (c_quirks.displayWait)
+            {
+                drawing     &= vblankLanes;
+                vblankLanes &= ~drawing;
+            }
+
+            forEachLane(drawing, [&](unsigned int lane) { drawSprite<c_quirks.clipSprites>(lane, X, Y, N); });
+
+            drawFlags |= drawing;
+            return advance(drawing);
+        }
+
+        case 0xE:
+            if (NN == 0x9E)
+                return skipIf(pressedLanes());                                                          // SKP
+
+            if (NN == 0xA1)
+                return skipIf(~pressedLanes());                                                         // SKNP
+
+            return trap(opCode, pc, group);
+
+        case 0xF:
+            switch (NN)
+            {
+                case 0x07: writeV(X, load(delayTimer.data())); break;                                              // LD
+                case 0x15: store(delayTimer.data(), select(lanes, readV(X), load(delayTimer.data()))); break;     // LD
+                case 0x18: store(soundTimer.data(), select(lanes, readV(X), load(soundTimer.data()))); break;     // LD
+                case 0x0A:                                                                                          // LD
+                {
+                    // Lanes without a key pressed wait on the instruction.
+                    const LaneMask pressed = group & ~wordsEqual(keys.data(), 0);
+
+                    forEachLane(pressed, [&](unsigned int lane)
+                    {
+                        byte key = 0;
+
+                        while (key < Chip8State::c_numKeys - 1 && !((keys[lane] >> key) & 1))
+                            ++key;
+
+                        V[X][lane] = key;
+                    });
+
+                    return advance(pressed);
+                }
+                case 0x1E:                                                                                          // ADD
+                    forEachLane(group, [&](unsigned int lane)
+                    {
+                        V[0xF][lane] = (static_cast<twoByte>(I[lane] + V[X][lane]) > 0xFFF) ? 1 : 0;
+                        I[lane]      = static_cast<twoByte>(I[lane] + V[X][lane]);
+                    });
+                    break;
+                case 0x29: forEachLane(group, [&](unsigned int lane) { I[lane] = static_cast<twoByte>(V[X][lane] * 5); }); break;  // LD
+                case 0x33:                                                                                          // LD (BCD)
+                    forEachLane(group, [&](unsigned int lane)
+                    {
+                        const byte value = V[X][lane];
+                        memory[(I[lane] + 0) & (Chip8State::c_memorySize - 1)][lane] = value / 100;
+                        memory[(I[lane] + 1) & (Chip8State::c_memorySize - 1)][lane] = (value / 10) % 10;
+                        memory[(I[lane] + 2) & (Chip8State::c_memorySize - 1)][lane] = value % 10;
+                    });
+                    break;
+                case 0x55:                                                                                          // LD
+                    forEachLane(group, [&](unsigned int lane)
+                    {
+                        for (unsigned int reg = 0; reg <= X; ++reg)
+                            memory[(I[lane] + reg) & (Chip8State::c_memorySize - 1)][lane] = V[reg][lane];
+
+                        if (c_quirks.loadStoreIncrementsI)
+                            I[lane] = static_cast<twoByte>(I[lane] + X + 1);
+                    });
+                    break;
+                case 0x65:                                                                                          // LD
+                    forEachLane(group, [&](unsigned int lane)
+                    {
+                        for (unsigned int reg = 0; reg <= X; ++reg)
+                            V[reg][lane] = memory[(I[lane] + reg) & (Chip8State::c_memorySize - 1)][lane];
+
+                        if (c_quirks.loadStoreIncrementsI)
+                            I[lane] = static_cast<twoByte>(I[lane] + X + 1);
+                    });
+                    break;
+                case 0x02:                                                                                          // AUDIO (XO-CHIP)
+                    if (Profile != Chip8::QuirkProfile::XoChip)
+                        return trap(opCode, pc, group);
+
+                    forEachLane(group, [&](unsigned int lane)
+                    {
+                        for (unsigned int i = 0; i < Chip8State::c_audioPatternSize; ++i)
+                            audioPattern[i][lane] = memory[(I[lane] + i) & (Chip8State::c_memorySize - 1)][lane];
+                    });
+                    break;
+                case 0x3A:                                                                                          // PITCH (XO-CHIP)
+                    if (Profile != Chip8::QuirkProfile::XoChip)
+                        return trap(opCode, pc, group);
+
+                    store(audioPitch.data(), select(lanes, readV(X), load(audioPitch.data())));
+                    break;
+                default:
+                    return trap(opCode, pc, group);
+            }
+
+            return advance(group);
+    }
+
+    return c_diverged;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<bool ClipSprites>
+void LockstepBatch::drawSprite(unsigned int lane, byte X, byte Y, byte N)
+{
+    // Chip8::drawSprite() for one lane.
+    V[0xF][lane] = 0;
+
+    const unsigned int xStart = V[X][lane] % Chip8State::c_displayWidth;
+    const unsigned int yStart = V[Y][lane] % Chip8State::c_displayHeight;
+
+    const unsigned int numRows = ClipSprites ? std::min<unsigned int>(N, Chip8State::c_displayHeight - yStart) : N;
+
+    for (unsigned int yPos = 0; yPos < numRows; ++yPos)
+    {
+        const std::uint64_t spriteRow = static_cast<std::uint64_t>(memory[(I[lane] + yPos) & (Chip8State::c_memorySize - 1)][lane]) << (Chip8State::c_displayWidth - 8);
+        const std::uint64_t pixels    = ClipSprites ? (spriteRow >> xStart)
+                                                    : (spriteRow >> xStart) | (spriteRow << ((Chip8State::c_displayWidth - xStart) % Chip8State::c_displayWidth));
+
+        std::uint64_t& displayRow = display[(yStart + yPos) % Chip8State::c_displayHeight][lane];
+
+        if (displayRow & pixels)
+            V[0xF][lane] = 1;
+
+        displayRow ^= pixels;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int LockstepBatch::trap(twoByte opCode, twoByte pc, LaneMask group)
+{
+    trappedLanes |= group;
+    forEachLane(group, [&](unsigned int lane) { trappedOpCode[lane] = opCode; });
+
+    setWords(PC.data(), group, static_cast<twoByte>(pc + 2));
+
+    return static_cast<twoByte>(pc + 2);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void LockstepBatch::updateTimers()
+{
+    vblankLanes |= activeLanes;
+
+    store(delayTimer.data(), decrement(load(delayTimer.data())));
+    store(soundTimer.data(), decrement(load(soundTimer.data())));
+}
+
+/////////////////////////////////////////////////////////////////////////////
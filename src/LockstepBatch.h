@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "Chip8.h"
+
+// Up to 32 machines running the same game in lockstep, for fuzzing and search runs whose instances only
+// differ in seed or input. The state is stored as structure of arrays, one lane per machine: an instruction
+// is decoded once and executed with vector operations for all the lanes at its address that hold the same
+// opcode. Lanes that diverge (taken skips, jumps through registers, code they stored) run as separate
+// groups, the lowest address first, so they join up again where their paths meet.
+//
+// Each lane executes exactly the instructions a Chip8 started from the same state would, in the same order:
+// lanes are loaded from and saved to Chip8State and end bit identical to the single machine engines.
+//
+// Vector operations use AVX2 when compiled for it, SSE2 on other x86 builds and plain loops elsewhere (or
+// with CHIP8_LOCKSTEP_SCALAR defined). The object holds 32 copies of memory, allocate it on the heap.
+class LockstepBatch
+{
+public:
+    static constexpr unsigned int c_maxLanes = 32;
+
+    using LaneMask = std::uint32_t;     // Bit n for lane n.
+
+    explicit LockstepBatch(Chip8::QuirkProfile profile = Chip8::QuirkProfile::Chip8);
+
+    Chip8::QuirkProfile getQuirkProfile() const { return quirkProfile; }
+
+    // A lane runs from the first time it is loaded. Initialize the state through a Chip8 (initialize(),
+    // loadGame(), then getState()); the lanes don't have to be at the same point.
+    void loadLane(unsigned int lane, const Chip8State& state);
+    void saveLane(unsigned int lane, Chip8State& state) const;
+
+    LaneMask getActiveLanes() const { return activeLanes; }
+
+    void setKeys(unsigned int lane, twoByte keyMask) { keys[lane] = keyMask; }     // Bit k set while key k is pressed.
+
+    // Lanes that drew since their flag was last cleared, as Chip8::getDrawFlag() per lane.
+    LaneMask getDrawFlags() const           { return drawFlags; }
+    void     clearDrawFlags(LaneMask lanes) { drawFlags &= ~lanes; }
+
+    void getDisplayRows(unsigned int lane, Chip8State::DisplayRows& rows) const;
+
+    void emulateCycles(unsigned int count);     // Every active lane executes count instructions.
+    void updateTimers();                        // 60 Hz timer update of every lane.
+
+    // Undefined opcodes are skipped like in Chip8, and remembered per lane.
+    LaneMask getTrappedLanes() const                   { return trappedLanes; }
+    twoByte  getTrappedOpCode(unsigned int lane) const { return trappedOpCode[lane]; }
+    void     clearTraps()                              { trappedLanes = 0; }
+
+    // Lane instructions per decoded instruction so far: the number of active lanes while they never diverge.
+    double getLanesPerStep() const { return (steps > 0) ? static_cast<double>(laneInstructions) / steps : 0.0; }
+
+private:
+    template<typename T>
+    using Lanes = std::array<T, c_maxLanes>;
+
+    template<Chip8::QuirkProfile Profile>
+    void run(unsigned int count);
+
+    static constexpr int c_diverged = -1;
+
+    template<Chip8::QuirkProfile Profile>
+    int execute(twoByte opCode, twoByte pc, LaneMask group);
+
+    template<bool ClipSprites>
+    void drawSprite(unsigned int lane, byte X, byte Y, byte N);
+
+    int trap(twoByte opCode, twoByte pc, LaneMask group);
+
+    byte randomNext(unsigned int lane)
+    {
+        // Same xorshift32 as Chip8::randomNext(), one generator per lane.
+        std::uint32_t& state = randomState[lane];
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<byte>(state >> 24);
+    }
+
+    // Structure of arrays: element [n][lane] is element n of that lane's Chip8State.
+    alignas(32) std::array<Lanes<byte>, Chip8State::c_memorySize>           memory;
+    alignas(32) std::array<Lanes<std::uint64_t>, Chip8State::c_displayHeight> display;
+    alignas(32) std::array<Lanes<twoByte>, Chip8State::c_stackLevels>       stack;
+    alignas(32) std::array<Lanes<byte>, Chip8State::c_numRegisters>         V;
+    alignas(32) std::array<Lanes<byte>, Chip8State::c_audioPatternSize>     audioPattern;
+
+    alignas(32) Lanes<twoByte> keys;
+    alignas(32) Lanes<twoByte> PC;
+    alignas(32) Lanes<twoByte> I;
+    alignas(32) Lanes<byte>    SP;
+    alignas(32) Lanes<byte>    delayTimer;
+    alignas(32) Lanes<byte>    soundTimer;
+    alignas(32) Lanes<byte>    audioPitch;
+    alignas(32) Lanes<std::uint32_t> randomState;
+
+    LaneMask drawFlags    = 0;
+    LaneMask vblankLanes  = 0;
+    LaneMask trappedLanes = 0;
+    Lanes<twoByte> trappedOpCode;
+
+    Chip8::QuirkProfile quirkProfile;
+    LaneMask activeLanes = 0;
+
+    std::uint64_t laneInstructions = 0;
+    std::uint64_t steps            = 0;
+};
@@ -0,0 +1,25 @@
+#include "MediaBackend.h"
+#include "NullBackend.h"
+#include "SoftwareBackend.h"
+
+#ifndef CHIP8_NO_SDL
+#include "SdlBackend.h"
+#endif
+
+std::unique_ptr<MediaBackend> MediaBackend::create(const std::string& name)
+{
+#ifndef CHIP8_NO_SDL
+    if (name == "sdl")
+        return std::make_unique<SdlBackend>();
+#endif
+
+    if (name == "software")
+        return std::make_unique<SoftwareBackend>();
+
+    if (name == "null")
+        return std::make_unique<NullBackend>();
+
+    return nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
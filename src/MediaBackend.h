@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Chip8State.h"
+
+class ToneGenerator;
+
+// Where the emulator's frames, sound and key presses go. main.cpp only talks to this interface, the
+// implementation is picked at start-up so the same binary runs in a window, headless, or feeding
+// another process:
+//   sdl       SDL window, audio device and keyboard (SdlBackend.h).
+//   software  CPU upscaling into an ARGB8888 buffer, optionally in shared memory (SoftwareBackend.h).
+//   null      Nothing at all (NullBackend.h).
+// Every call is made from the thread that created the backend.
+class MediaBackend
+{
+public:
+    struct VideoOptions
+    {
+        std::string  title        = "CHIP-8 Emulator";
+        unsigned int windowWidth  = 640;
+        unsigned int windowHeight = 320;
+
+        // Software backend.
+        unsigned int scale       = 10;      // Output pixels per CHIP-8 pixel, both ways.
+        unsigned int phosphor    = 0;       // Percent of its brightness a pixel keeps per frame once off, 0 for none.
+        std::string  sharedMemoryName;      // Publish the output under this name, empty for a private buffer.
+    };
+
+    virtual ~MediaBackend() = default;
+
+    virtual bool initialize(const VideoOptions& options, std::string& error) = 0;
+    virtual void initializeSound(ToneGenerator& toneGenerator) = 0;     // The generator is pulled by the audio output until uninitialize().
+    virtual void uninitialize() = 0;
+
+    virtual void renderDisplay(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows) = 0;     // Bit y of dirtyRows set when row y changed.
+
+    // True while the output keeps changing without a new frame (a fading phosphor). The caller then
+    // renders the last frame again at the 60 Hz frame rate, with no dirty rows.
+    virtual bool isAnimating() const { return false; }
+
+    virtual void handleInputEvents(bool& quit) = 0;
+    virtual twoByte getKeyMask() const = 0;             // Bit k set while key k is pressed.
+    virtual void setWindowTitle(const std::string& title) = 0;
+
+    // nullptr for an unknown name, or "sdl" in a build with CHIP8_NO_SDL defined.
+    static std::unique_ptr<MediaBackend> create(const std::string& name);
+};
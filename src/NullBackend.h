@@ -0,0 +1,18 @@
+#pragma once
+#include "MediaBackend.h"
+
+// Backend that drops everything: no output, no sound, no keys. For headless runs (replays, servers)
+// where the cost of presenting frames should be zero.
+class NullBackend : public MediaBackend
+{
+public:
+    bool initialize(const VideoOptions&, std::string&) override { return true; }
+    void initializeSound(ToneGenerator&) override {}
+    void uninitialize() override {}
+
+    void renderDisplay(const Chip8State::DisplayRows&, std::uint32_t) override {}
+
+    void handleInputEvents(bool&) override {}
+    twoByte getKeyMask() const override { return 0; }
+    void setWindowTitle(const std::string&) override {}
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include "Chip8State.h"
+
+// Machine snapshot whose memory is split in pages shared copy-on-write with a base snapshot.
+// Branches forked from a common prefix mostly differ in a few pages of work RAM while the font
+// and program pages stay identical, so keeping many of them only costs the pages they changed.
+class PagedSnapshot
+{
+public:
+    static constexpr unsigned int c_pageSize = 256;
+    static constexpr unsigned int c_numPages = Chip8State::c_memorySize / c_pageSize;
+
+    using Page = std::array<byte, c_pageSize>;
+
+    // Takes a snapshot of state. Pages identical to the same page of base are shared instead of copied.
+    void capture(const Chip8State& state, const PagedSnapshot* base = nullptr)
+    {
+        for (unsigned int page = 0; page < c_numPages; ++page)
+        {
+            const byte* source = state.memory.data() + page * c_pageSize;
+
+            if (base && base->pages[page] && std::memcmp(base->pages[page]->data(), source, c_pageSize) == 0)
+            {
+                pages[page] = base->pages[page];
+            }
+            else if (!pages[page] || std::memcmp(pages[page]->data(), source, c_pageSize) != 0)
+            {
+                // An unchanged page is kept, shared or not. Only a page nobody else shares may be rewritten in place.
+                auto copy = (pages[page] && pages[page].use_count() == 1) ? std::const_pointer_cast<Page>(pages[page]) : std::make_shared<Page>();
+                std::memcpy(copy->data(), source, c_pageSize);
+                pages[page] = std::move(copy);
+            }
+        }
+
+        std::memcpy(registers.data(), reinterpret_cast<const byte*>(&state) + c_registersOffset, registers.size());
+    }
+
+    // Writes the snapshot back into state (then loaded with Chip8::loadState).
+    void restore(Chip8State& state) const
+    {
+        for (unsigned int page = 0; page < c_numPages; ++page)
+            std::memcpy(state.memory.data() + page * c_pageSize, pages[page]->data(), c_pageSize);
+
+        std::memcpy(reinterpret_cast<byte*>(&state) + c_registersOffset, registers.data(), registers.size());
+    }
+
+    bool isShared(unsigned int page) const { return pages[page].use_count() > 1; }
+
+    bool empty() const { return !pages[0]; }
+
+private:
+    // Everything after memory (display, stack, registers, timers) is small and stored inline.
+    static constexpr std::size_t c_registersOffset = sizeof(Chip8State::memory);
+
+    static_assert(offsetof(Chip8State, memory) == 0, "memory must come first in Chip8State");
+    static_assert(Chip8State::c_memorySize % c_pageSize == 0, "memory must be a whole number of pages");
+
+    std::array<std::shared_ptr<const Page>, c_numPages> pages;
+    std::array<byte, sizeof(Chip8State) - c_registersOffset> registers;
+};
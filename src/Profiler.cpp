@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include "Profiler.h"
+
+Profiler::Profiler()
+{
+    clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::clear()
+{
+    opCodeClassCounts.fill(0);
+    pcCounts.fill(0);
+    depthCounts.fill(0);
+
+    instructions    = 0;
+    drawCalls       = 0;
+    spriteRows      = 0;
+    delaySpinCycles = 0;
+    maxDepth        = 0;
+
+    callNodes.assign(1, CallNode{ Chip8State::c_programStart, -1, 0, {} });
+    currentNode = 0;
+
+    lastDelayReadPC          = -1;
+    lastDelayReadInstruction = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::onInstruction(twoByte pc, twoByte opCode, byte stackPointer)
+{
+    ++opCodeClassCounts[getOpCodeClass(opCode)];
+    ++pcCounts[pc & (Chip8State::c_memorySize - 1)];
+    ++depthCounts[std::min<unsigned int>(stackPointer, c_maxTrackedDepth)];
+
+    maxDepth = std::max(maxDepth, stackPointer);
+
+    // Back at the top level (reset, save state loaded, unbalanced returns): the call path restarts from the root.
+    if (stackPointer == 0)
+        currentNode = 0;
+
+    ++callNodes[currentNode].instructions;
+
+    switch (opCode >> 12)
+    {
+        case 0x0:
+            if (opCode == 0x00EE && callNodes[currentNode].parent >= 0)
+                currentNode = callNodes[currentNode].parent;
+            break;
+
+        case 0x2:
+            currentNode = getChild(currentNode, opCode & 0x0FFF);
+            break;
+
+        case 0xF:
+            if ((opCode & 0x00FF) == 0x07)
+            {
+                if (lastDelayReadPC == pc && instructions - lastDelayReadInstruction <= c_maxSpinLoopCycles)
+                    delaySpinCycles += instructions - lastDelayReadInstruction;
+
+                lastDelayReadPC          = pc;
+                lastDelayReadInstruction = instructions;
+            }
+            break;
+    }
+
+    ++instructions;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int Profiler::getChild(int node, twoByte address)
+{
+    const auto it = callNodes[node].children.find(address);
+
+    if (it != callNodes[node].children.end())
+        return it->second;
+
+    const int child = static_cast<int>(callNodes.size());
+
+    callNodes.push_back(CallNode{ address, node, 0, {} });
+    callNodes[node].children.emplace(address, child);
+
+    return child;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::merge(const Profiler& other)
+{
+    for (std::size_t i = 0; i < opCodeClassCounts.size(); ++i)
+        opCodeClassCounts[i] += other.opCodeClassCounts[i];
+
+    for (std::size_t i = 0; i < pcCounts.size(); ++i)
+        pcCounts[i] += other.pcCounts[i];
+
+    for (std::size_t i = 0; i < depthCounts.size(); ++i)
+        depthCounts[i] += other.depthCounts[i];
+
+    instructions    += other.instructions;
+    drawCalls       += other.drawCalls;
+    spriteRows      += other.spriteRows;
+    delaySpinCycles += other.delaySpinCycles;
+    maxDepth         = std::max(maxDepth, other.maxDepth);
+
+    mergeCalls(other, 0, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::mergeCalls(const Profiler& other, int otherNode, int node)
+{
+    callNodes[node].instructions += other.callNodes[otherNode].instructions;
+
+    for (const auto& child : other.callNodes[otherNode].children)
+        mergeCalls(other, child.second, getChild(node, child.first));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::writeFoldedStacks(std::ostream& output, const std::string& rootName) const
+{
+    writeFoldedNode(output, 0, rootName);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::writeFoldedNode(std::ostream& output, int node, const std::string& path) const
+{
+    if (callNodes[node].instructions > 0)
+        output << path << ' ' << callNodes[node].instructions << '\n';
+
+    for (const auto& child : callNodes[node].children)
+    {
+        std::ostringstream frame;
+        frame << "sub_" << std::hex << std::uppercase << std::setw(3) << std::setfill('0') << child.first;
+
+        writeFoldedNode(output, child.second, path + ';' + frame.str());
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Profiler::writeCsv(std::ostream& output) const
+{
+    output << "kind,key,count\n";
+    output << "total,instructions," << instructions << '\n';
+
+    for (unsigned int opCodeClass = 0; opCodeClass < opCodeClassCounts.size(); ++opCodeClass)
+    {
+        if (opCodeClassCounts[opCodeClass] > 0)
+        {
+            // A class index is the opcode class bits shifted down, rebuild a representative opcode from it.
+            const unsigned int group = opCodeClass >> 8;
+            const twoByte opCode = static_cast<twoByte>((group << 12) | (opCodeClass & 0xFF));
+
+            output << "opcode," << getOpCodeClassName(opCode) << ',' << opCodeClassCounts[opCodeClass] << '\n';
+        }
+    }
+
+    for (unsigned int address = 0; address < pcCounts.size(); ++address)
+    {
+        if (pcCounts[address] > 0)
+            output << "pc,0x" << std::hex << std::uppercase << std::setw(3) << std::setfill('0') << address << std::dec << ',' << pcCounts[address] << '\n';
+    }
+
+    output << "draw,calls," << drawCalls  << '\n';
+    output << "draw,rows,"  << spriteRows << '\n';
+
+    for (unsigned int depth = 0; depth < depthCounts.size(); ++depth)
+    {
+        if (depthCounts[depth] > 0)
+            output << "depth," << depth << ',' << depthCounts[depth] << '\n';
+    }
+
+    output << "depth,max," << static_cast<unsigned int>(maxDepth) << '\n';
+    output << "delay,spin_cycles," << delaySpinCycles << '\n';
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::string Profiler::getOpCodeClassName(twoByte opCode)
+{
+    static const char* const c_digits = "0123456789ABCDEF";
+
+    const unsigned int group = opCode >> 12;
+    const char groupDigit = c_digits[group];
+    const std::string lowByte = { c_digits[(opCode >> 4) & 0xF], c_digits[opCode & 0xF] };
+
+    switch (group)
+    {
+        case 0x0: return ((opCode & 0x0FFF) == 0x0E0 || (opCode & 0x0FFF) == 0x0EE) ? "00" + lowByte : "0NNN";
+        case 0x5:
+        case 0x9: return std::string(1, groupDigit) + "XY0";
+        case 0x8: return std::string("8XY") + c_digits[opCode & 0xF];
+        case 0xD: return "DXYN";
+        case 0xE:
+        case 0xF: return std::string(1, groupDigit) + "X" + lowByte;
+
+        case 0x3:
+        case 0x4:
+        case 0x6:
+        case 0x7:
+        case 0xC: return std::string(1, groupDigit) + "XNN";
+
+        default:  return std::string(1, groupDigit) + "NNN";
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
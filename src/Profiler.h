@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Chip8State.h"
+
+// Hot-spot profiler for the emulated program. Chip8 only calls it when built with CHIP8_PROFILER
+// defined, otherwise the hooks compile to nothing and attaching a profiler isn't available.
+//
+// Every executed instruction is counted per opcode class and per address, and charged to the current
+// subroutine call path, which is followed through CALL (2NNN) and RET (00EE) and resynced on the stack
+// pointer. A delay timer read (FX07) executed again at the same address within a few instructions is a
+// busy wait, the instructions in between are counted as delay spin.
+class Profiler
+{
+public:
+    Profiler();
+
+    void onInstruction(twoByte pc, twoByte opCode, byte stackPointer);
+
+    // A DXYN that draws, after any display wait: a DXYN stalled on the vertical blank only counts as an instruction.
+    void onDraw(byte rows) { ++drawCalls; spriteRows += rows; }
+
+    // Adds the counts of other (same ROM, another run) into this one.
+    void merge(const Profiler& other);
+    void clear();
+
+    // One line per call path: "<rootName>;sub_2A4;sub_3F0 <instructions>", input for flamegraph.pl and compatible viewers.
+    void writeFoldedStacks(std::ostream& output, const std::string& rootName) const;
+
+    // kind,key,count lines: opcode classes, addresses, draw calls and rows, call depths and delay spin.
+    void writeCsv(std::ostream& output) const;
+
+    std::uint64_t getInstructions() const     { return instructions; }
+    std::uint64_t getDelaySpinCycles() const  { return delaySpinCycles; }
+
+    // Opcode class as written in the opcode tables ("8XY4", "FX33", "0NNN" for every 0NNN but 00E0 and 00EE).
+    static std::string getOpCodeClassName(twoByte opCode);
+
+private:
+    static constexpr unsigned int c_maxTrackedDepth  = Chip8State::c_stackLevels;
+    static constexpr unsigned int c_maxSpinLoopCycles = 8;      // Longest delay timer polling loop recognized as a busy wait.
+
+    struct CallNode
+    {
+        twoByte address;                        // Subroutine entry point, program start for the root.
+        int     parent;
+        std::uint64_t instructions;             // Executed in this subroutine itself, not in its callees.
+        std::map<twoByte, int> children;        // Callee entry point -> node.
+    };
+
+    static unsigned int getOpCodeClass(twoByte opCode)
+    {
+        // Primary nibble, plus NN for the E and F groups and N for the 8 group. In the 0 group only 00E0 and
+        // 00EE get their own class, every other 0NNN shares class 0.
+        const unsigned int group = opCode >> 12;
+
+        if (group == 0x0)
+            return (opCode == 0x00E0 || opCode == 0x00EE) ? (opCode & 0x00FF) : 0;
+
+        if (group == 0xE || group == 0xF)
+            return (group << 8) | (opCode & 0x00FF);
+
+        if (group == 0x8)
+            return (group << 8) | (opCode & 0x000F);
+
+        return group << 8;
+    }
+
+    int getChild(int node, twoByte address);
+    void mergeCalls(const Profiler& other, int otherNode, int node);
+    void writeFoldedNode(std::ostream& output, int node, const std::string& path) const;
+
+    std::array<std::uint64_t, 16 * 256>                    opCodeClassCounts;
+    std::array<std::uint64_t, Chip8State::c_memorySize>    pcCounts;
+    std::array<std::uint64_t, c_maxTrackedDepth + 1>       depthCounts;    // Instructions executed at each call depth.
+
+    std::uint64_t instructions;
+    std::uint64_t drawCalls;
+    std::uint64_t spriteRows;
+    std::uint64_t delaySpinCycles;
+    byte maxDepth;
+
+    std::vector<CallNode> callNodes;
+    int currentNode;
+
+    int           lastDelayReadPC;              // Address of the last FX07, -1 before the first one.
+    std::uint64_t lastDelayReadInstruction;
+};
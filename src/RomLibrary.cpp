@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "RomLibrary.h"
+
+bool loadRomImage(const std::string& path, RomImage& image, std::string& error)
+{
+    // Open file in binary mode, at the end to get its size
+    std::ifstream inputFileStream(path, std::ios::binary | std::ios::ate);
+
+    if (inputFileStream.fail())
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    const std::streamoff size = inputFileStream.tellg();
+
+    if (size <= 0 || size > static_cast<std::streamoff>(Chip8State::c_maxRomSize))
+    {
+        error = path + " is " + std::to_string(size) + " bytes, games must be 1 to " + std::to_string(Chip8State::c_maxRomSize) + " bytes";
+        return false;
+    }
+
+    image.data.resize(static_cast<std::size_t>(size));
+    inputFileStream.seekg(0);
+
+    if (!inputFileStream.read(reinterpret_cast<char*>(image.data.data()), size))
+    {
+        error = "can't read " + path;
+        return false;
+    }
+
+    image.name = std::filesystem::path(path).filename().string();
+    image.hash = hashRomData(image.data);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::uint64_t hashRomData(const std::vector<byte>& data)
+{
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (const byte value : data)
+    {
+        hash ^= value;
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool RomLibrary::open(const std::string& directory, std::string& error, bool updateIndex)
+{
+    roms.clear();
+    romsByName.clear();
+    romsByHash.clear();
+
+    const std::string indexPath = (std::filesystem::path(directory) / c_indexFileName).string();
+    const std::map<std::string, IndexEntry> index = readIndex(indexPath);
+
+    std::vector<std::filesystem::path> romPaths;
+    std::error_code directoryError;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory, directoryError))
+    {
+        if (entry.is_regular_file() && entry.path().filename() != c_indexFileName)
+            romPaths.push_back(entry.path());
+    }
+
+    if (directoryError)
+    {
+        error = "can't list " + directory + ": " + directoryError.message();
+        return false;
+    }
+
+    std::sort(romPaths.begin(), romPaths.end());
+
+    bool indexChanged = (index.size() != romPaths.size());
+
+    for (const std::filesystem::path& romPath : romPaths)
+    {
+        auto image = std::make_shared<RomImage>();
+
+        // Files that aren't games (too big, empty) are left out of the library.
+        std::string romError;
+
+        if (!loadRomImage(romPath.string(), *image, romError))
+        {
+            indexChanged = true;
+            continue;
+        }
+
+        const auto indexEntry = index.find(image->name);
+
+        if (indexEntry != index.end() && indexEntry->second.hash == image->hash && indexEntry->second.size == image->data.size())
+        {
+            image->quirkProfile = indexEntry->second.quirkProfile;
+        }
+        else
+        {
+            image->quirkProfile = c_defaultQuirkProfile;
+            indexChanged = true;
+        }
+
+        roms.push_back(image);
+        romsByName[image->name] = image;
+        romsByHash.emplace(image->hash, image);
+    }
+
+    if (updateIndex && indexChanged && !writeIndex(indexPath))
+    {
+        error = "can't write " + indexPath;
+        return false;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const RomImage> RomLibrary::findByName(const std::string& name) const
+{
+    const auto it = romsByName.find(name);
+    return (it != romsByName.end()) ? it->second : nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const RomImage> RomLibrary::findByHash(std::uint64_t hash) const
+{
+    const auto it = romsByHash.find(hash);
+    return (it != romsByHash.end()) ? it->second : nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::map<std::string, RomLibrary::IndexEntry> RomLibrary::readIndex(const std::string& indexPath)
+{
+    // One game per line: <hash hex> <size> <quirk profile> <file name>, '#' starts a comment line.
+    std::map<std::string, IndexEntry> index;
+    std::ifstream indexFile(indexPath);
+    std::string line;
+
+    while (std::getline(indexFile, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        IndexEntry entry;
+        std::string name;
+
+        if (fields >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.quirkProfile >> std::ws && std::getline(fields, name))
+            index[name] = entry;
+    }
+
+    return index;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool RomLibrary::writeIndex(const std::string& indexPath) const
+{
+    std::ofstream indexFile(indexPath);
+
+    indexFile << "# CHIP-8 ROM library index: <FNV-1a 64 hash> <size> <quirk profile> <file name>\n";
+
+    for (const auto& image : roms)
+    {
+        indexFile << std::hex << std::uppercase << std::setfill('0') << std::setw(16) << image->hash << std::dec << ' '
+                  << image->data.size() << ' ' << image->quirkProfile << ' ' << image->name << '\n';
+    }
+
+    return indexFile.good();
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Chip8State.h"
+
+// A game image read once and shared read-only by every instance that runs it.
+struct RomImage
+{
+    std::string name;               // File name, without the directory.
+    std::vector<byte> data;
+    std::uint64_t hash = 0;         // FNV-1a 64 of the data, identifies the game whatever its file name.
+    std::string quirkProfile;       // Name of the CHIP-8 variant behaviour the game expects (see Chip8::parseQuirkProfile).
+};
+
+// Reads a whole game file in one call and validates that it fits in the program area.
+bool loadRomImage(const std::string& path, RomImage& image, std::string& error);
+
+std::uint64_t hashRomData(const std::vector<byte>& data);
+
+/////////////////////////////////////////////////////////////////////////////
+
+// In-memory library of the games of a directory, backed by an on-disk index (c_indexFileName in the same
+// directory) that keeps the hash, size and quirk profile of each game. Profiles edited in the index are
+// kept as long as the game content (hash) doesn't change, new or changed games get c_defaultQuirkProfile.
+class RomLibrary
+{
+public:
+    static constexpr const char* c_indexFileName       = "rom_index.txt";
+    static constexpr const char* c_defaultQuirkProfile = "chip8";
+
+    // With updateIndex false the index is only read (front ends looking up the profile of a game).
+    bool open(const std::string& directory, std::string& error, bool updateIndex = true);
+
+    std::shared_ptr<const RomImage> findByName(const std::string& name) const;
+    std::shared_ptr<const RomImage> findByHash(std::uint64_t hash) const;
+
+    const std::vector<std::shared_ptr<const RomImage>>& getRoms() const { return roms; }
+
+private:
+    struct IndexEntry
+    {
+        std::uint64_t hash = 0;
+        std::size_t size   = 0;
+        std::string quirkProfile;
+    };
+
+    static std::map<std::string, IndexEntry> readIndex(const std::string& indexPath);
+    bool writeIndex(const std::string& indexPath) const;
+
+    std::vector<std::shared_ptr<const RomImage>> roms;
+    std::map<std::string, std::shared_ptr<const RomImage>>   romsByName;
+    std::map<std::uint64_t, std::shared_ptr<const RomImage>> romsByHash;
+};
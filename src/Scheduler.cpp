@@ -0,0 +1,117 @@
+#include <thread>
+#include "Scheduler.h"
+
+Scheduler::Scheduler(Mode mode, unsigned int instructionsPerSecond)
+    : mode(mode)
+    , instructionsPerSecond(std::clamp(instructionsPerSecond, c_minInstructionsPerSecond, c_maxInstructionsPerSecond))
+    , executedInstructions(0)
+    , timerTicks(0)
+    , baseInstructions(0)
+    , baseTicks(0)
+    , baseTime(Clock::now())
+    , nextWakeTime(baseTime)
+    , windowStart(baseTime)
+    , windowInstructions(0)
+    , windowLatenessNs(0.0)
+    , windowWakeUps(0)
+    , achievedInstructionsPerSecond(0.0)
+    , pacingErrorNs(0.0)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Scheduler::parseMode(const std::string& name, Mode& mode)
+{
+    if (name == "fixed")
+        mode = Mode::FixedRate;
+    else if (name == "turbo")
+        mode = Mode::Turbo;
+    else if (name == "frame")
+        mode = Mode::FrameLocked;
+    else
+        return false;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Scheduler::setMode(Mode newMode)
+{
+    mode = newMode;
+    resyncClock(Clock::now());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Scheduler::setInstructionsPerSecond(unsigned int newInstructionsPerSecond)
+{
+    // Restart the tick spacing from the last tick with the new rate. The instructions already run towards
+    // the next tick stay counted, as long as they still fit in one tick of the new rate.
+    const std::uint64_t lastTickInstructions = instructionsAtTick(timerTicks);
+
+    instructionsPerSecond = std::clamp(newInstructionsPerSecond, c_minInstructionsPerSecond, c_maxInstructionsPerSecond);
+
+    const std::uint64_t instructionsPerTick = instructionsPerSecond / c_timerFrequency;
+
+    baseTicks        = timerTicks;
+    baseInstructions = std::max(lastTickInstructions, executedInstructions - std::min<std::uint64_t>(executedInstructions, instructionsPerTick - 1));
+
+    resyncClock(Clock::now());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Scheduler::resyncClock(Clock::time_point now)
+{
+    // Move the host time origin so that the emulated clock is exactly at the executed instruction count now.
+    // Only the mapping to host time changes, the tick spacing in emulated instructions stays exact.
+    baseTime     = now - std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds((executedInstructions - baseInstructions) * 1000000000ull / instructionsPerSecond));
+    nextWakeTime = now;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Scheduler::waitForNextSlice()
+{
+    if (mode == Mode::Turbo)
+        return;
+
+    // Frame locked wakes up at the host time of the next emulated timer tick, fixed rate every slice period.
+    if (mode == Mode::FrameLocked)
+        nextWakeTime = timeOfInstructions(instructionsAtTick(timerTicks));
+    else
+        nextWakeTime += std::chrono::microseconds(c_fixedRateSliceUs);
+
+    const Clock::time_point beforeSleep = Clock::now();
+
+    if (nextWakeTime < beforeSleep)
+        nextWakeTime = beforeSleep;
+
+    std::this_thread::sleep_until(nextWakeTime);
+
+    windowLatenessNs += std::chrono::duration<double, std::nano>(Clock::now() - nextWakeTime).count();
+    ++windowWakeUps;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Scheduler::updateStatistics(Clock::time_point now)
+{
+    const std::chrono::duration<double> windowDuration = now - windowStart;
+
+    if (windowDuration < std::chrono::seconds(1))
+        return;
+
+    achievedInstructionsPerSecond.store((executedInstructions - windowInstructions) / windowDuration.count(), std::memory_order_relaxed);
+    pacingErrorNs.store((windowWakeUps > 0) ? windowLatenessNs / windowWakeUps : 0.0, std::memory_order_relaxed);
+
+    windowStart        = now;
+    windowInstructions = executedInstructions;
+    windowLatenessNs   = 0.0;
+    windowWakeUps      = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
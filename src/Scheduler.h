@@ -0,0 +1,175 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Decides how many instructions the core runs and when, from a nanosecond monotonic clock.
+// Whatever the mode, the timers tick every 1/60 s of emulated time: once every
+// instructionsPerSecond / 60 instructions, independently of how fast the host runs them.
+class Scheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Mode
+    {
+        FixedRate,      // Instructions spread evenly over time: every millisecond, runs what the host clock says is due.
+        Turbo,          // Uncapped: runs as many instructions as the host can (fast forward).
+        FrameLocked     // One emulated frame (1/60 s worth of instructions) in a burst at every 60 Hz host frame.
+    };
+
+    static constexpr unsigned int c_timerFrequency            = 60;
+    static constexpr unsigned int c_minInstructionsPerSecond  = 500;
+    static constexpr unsigned int c_maxInstructionsPerSecond  = 20000;
+
+    explicit Scheduler(Mode mode = Mode::FrameLocked, unsigned int instructionsPerSecond = 600);
+
+    static bool parseMode(const std::string& name, Mode& mode);    // "fixed", "turbo" or "frame".
+
+    void setMode(Mode newMode);
+    void setInstructionsPerSecond(unsigned int newInstructionsPerSecond);  // Clamped to [c_minInstructionsPerSecond, c_maxInstructionsPerSecond].
+
+    Mode         getMode() const                  { return mode; }
+    unsigned int getInstructionsPerSecond() const { return instructionsPerSecond; }
+
+    // Runs the instructions due now. runInstructions(count) executes count instructions, timerTick()
+    // is called at every 60 Hz emulated time boundary, after the instructions preceding it.
+    template<typename RunInstructions, typename TimerTick>
+    void runSlice(RunInstructions&& runInstructions, TimerTick&& timerTick);
+
+    // Sleeps until the next slice is due (returns immediately in turbo mode).
+    void waitForNextSlice();
+
+    // Statistics, refreshed about once per second. Safe to read from any thread.
+    double getAchievedInstructionsPerSecond() const { return achievedInstructionsPerSecond.load(std::memory_order_relaxed); }
+    double getPacingErrorNs() const                 { return pacingErrorNs.load(std::memory_order_relaxed); }    // Mean lateness of the wake-ups.
+
+    // Instructions run before the given timer tick at a constant rate, counted from the start. What a
+    // headless replay runs per frame to match a scheduled run.
+    static std::uint64_t getInstructionsBeforeTick(std::uint64_t tick, unsigned int instructionsPerSecond)
+    {
+        return tick * instructionsPerSecond / c_timerFrequency;
+    }
+
+    std::uint64_t getExecutedInstructions() const   { return executedInstructions; }
+    std::uint64_t getTimerTicks() const             { return timerTicks; }
+
+private:
+    static constexpr unsigned int c_fixedRateSliceUs = 1000;    // Wake-up period in fixed rate mode.
+    static constexpr unsigned int c_turboSliceMs     = 8;       // Host time per turbo slice, keeps input and frames flowing.
+    static constexpr unsigned int c_turboChunk       = 1024;    // Instructions run between clock reads in turbo mode.
+    static constexpr unsigned int c_maxFramesBehind  = 5;       // Backlog dropped past this after a stall, instead of running it in a burst.
+
+    void resyncClock(Clock::time_point now);
+
+    std::uint64_t instructionsAtTick(std::uint64_t tick) const
+    {
+        return baseInstructions + getInstructionsBeforeTick(tick - baseTicks, instructionsPerSecond);
+    }
+
+    // Host time at which the emulated clock reaches the given instruction count.
+    Clock::time_point timeOfInstructions(std::uint64_t instructions) const
+    {
+        return baseTime + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds((instructions - baseInstructions) * 1000000000ull / instructionsPerSecond));
+    }
+
+    template<typename RunInstructions, typename TimerTick>
+    void runUntil(std::uint64_t targetInstructions, RunInstructions& runInstructions, TimerTick& timerTick);
+
+    void updateStatistics(Clock::time_point now);
+
+    Mode mode;
+    unsigned int instructionsPerSecond;
+
+    // Emulated time, instructions and ticks counted since the start. The base is where the current rate started.
+    std::uint64_t executedInstructions;
+    std::uint64_t timerTicks;
+    std::uint64_t baseInstructions;
+    std::uint64_t baseTicks;
+    Clock::time_point baseTime;
+
+    Clock::time_point nextWakeTime;
+
+    // Statistics accumulated over the current window.
+    Clock::time_point windowStart;
+    std::uint64_t windowInstructions;
+    double        windowLatenessNs;
+    unsigned int  windowWakeUps;
+
+    std::atomic<double> achievedInstructionsPerSecond;
+    std::atomic<double> pacingErrorNs;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename RunInstructions, typename TimerTick>
+void Scheduler::runSlice(RunInstructions&& runInstructions, TimerTick&& timerTick)
+{
+    const Clock::time_point now = Clock::now();
+
+    switch (mode)
+    {
+        case Mode::FixedRate:
+        case Mode::FrameLocked:
+        {
+            // After a long stall (debugger, window drag) resume from now instead of running the missed frames in a burst.
+            if (now - timeOfInstructions(executedInstructions) > std::chrono::milliseconds(1000 * c_maxFramesBehind / c_timerFrequency))
+                resyncClock(now);
+
+            if (mode == Mode::FrameLocked)
+            {
+                runUntil(instructionsAtTick(timerTicks + 1), runInstructions, timerTick);
+            }
+            else
+            {
+                // Everything due up to now on the emulated clock.
+                const std::uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - baseTime).count();
+                runUntil(baseInstructions + elapsedNs * instructionsPerSecond / 1000000000ull, runInstructions, timerTick);
+            }
+
+            break;
+        }
+
+        case Mode::Turbo:
+        {
+            const Clock::time_point sliceEnd = now + std::chrono::milliseconds(c_turboSliceMs);
+
+            do
+            {
+                runUntil(executedInstructions + c_turboChunk, runInstructions, timerTick);
+            }
+            while (Clock::now() < sliceEnd);
+
+            break;
+        }
+    }
+
+    updateStatistics(Clock::now());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename RunInstructions, typename TimerTick>
+void Scheduler::runUntil(std::uint64_t targetInstructions, RunInstructions& runInstructions, TimerTick& timerTick)
+{
+    // Split the run at the timer boundaries so every tick happens at its exact emulated time.
+    while (executedInstructions < targetInstructions)
+    {
+        const std::uint64_t nextTickInstructions = instructionsAtTick(timerTicks + 1);
+        const std::uint64_t count = std::min(targetInstructions, nextTickInstructions) - executedInstructions;
+
+        if (count > 0)
+        {
+            runInstructions(static_cast<unsigned int>(count));
+            executedInstructions += count;
+        }
+
+        if (executedInstructions == nextTickInstructions)
+        {
+            ++timerTicks;
+            timerTick();
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#include "SdlBackend.h"
+
+SdlBackend::SdlBackend()
+    : window(nullptr)
+    , renderer(nullptr)
+    , sdlTexture(nullptr)
+    , initializedSubsystems(0)
+    , pixels(Chip8State::c_displaySize, 0)
+    , audioDeviceId(0)
+    , keyMask(0)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool SdlBackend::initialize(const VideoOptions& options, std::string& error)
+{
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0)
+    {
+        error = SDL_GetError();
+        return false;
+    }
+
+    initializedSubsystems |= SDL_INIT_VIDEO | SDL_INIT_EVENTS;
+
+    window = SDL_CreateWindow(options.title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, options.windowWidth, options.windowHeight, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+
+    if (window != nullptr)
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+
+    if (renderer != nullptr)
+        sdlTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB332, SDL_TEXTUREACCESS_STREAMING, Chip8State::c_displayWidth, Chip8State::c_displayHeight);
+
+    if (sdlTexture == nullptr)
+    {
+        error = SDL_GetError();
+        uninitialize();
+        return false;
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    SDL_RenderPresent(renderer);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SdlBackend::initializeSound(ToneGenerator& toneGenerator)
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+        return;
+
+    initializedSubsystems |= SDL_INIT_AUDIO;
+
+    // Small callback buffers keep the latency low, the tone is generated on demand instead of queued.
+    SDL_AudioSpec desiredSpec = {};
+    desiredSpec.freq     = c_audioFrequency;
+    desiredSpec.format   = AUDIO_S16SYS;
+    desiredSpec.channels = 1;
+    desiredSpec.samples  = c_audioSamples;
+    desiredSpec.callback = &SdlBackend::audioCallback;
+    desiredSpec.userdata = &toneGenerator;
+
+    SDL_AudioSpec obtainedSpec = {};
+    audioDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &obtainedSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+
+    if (audioDeviceId == 0)
+        return;
+
+    toneGenerator.setSampleRate(obtainedSpec.freq);
+    SDL_PauseAudioDevice(audioDeviceId, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SdlBackend::audioCallback(void* userData, Uint8* stream, int length)
+{
+    static_cast<ToneGenerator*>(userData)->generate(reinterpret_cast<Sint16*>(stream), length / sizeof(Sint16));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SdlBackend::renderDisplay(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows)
+{
+    // Nothing changed on screen: no upload and no present.
+    if (dirtyRows == 0 || sdlTexture == nullptr)
+        return;
+
+    constexpr Uint32 width  = Chip8State::c_displayWidth;
+    constexpr Uint32 height = Chip8State::c_displayHeight;
+
+    // Upload each run of consecutive dirty rows as one locked sub-rect of the texture.
+    Uint32 row = 0;
+
+    while (row < height)
+    {
+        if ((dirtyRows & (1u << row)) == 0)
+        {
+            ++row;
+            continue;
+        }
+
+        Uint32 endRow = row + 1;
+
+        while (endRow < height && (dirtyRows & (1u << endRow)) != 0)
+            ++endRow;
+
+        for (Uint32 y = row; y < endRow; ++y)
+        {
+            for (Uint32 x = 0; x < width; ++x)
+                pixels[y * width + x] = ((rows[y] >> (width - 1 - x)) & 1) ? 0xFF : 0x00;
+        }
+
+        const SDL_Rect dirtyRect = { 0, static_cast<int>(row), static_cast<int>(width), static_cast<int>(endRow - row) };
+
+        void* texturePixels = nullptr;
+        int   texturePitch  = 0;
+
+        if (SDL_LockTexture(sdlTexture, &dirtyRect, &texturePixels, &texturePitch) == 0)
+        {
+            for (Uint32 y = row; y < endRow; ++y)
+                SDL_memcpy(static_cast<Uint8*>(texturePixels) + (y - row) * texturePitch, &pixels[y * width], width * sizeof(Uint8));
+
+            SDL_UnlockTexture(sdlTexture);
+        }
+
+        row = endRow;
+    }
+
+    SDL_RenderCopy(renderer, sdlTexture, nullptr, nullptr);
+    SDL_RenderPresent(renderer);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SdlBackend::handleInputEvents(bool& quit)
+{
+    SDL_Event sdlEvent;
+
+    while (SDL_PollEvent(&sdlEvent))
+    {
+        const Uint8* currentKeyStates = SDL_GetKeyboardState(nullptr);
+
+        if (currentKeyStates[SDL_SCANCODE_ESCAPE] || sdlEvent.type == SDL_QUIT)
+        {
+            quit = true;
+            return;
+        }
+
+        // Keypad layout mapped to the left side of the keyboard, key k goes to bit k.
+        static constexpr SDL_Scancode keyScancodes[Chip8State::c_numKeys] =
+        {
+            SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4,
+            SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_R,
+            SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_F,
+            SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V,
+        };
+
+        twoByte updatedKeyMask = 0;
+
+        for (unsigned int key = 0; key < Chip8State::c_numKeys; ++key)
+        {
+            if (currentKeyStates[keyScancodes[key]])
+                updatedKeyMask |= static_cast<twoByte>(1u << key);
+        }
+
+        keyMask = updatedKeyMask;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SdlBackend::setWindowTitle(const std::string& title)
+{
+    if (window != nullptr)
+        SDL_SetWindowTitle(window, title.c_str());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SdlBackend::uninitialize()
+{
+    if (audioDeviceId != 0)
+        SDL_CloseAudioDevice(audioDeviceId);
+
+    if (sdlTexture != nullptr)
+        SDL_DestroyTexture(sdlTexture);
+
+    if (renderer != nullptr)
+        SDL_DestroyRenderer(renderer);
+
+    if (window != nullptr)
+        SDL_DestroyWindow(window);
+
+    audioDeviceId = 0;
+    sdlTexture    = nullptr;
+    renderer      = nullptr;
+    window        = nullptr;
+
+    // SDL counts subsystem references, the last backend to quit one shuts it down.
+    if (initializedSubsystems != 0)
+        SDL_QuitSubSystem(initializedSubsystems);
+
+    initializedSubsystems = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
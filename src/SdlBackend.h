@@ -0,0 +1,45 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include "MediaBackend.h"
+#include "ToneGenerator.h"
+
+// Window, audio device and keyboard through SDL. Only the subsystems in use are started: video and
+// events by initialize(), audio by initializeSound(). Several instances can coexist.
+class SdlBackend : public MediaBackend
+{
+public:
+    SdlBackend();
+    ~SdlBackend() override { uninitialize(); }
+
+    SdlBackend(const SdlBackend&)            = delete;
+    SdlBackend& operator=(const SdlBackend&) = delete;
+
+    bool initialize(const VideoOptions& options, std::string& error) override;
+    void initializeSound(ToneGenerator& toneGenerator) override;
+    void uninitialize() override;
+
+    void renderDisplay(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows) override;
+
+    void handleInputEvents(bool& quit) override;
+    twoByte getKeyMask() const override { return keyMask; }
+    void setWindowTitle(const std::string& title) override;
+
+private:
+    SDL_Window* window;
+    SDL_Renderer* renderer;
+    SDL_Texture* sdlTexture;
+
+    Uint32 initializedSubsystems;     // SDL_INIT_* flags to quit in uninitialize().
+
+    std::vector<Uint8> pixels;        // One RGB332 byte per pixel, the layout of the texture.
+
+    static constexpr int    c_audioFrequency = 48000;
+    static constexpr Uint16 c_audioSamples   = 256;      // Samples per callback: about 5 ms of output latency.
+
+    static void audioCallback(void* userData, Uint8* stream, int length);
+
+    SDL_AudioDeviceID audioDeviceId;
+
+    twoByte keyMask;
+};
@@ -0,0 +1,176 @@
+#include <cstdint>
+#include "SharedMemory.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if !defined(_WIN32)
+    // POSIX names are a single component starting with a slash.
+    std::string getPosixName(const std::string& name)
+    {
+        return (!name.empty() && name[0] == '/') ? name : "/" + name;
+    }
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool SharedMemory::create(const std::string& name, std::size_t newSize, std::string& error)
+{
+    close();
+
+#if defined(_WIN32)
+    const std::uint64_t size64 = newSize;
+    mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), name.c_str());
+
+    if (mappingHandle == nullptr)
+    {
+        error = "cannot create shared memory " + name;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, newSize);
+
+    if (view == nullptr)
+    {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+        error = "cannot map shared memory " + name;
+        return false;
+    }
+#else
+    const std::string posixName = getPosixName(name);
+    const int descriptor = shm_open(posixName.c_str(), O_CREAT | O_RDWR, 0644);
+
+    if (descriptor < 0)
+    {
+        error = "cannot create shared memory " + posixName;
+        return false;
+    }
+
+    void* view = MAP_FAILED;
+
+    if (ftruncate(descriptor, static_cast<off_t>(newSize)) == 0)
+        view = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+
+    ::close(descriptor);
+
+    if (view == MAP_FAILED)
+    {
+        shm_unlink(posixName.c_str());
+        error = "cannot map shared memory " + posixName;
+        return false;
+    }
+
+    mappingName = posixName;
+#endif
+
+    data  = view;
+    size  = newSize;
+    owner = true;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool SharedMemory::open(const std::string& name, std::string& error)
+{
+    close();
+
+#if defined(_WIN32)
+    mappingHandle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+
+    if (mappingHandle == nullptr)
+    {
+        error = "cannot open shared memory " + name;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION information;
+
+    if (view == nullptr || VirtualQuery(view, &information, sizeof(information)) == 0)
+    {
+        if (view != nullptr)
+            UnmapViewOfFile(view);
+
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+        error = "cannot map shared memory " + name;
+        return false;
+    }
+
+    const std::size_t mappedSize = information.RegionSize;
+#else
+    const std::string posixName = getPosixName(name);
+    const int descriptor = shm_open(posixName.c_str(), O_RDWR, 0);
+
+    if (descriptor < 0)
+    {
+        error = "cannot open shared memory " + posixName;
+        return false;
+    }
+
+    struct stat status;
+    void* view = MAP_FAILED;
+    std::size_t mappedSize = 0;
+
+    if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+    {
+        mappedSize = static_cast<std::size_t>(status.st_size);
+        view = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    }
+
+    ::close(descriptor);
+
+    if (view == MAP_FAILED)
+    {
+        error = "cannot map shared memory " + posixName;
+        return false;
+    }
+#endif
+
+    data  = view;
+    size  = mappedSize;
+    owner = false;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SharedMemory::close()
+{
+    if (data == nullptr)
+        return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(data, size);
+
+    if (owner)
+        shm_unlink(mappingName.c_str());
+
+    mappingName.clear();
+#endif
+
+    data  = nullptr;
+    size  = 0;
+    owner = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Named memory mapping shared with other processes: "/<name>" with shm_open on POSIX, a named file mapping
+// on Windows. Data handed over this way is read in place by the other side, nothing goes through a pipe.
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory() { close(); }
+
+    SharedMemory(const SharedMemory&)            = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    // Creates the mapping with size bytes (or resizes an existing one), its name goes away at close().
+    bool create(const std::string& name, std::size_t size, std::string& error);
+
+    // Maps the whole of a mapping another process created.
+    bool open(const std::string& name, std::string& error);
+
+    // Processes that already mapped it keep their mapping.
+    void close();
+
+    bool isOpen() const         { return data != nullptr; }
+    void* getData() const       { return data; }
+    std::size_t getSize() const { return size; }
+
+private:
+    void*       data  = nullptr;
+    std::size_t size  = 0;
+    bool        owner = false;      // Created here, the name is removed on close.
+
+#if defined(_WIN32)
+    void* mappingHandle = nullptr;
+#else
+    std::string mappingName;
+#endif
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "Chip8State.h"
+
+// Fixed capacity ring of the last N machine snapshots, for instant rewind.
+// All the storage is allocated up front: pushing a snapshot is a single Chip8State copy.
+class SnapshotRing
+{
+public:
+    // A capacity of 0 is clamped to 1, the ring always holds at least the latest snapshot.
+    explicit SnapshotRing(std::size_t capacity) : snapshots(std::max<std::size_t>(capacity, 1)), head(0), count(0) {}
+
+    // Slot that will hold the next snapshot, fill it with Chip8::saveState and then call commit().
+    Chip8State& next() { return snapshots[head]; }
+
+    void commit()
+    {
+        head  = (head + 1) % snapshots.size();
+        count = (count < snapshots.size()) ? count + 1 : count;
+    }
+
+    // Snapshot taken stepsBack commits ago (0 is the most recent one), nullptr when it's no longer in the ring.
+    const Chip8State* get(std::size_t stepsBack = 0) const
+    {
+        if (stepsBack >= count)
+            return nullptr;
+
+        return &snapshots[(head + snapshots.size() - 1 - stepsBack) % snapshots.size()];
+    }
+
+    // Drops the newest stepsBack snapshots and returns the one that becomes the most recent.
+    const Chip8State* rewind(std::size_t stepsBack = 1)
+    {
+        if (stepsBack >= count)
+            return nullptr;
+
+        head   = (head + snapshots.size() - stepsBack) % snapshots.size();
+        count -= stepsBack;
+
+        return get();
+    }
+
+    void clear()                     { head = 0; count = 0; }
+    std::size_t size() const         { return count; }
+    std::size_t getCapacity() const  { return snapshots.size(); }
+
+private:
+    std::vector<Chip8State> snapshots;
+    std::size_t head;       // Slot of the next snapshot.
+    std::size_t count;      // Number of valid snapshots.
+};
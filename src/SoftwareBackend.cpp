@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "SoftwareBackend.h"
+
+#if !defined(CHIP8_SOFTWARE_SCALAR) && defined(__AVX2__)
+#define SOFTWARE_AVX2
+#define SOFTWARE_SSE2
+#include <immintrin.h>
+#elif !defined(CHIP8_SOFTWARE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SOFTWARE_SSE2
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(SoftwareBackend::SharedFrameHeader) <= SoftwareBackend::c_sharedHeaderSize, "The shared frame header outgrew its space");
+
+SoftwareBackend::SoftwareBackend()
+    : scale(1)
+    , width(0)
+    , height(0)
+    , pitch(0)
+    , decay(0)
+    , fading(false)
+    , intensities()
+    , palette()
+    , pixels(nullptr)
+    , header(nullptr)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareBackend::initialize(const VideoOptions& options, std::string& error)
+{
+    if (options.scale == 0 || options.scale > c_maxScale)
+    {
+        error = "scale out of range";
+        return false;
+    }
+
+    if (options.phosphor >= 100)
+    {
+        error = "phosphor decay out of range";
+        return false;
+    }
+
+    scale  = options.scale;
+    width  = Chip8State::c_displayWidth * scale;
+    height = Chip8State::c_displayHeight * scale;
+    pitch  = (width + 7) & ~7u;             // Rows start on 32 byte boundaries.
+    decay  = options.phosphor * 256 / 100;
+    fading = false;
+
+    intensities.fill(0);
+
+    // Brightness b blends the off and on colors channel by channel.
+    for (unsigned int brightness = 0; brightness < 256; ++brightness)
+    {
+        std::uint32_t color = 0;
+
+        for (unsigned int shift = 0; shift < 32; shift += 8)
+        {
+            const unsigned int off = (c_offColor >> shift) & 0xFF;
+            const unsigned int on  = (c_onColor >> shift) & 0xFF;
+
+            color |= ((off * (255 - brightness) + on * brightness + 127) / 255) << shift;
+        }
+
+        palette[brightness] = color;
+    }
+
+    const std::size_t pixelCount = static_cast<std::size_t>(pitch) * height;
+
+    if (options.sharedMemoryName.empty())
+    {
+        privatePixels.assign(pixelCount, c_offColor);
+        pixels = privatePixels.data();
+        return true;
+    }
+
+    if (!sharedMemory.create(options.sharedMemoryName, c_sharedHeaderSize + pixelCount * sizeof(std::uint32_t), error))
+        return false;
+
+    header = new (sharedMemory.getData()) SharedFrameHeader();
+
+    pixels = reinterpret_cast<std::uint32_t*>(reinterpret_cast<byte*>(header) + c_sharedHeaderSize);
+    std::fill(pixels, pixels + pixelCount, c_offColor);
+
+    header->magic      = c_sharedMagic;
+    header->version    = c_sharedVersion;
+    header->headerSize = static_cast<std::uint16_t>(c_sharedHeaderSize);
+    header->width      = width;
+    header->height     = height;
+    header->pitch      = pitch * sizeof(std::uint32_t);
+    header->frameCount = 0;
+    header->sequence.store(0, std::memory_order_release);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SoftwareBackend::uninitialize()
+{
+    // Viewers that already mapped the frames keep their mapping, the name goes away with the emulator.
+    sharedMemory.close();
+    header = nullptr;
+
+    privatePixels.clear();
+    privatePixels.shrink_to_fit();
+    pixels = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SoftwareBackend::renderDisplay(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows)
+{
+    if (pixels == nullptr)
+        return;
+
+    const std::uint32_t changedRows = updateIntensities(rows, dirtyRows);
+
+    if (changedRows == 0)
+        return;
+
+    // Odd sequence while the pixels are inconsistent.
+    std::uint32_t sequence = 0;
+
+    if (header != nullptr)
+    {
+        sequence = header->sequence.load(std::memory_order_relaxed);
+        header->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    for (unsigned int y = 0; y < Chip8State::c_displayHeight; ++y)
+    {
+        if ((changedRows & (1u << y)) != 0)
+            scaleRow(y);
+    }
+
+    if (header != nullptr)
+    {
+        ++header->frameCount;
+        header->sequence.store(sequence + 2, std::memory_order_release);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::uint32_t SoftwareBackend::updateIntensities(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows)
+{
+    // Without decay a pixel is either off or lit, only the dirty rows change.
+    if (decay == 0)
+        dirtyRows &= ~0u >> (32 - Chip8State::c_displayHeight);
+    else
+        dirtyRows = ~0u >> (32 - Chip8State::c_displayHeight);
+
+    std::uint32_t changedRows = 0;
+    bool partiallyLit = false;
+
+    for (unsigned int y = 0; y < Chip8State::c_displayHeight; ++y)
+    {
+        if ((dirtyRows & (1u << y)) == 0)
+            continue;
+
+        const std::uint64_t row = rows[y];
+        byte* rowIntensities = &intensities[y * Chip8State::c_displayWidth];
+
+#if defined(SOFTWARE_SSE2)
+        // 16 pixels at a time: each byte of the row broadcast over 8 lanes, tested against its bit.
+        // Lit pixels go to 255, the others keep decay / 256 of their brightness.
+        const __m128i bitMask = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+        const __m128i factor  = _mm_set1_epi16(static_cast<short>(decay));
+        const __m128i zero    = _mm_setzero_si128();
+        const __m128i full    = _mm_set1_epi8(-1);
+
+        int unchanged = 0xFFFF;
+        int levels    = 0xFFFF;     // Lanes fully off or fully lit.
+
+        for (unsigned int x = 0; x < Chip8State::c_displayWidth; x += 16)
+        {
+            const std::uint64_t left  = (row >> (56 - x)) & 0xFF;
+            const std::uint64_t right = (row >> (48 - x)) & 0xFF;
+
+            const __m128i bits = _mm_set_epi64x(static_cast<long long>(right * 0x0101010101010101ull), static_cast<long long>(left * 0x0101010101010101ull));
+            const __m128i lit  = _mm_cmpeq_epi8(_mm_and_si128(bits, bitMask), bitMask);
+
+            const __m128i old = _mm_load_si128(reinterpret_cast<const __m128i*>(rowIntensities + x));
+            __m128i updated = lit;
+
+            if (decay != 0)
+            {
+                const __m128i low  = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), factor), 8);
+                const __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), factor), 8);
+
+                updated = _mm_max_epu8(lit, _mm_packus_epi16(low, high));
+                levels &= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(updated, zero), _mm_cmpeq_epi8(updated, full)));
+            }
+
+            unchanged &= _mm_movemask_epi8(_mm_cmpeq_epi8(updated, old));
+            _mm_store_si128(reinterpret_cast<__m128i*>(rowIntensities + x), updated);
+        }
+
+        if (unchanged != 0xFFFF)
+            changedRows |= 1u << y;
+
+        partiallyLit |= (levels != 0xFFFF);
+#else
+        bool changed = false;
+
+        for (unsigned int x = 0; x < Chip8State::c_displayWidth; ++x)
+        {
+            const byte old = rowIntensities[x];
+            byte updated = ((row >> (Chip8State::c_displayWidth - 1 - x)) & 1) ? 0xFF : static_cast<byte>(old * decay >> 8);
+
+            changed      |= (updated != old);
+            partiallyLit |= (updated != 0 && updated != 0xFF);
+            rowIntensities[x] = updated;
+        }
+
+        if (changed)
+            changedRows |= 1u << y;
+#endif
+    }
+
+    fading = partiallyLit;
+
+    return changedRows;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void SoftwareBackend::scaleRow(unsigned int y)
+{
+    const byte* rowIntensities = &intensities[y * Chip8State::c_displayWidth];
+
+    alignas(16) std::uint32_t colors[Chip8State::c_displayWidth];
+
+    for (unsigned int x = 0; x < Chip8State::c_displayWidth; ++x)
+        colors[x] = palette[rowIntensities[x]];
+
+    std::uint32_t* output = pixels + static_cast<std::size_t>(y) * scale * pitch;
+
+    // Horizontal replication into the first output row of the pixel row.
+    if (scale == 1)
+    {
+        std::memcpy(output, colors, sizeof(colors));
+    }
+#if defined(SOFTWARE_SSE2)
+    else if (scale == 2)
+    {
+        for (unsigned int x = 0; x < Chip8State::c_displayWidth; x += 4)
+        {
+            const __m128i source = _mm_load_si128(reinterpret_cast<const __m128i*>(colors + x));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * x),     _mm_unpacklo_epi32(source, source));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * x + 4), _mm_unpackhi_epi32(source, source));
+        }
+    }
+    else if (scale >= 4)
+    {
+        // Whole vectors of one color, the last one overlapping the previous so it ends at the pixel's edge.
+        for (unsigned int x = 0; x < Chip8State::c_displayWidth; ++x)
+        {
+            std::uint32_t* target = output + x * scale;
+
+#if defined(SOFTWARE_AVX2)
+            if (scale >= 8)
+            {
+                const __m256i color = _mm256_set1_epi32(static_cast<int>(colors[x]));
+
+                for (unsigned int i = 0; i + 8 <= scale; i += 8)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), color);
+
+                if (scale % 8 != 0)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + scale - 8), color);
+
+                continue;
+            }
+#endif
+            const __m128i color = _mm_set1_epi32(static_cast<int>(colors[x]));
+
+            for (unsigned int i = 0; i + 4 <= scale; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), color);
+
+            if (scale % 4 != 0)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + scale - 4), color);
+        }
+    }
+#endif
+    else
+    {
+        for (unsigned int x = 0; x < Chip8State::c_displayWidth; ++x)
+            std::fill_n(output + x * scale, scale, colors[x]);
+    }
+
+    // Vertical replication: the other output rows are copies of the first.
+    for (unsigned int copy = 1; copy < scale; ++copy)
+        std::memcpy(output + copy * pitch, output, width * sizeof(std::uint32_t));
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "MediaBackend.h"
+#include "SharedMemory.h"
+
+// Upscales the display on the CPU into a 32-bit ARGB8888 buffer (scale x scale output pixels per CHIP-8
+// pixel), with no window, sound or input. Without phosphor decay only the dirty rows are redrawn.
+// With it, pixels that go dark fade out over the following frames, which hides the flicker of games
+// that erase and redraw their sprites with XOR.
+//
+// Given a shared memory name, the buffer lives in a named mapping ("/<name>" with shm_open on POSIX, a
+// named file mapping on Windows) that an external viewer can open read-only: a SharedFrameHeader then
+// the rows of pixels.
+class SoftwareBackend : public MediaBackend
+{
+public:
+    static constexpr std::uint32_t c_sharedMagic   = 0x42463843;   // "C8FB" in the file.
+    static constexpr std::uint16_t c_sharedVersion = 1;
+    static constexpr unsigned int  c_maxScale      = 64;
+
+    // At the start of the shared memory. sequence is odd while a frame is being written: a reader copies
+    // the pixels between two reads of an equal, even sequence (a seqlock).
+    struct SharedFrameHeader
+    {
+        std::uint32_t              magic;
+        std::uint16_t              version;
+        std::uint16_t              headerSize;      // Offset of the first pixel row.
+        std::uint32_t              width;
+        std::uint32_t              height;
+        std::uint32_t              pitch;           // Bytes from one row to the next.
+        std::atomic<std::uint32_t> sequence;
+        std::uint64_t              frameCount;      // Frames rendered so far.
+    };
+
+    static constexpr std::size_t c_sharedHeaderSize = 64;
+
+    SoftwareBackend();
+    ~SoftwareBackend() override { uninitialize(); }
+
+    SoftwareBackend(const SoftwareBackend&)            = delete;
+    SoftwareBackend& operator=(const SoftwareBackend&) = delete;
+
+    bool initialize(const VideoOptions& options, std::string& error) override;
+    void initializeSound(ToneGenerator&) override {}
+    void uninitialize() override;
+
+    void renderDisplay(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows) override;
+    bool isAnimating() const override { return fading; }
+
+    void handleInputEvents(bool&) override {}
+    twoByte getKeyMask() const override { return 0; }
+    void setWindowTitle(const std::string&) override {}
+
+    // The output, for use in process. Pitch in pixels.
+    const std::uint32_t* getPixels() const  { return pixels; }
+    unsigned int getWidth() const           { return width; }
+    unsigned int getHeight() const          { return height; }
+    unsigned int getPitch() const           { return pitch; }
+
+private:
+    static constexpr std::uint32_t c_offColor = 0xFF000000;
+    static constexpr std::uint32_t c_onColor  = 0xFFFFFFFF;
+
+    using Intensities = std::array<byte, Chip8State::c_displaySize>;
+
+    std::uint32_t updateIntensities(const Chip8State::DisplayRows& rows, std::uint32_t dirtyRows);     // Returns the rows whose intensities changed.
+    void scaleRow(unsigned int y);
+
+    unsigned int scale;
+    unsigned int width;
+    unsigned int height;
+    unsigned int pitch;
+    unsigned int decay;         // Brightness kept per frame in 1/256 units, 0 without phosphor decay.
+    bool fading;                // Some pixel is partially lit.
+
+    alignas(32) Intensities intensities;                    // Brightness of each CHIP-8 pixel, 0 off to 255 lit.
+    std::array<std::uint32_t, 256> palette;                 // ARGB color of each brightness.
+
+    std::uint32_t* pixels;
+    std::vector<std::uint32_t> privatePixels;               // The buffer when it isn't shared.
+
+    SharedMemory sharedMemory;
+    SharedFrameHeader* header;  // Start of the shared memory, nullptr when not shared.
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free single producer / single consumer queue.
+// Elements are written and read in place in preallocated slots: the producer fills getWriteSlot() and
+// calls push(), the consumer reads getReadSlot() and calls pop(). Neither side ever waits, a full queue
+// (or an empty one) just returns no slot.
+template<typename T>
+class SpscQueue
+{
+public:
+    // capacity must be a power of two.
+    explicit SpscQueue(std::size_t capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+    // Producer side: slot for the next element, nullptr while the queue is full.
+    T* getWriteSlot()
+    {
+        const std::size_t position = tail.load(std::memory_order_relaxed);
+
+        if (position - head.load(std::memory_order_acquire) == slots.size())
+            return nullptr;
+
+        return &slots[position & mask];
+    }
+
+    void push() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer side: oldest element, nullptr while the queue is empty.
+    const T* getReadSlot()
+    {
+        const std::size_t position = head.load(std::memory_order_relaxed);
+
+        if (position == tail.load(std::memory_order_acquire))
+            return nullptr;
+
+        return &slots[position & mask];
+    }
+
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    std::size_t getCapacity() const { return slots.size(); }
+
+private:
+    std::vector<T> slots;
+    const std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> head;      // Next element to read, written by the consumer.
+    alignas(64) std::atomic<std::size_t> tail;      // Next slot to write, written by the producer.
+};
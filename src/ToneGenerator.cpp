@@ -0,0 +1,103 @@
+#include <cmath>
+#include "ToneGenerator.h"
+
+ToneGenerator::ToneGenerator(unsigned int sampleRate)
+    : active(false)
+    , usePattern(false)
+    , patternHigh(0)
+    , patternLow(0)
+    , patternPitch(static_cast<byte>(c_defaultPitch))
+    , sampleRate(0)
+    , phase(0.0)
+    , gain(0.0f)
+    , gainStep(0.0f)
+{
+    setSampleRate(sampleRate);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ToneGenerator::setPattern(const std::array<byte, Chip8State::c_audioPatternSize>& pattern, byte pitch)
+{
+    std::uint64_t high = 0;
+    std::uint64_t low  = 0;
+
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        high = (high << 8) | pattern[i];
+        low  = (low  << 8) | pattern[i + 8];
+    }
+
+    // The halves may be picked up one buffer apart, which isn't audible.
+    patternHigh.store(high, std::memory_order_relaxed);
+    patternLow.store(low, std::memory_order_relaxed);
+    patternPitch.store(pitch, std::memory_order_relaxed);
+    usePattern.store(true, std::memory_order_relaxed);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ToneGenerator::setSampleRate(unsigned int newSampleRate)
+{
+    sampleRate = (newSampleRate > 0) ? newSampleRate : 48000;
+
+    // Full ramp in 2 ms.
+    gainStep = 1.0f / (sampleRate * 0.002f);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ToneGenerator::generate(std::int16_t* samples, unsigned int count)
+{
+    const bool isActive   = active.load(std::memory_order_relaxed);
+    const bool hasPattern = usePattern.load(std::memory_order_relaxed);
+
+    if (!isActive && gain <= 0.0f)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+            samples[i] = 0;
+
+        phase = 0.0;
+        return;
+    }
+
+    const std::uint64_t bitsHigh = patternHigh.load(std::memory_order_relaxed);
+    const std::uint64_t bitsLow  = patternLow.load(std::memory_order_relaxed);
+
+    // XO-CHIP plays the pattern at 4000 * 2^((pitch - 64) / 48) bits per second, the square wave has two halves per period.
+    const double bitsPerSecond = 4000.0 * std::pow(2.0, (static_cast<int>(patternPitch.load(std::memory_order_relaxed)) - 64) / 48.0);
+    const double phaseStep     = hasPattern ? bitsPerSecond / sampleRate : static_cast<double>(c_squareFrequency) / sampleRate;
+    const double phaseWrap     = hasPattern ? 128.0 : 1.0;
+
+    // Pattern mode leaves the phase anywhere below 128, bring it back into the period of the mode now playing.
+    if (phase >= phaseWrap)
+        phase = std::fmod(phase, phaseWrap);
+
+    const float targetGain = isActive ? 1.0f : 0.0f;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        bool isHigh;
+
+        if (hasPattern)
+        {
+            const unsigned int bit = static_cast<unsigned int>(phase);
+            isHigh = (((bit < 64) ? (bitsHigh >> (63 - bit)) : (bitsLow >> (127 - bit))) & 1) != 0;
+        }
+        else
+        {
+            isHigh = phase < 0.5;
+        }
+
+        gain = (gain < targetGain) ? std::fmin(gain + gainStep, targetGain) : std::fmax(gain - gainStep, targetGain);
+
+        samples[i] = static_cast<std::int16_t>((isHigh ? c_amplitude : -c_amplitude) * gain);
+
+        phase += phaseStep;
+
+        if (phase >= phaseWrap)
+            phase -= phaseWrap;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
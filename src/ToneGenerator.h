@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "Chip8State.h"
+
+// Synthesises the buzzer in the audio callback, from state the emulation thread publishes with atomics.
+// Plays a square wave while the sound is active, or the XO-CHIP 1-bit pattern when one is set. The gain
+// ramps over a couple of milliseconds at start and stop so the tone doesn't click.
+class ToneGenerator
+{
+public:
+    static constexpr unsigned int c_squareFrequency   = 440;
+    static constexpr unsigned int c_defaultPitch      = 64;       // XO-CHIP pitch of a 4000 Hz pattern playback rate.
+    static constexpr std::int16_t c_amplitude         = 6000;
+
+    explicit ToneGenerator(unsigned int sampleRate = 48000);
+
+    // Emulation side, any thread.
+    void setActive(bool isActive) { active.store(isActive, std::memory_order_relaxed); }
+    void setPattern(const std::array<byte, Chip8State::c_audioPatternSize>& pattern, byte pitch);
+    void clearPattern()           { usePattern.store(false, std::memory_order_relaxed); }
+
+    // Audio side: sample rate of the opened device, then fills blocks of mono signed 16 bit samples.
+    void setSampleRate(unsigned int newSampleRate);
+    void generate(std::int16_t* samples, unsigned int count);
+
+private:
+    std::atomic<bool>          active;
+    std::atomic<bool>          usePattern;
+    std::atomic<std::uint64_t> patternHigh;     // Bits 0-63 of the pattern, the first bit played is the MSB.
+    std::atomic<std::uint64_t> patternLow;      // Bits 64-127.
+    std::atomic<byte>          patternPitch;
+
+    // Only touched by the audio thread.
+    unsigned int sampleRate;
+    double phase;           // Square wave: fraction of the period. Pattern: bit position in [0, 128).
+    float  gain;            // Current gain in [0, 1], ramps towards 1 when active and 0 when not.
+    float  gainStep;
+};
@@ -0,0 +1,642 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "ByteOrder.h"
+#include "Tracer.h"
+
+namespace
+{
+    std::uint32_t read32(const byte* input)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, input, sizeof(value));
+        return value;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // LZ sequence lengths: 4 bits in the token, then 255 valued bytes and a final byte below 255 when they don't fit.
+    void writeLength(byte*& output, std::size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            *output++ = 255;
+
+        *output++ = static_cast<byte>(length);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool readLength(const byte*& input, const byte* end, std::size_t& length)
+    {
+        byte value = 255;
+
+        while (value == 255)
+        {
+            if (input == end)
+                return false;
+
+            value   = *input++;
+            length += value;
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void writeSequence(byte*& output, const byte* literals, std::size_t literalLength, std::size_t offset, std::size_t matchLength)
+    {
+        byte* const token = output++;
+        *token = static_cast<byte>(std::min<std::size_t>(literalLength, 15) << 4);
+
+        if (literalLength >= 15)
+            writeLength(output, literalLength - 15);
+
+        std::memcpy(output, literals, literalLength);
+        output += literalLength;
+
+        // The last sequence is only literals.
+        if (matchLength == 0)
+            return;
+
+        *output++ = static_cast<byte>(offset);
+        *output++ = static_cast<byte>(offset >> 8);
+
+        *token |= static_cast<byte>(std::min<std::size_t>(matchLength - 4, 15));
+
+        if (matchLength - 4 >= 15)
+            writeLength(output, matchLength - 4 - 15);
+    }
+
+    constexpr std::size_t c_headerSize      = 4 + 2 + 2 + 4 + 4 + 8 + 1 + 1 + 2;
+    constexpr std::size_t c_chunkHeaderSize = 4 + 4;
+
+    constexpr unsigned int  c_hashBits    = 12;
+    constexpr std::size_t   c_maxDistance = 65535;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Trace::Registers::operator==(const Registers& other) const
+{
+    return V == other.V && I == other.I && SP == other.SP && delayTimer == other.delayTimer && soundTimer == other.soundTimer && keys == other.keys;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Trace::Registers Trace::getRegisters(const Chip8State& state)
+{
+    Registers registers;
+    registers.V          = state.V;
+    registers.I          = state.I;
+    registers.SP         = state.SP;
+    registers.delayTimer = state.delayTimer;
+    registers.soundTimer = state.soundTimer;
+    registers.keys       = state.keys;
+
+    return registers;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::uint64_t Trace::hashState(const Chip8State& state)
+{
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+
+    const auto add = [&hash](std::uint64_t value, unsigned int size)
+    {
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 0x100000001B3ull;
+        }
+    };
+
+    for (const byte value : state.memory)
+        add(value, 1);
+
+    for (const std::uint64_t row : state.display)
+        add(row, 8);
+
+    for (const twoByte address : state.stack)
+        add(address, 2);
+
+    for (const byte value : state.V)
+        add(value, 1);
+
+    for (const byte value : state.audioPattern)
+        add(value, 1);
+
+    add(state.keys, 2);
+    add(state.PC, 2);
+    add(state.I, 2);
+    add(state.SP, 1);
+    add(state.delayTimer, 1);
+    add(state.soundTimer, 1);
+    add(state.audioPitch, 1);
+    add(state.drawFlag, 1);
+    add(state.vblank, 1);
+    add(state.randomState, 4);
+
+    return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Trace::encodeRecord(const Record& record, std::vector<byte>& output)
+{
+    writeLittleEndian(output, record.pc, 2);
+    writeLittleEndian(output, record.opCode, 2);
+
+    for (std::uint32_t mask = record.changes; ; )
+    {
+        const byte low = mask & 0x7F;
+        mask >>= 7;
+
+        output.push_back(static_cast<byte>(low | ((mask != 0) ? 0x80 : 0)));
+
+        if (mask == 0)
+            break;
+    }
+
+    const Registers& registers = record.registers;
+
+    for (unsigned int r = 0; r < Chip8State::c_numRegisters; ++r)
+    {
+        if (record.changes & (1u << r))
+            output.push_back(registers.V[r]);
+    }
+
+    if (record.changes & c_changedI)     writeLittleEndian(output, registers.I, 2);
+    if (record.changes & c_changedSP)    writeLittleEndian(output, registers.SP, 1);
+    if (record.changes & c_changedDelay) writeLittleEndian(output, registers.delayTimer, 1);
+    if (record.changes & c_changedSound) writeLittleEndian(output, registers.soundTimer, 1);
+    if (record.changes & c_changedKeys)  writeLittleEndian(output, registers.keys, 2);
+    if (record.changes & c_hasChecksum)  writeLittleEndian(output, record.checksum, 8);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Trace::decodeRecord(const byte*& data, const byte* end, Record& record)
+{
+    const byte* input = data;
+
+    if (end - input < 5)
+        return false;
+
+    record.pc     = static_cast<twoByte>(readLittleEndian(input, 2));
+    record.opCode = static_cast<twoByte>(readLittleEndian(input + 2, 2));
+    input += 4;
+
+    record.changes = 0;
+
+    for (unsigned int shift = 0; ; shift += 7)
+    {
+        if (input == end || shift > 28)
+            return false;
+
+        const byte value = *input++;
+        record.changes |= static_cast<std::uint32_t>(value & 0x7F) << shift;
+
+        if ((value & 0x80) == 0)
+            break;
+    }
+
+    // Bytes of the values the mask announces.
+    std::size_t valueSize = 0;
+
+    for (unsigned int r = 0; r < Chip8State::c_numRegisters; ++r)
+        valueSize += (record.changes >> r) & 1;
+
+    valueSize += ((record.changes & c_changedI) ? 2 : 0) + ((record.changes & c_changedSP) ? 1 : 0) + ((record.changes & c_changedDelay) ? 1 : 0) +
+                 ((record.changes & c_changedSound) ? 1 : 0) + ((record.changes & c_changedKeys) ? 2 : 0) + ((record.changes & c_hasChecksum) ? 8 : 0);
+
+    if (static_cast<std::size_t>(end - input) < valueSize)
+        return false;
+
+    Registers& registers = record.registers;
+
+    for (unsigned int r = 0; r < Chip8State::c_numRegisters; ++r)
+    {
+        if (record.changes & (1u << r))
+            registers.V[r] = *input++;
+    }
+
+    if (record.changes & c_changedI)     { registers.I          = static_cast<twoByte>(readLittleEndian(input, 2)); input += 2; }
+    if (record.changes & c_changedSP)    { registers.SP         = *input++; }
+    if (record.changes & c_changedDelay) { registers.delayTimer = *input++; }
+    if (record.changes & c_changedSound) { registers.soundTimer = *input++; }
+    if (record.changes & c_changedKeys)  { registers.keys       = static_cast<twoByte>(readLittleEndian(input, 2)); input += 2; }
+    if (record.changes & c_hasChecksum)  { record.checksum      = readLittleEndian(input, 8); input += 8; }
+
+    data = input;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::size_t Trace::getMaxCompressedSize(std::size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::size_t Trace::compress(const byte* input, std::size_t size, byte* output, std::uint32_t* hashTable)
+{
+    // Greedy parse: at each position, the last position with the same 4 bytes (hashed) is the match candidate.
+    std::fill_n(hashTable, std::size_t(1) << c_hashBits, 0);
+
+    byte* const outputStart = output;
+    std::size_t position = 0;
+    std::size_t anchor   = 0;     // Start of the literals not written yet.
+
+    while (position + 4 <= size)
+    {
+        const std::uint32_t sequence = read32(input + position);
+        const std::uint32_t hash     = (sequence * 2654435761u) >> (32 - c_hashBits);
+        const std::size_t   candidate = hashTable[hash];       // Position + 1, 0 for none.
+
+        hashTable[hash] = static_cast<std::uint32_t>(position + 1);
+
+        if (candidate == 0 || position - (candidate - 1) > c_maxDistance || read32(input + candidate - 1) != sequence)
+        {
+            ++position;
+            continue;
+        }
+
+        const std::size_t match = candidate - 1;
+        std::size_t length = 4;
+
+        while (position + length < size && input[match + length] == input[position + length])
+            ++length;
+
+        writeSequence(output, input + anchor, position - anchor, position - match, length);
+
+        position += length;
+        anchor    = position;
+    }
+
+    writeSequence(output, input + anchor, size - anchor, 0, 0);
+
+    return static_cast<std::size_t>(output - outputStart);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Trace::decompress(const byte* input, std::size_t size, byte* output, std::size_t outputSize)
+{
+    const byte* const end = input + size;
+    std::size_t position = 0;
+
+    while (input < end)
+    {
+        const byte token = *input++;
+
+        std::size_t literalLength = token >> 4;
+
+        if (literalLength == 15 && !readLength(input, end, literalLength))
+            return false;
+
+        if (static_cast<std::size_t>(end - input) < literalLength || outputSize - position < literalLength)
+            return false;
+
+        std::memcpy(output + position, input, literalLength);
+        input    += literalLength;
+        position += literalLength;
+
+        if (input == end)
+            break;
+
+        if (end - input < 2)
+            return false;
+
+        const std::size_t offset = input[0] | (input[1] << 8);
+        input += 2;
+
+        std::size_t matchLength = token & 0x0F;
+
+        if (matchLength == 15 && !readLength(input, end, matchLength))
+            return false;
+
+        matchLength += 4;
+
+        if (offset == 0 || offset > position || outputSize - position < matchLength)
+            return false;
+
+        // Byte by byte: the match may overlap the bytes it produces.
+        for (std::size_t i = 0; i < matchLength; ++i, ++position)
+            output[position] = output[position - offset];
+    }
+
+    return position == outputSize;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Tracer::Tracer(unsigned int checksumInterval) : checksumInterval(std::max(checksumInterval, 1u))
+{
+    buffer.reserve(Trace::c_maxChunkSize);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Tracer::onInstruction(const Chip8State& state, twoByte opCode)
+{
+    if (pending)
+        completeRecord(state);
+
+    record.pc     = state.PC;
+    record.opCode = opCode;
+    pending       = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Tracer::finish(const Chip8State& state)
+{
+    if (pending)
+        completeRecord(state);
+
+    pending = false;
+
+    if (writer != nullptr && !buffer.empty())
+        writer->submit(buffer);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Tracer::completeRecord(const Chip8State& state)
+{
+    // The state now is the state after the pending instruction. The first record also carries the
+    // registers that were non zero before it.
+    const Trace::Registers current = Trace::getRegisters(state);
+
+    std::uint32_t changes = 0;
+
+    for (unsigned int r = 0; r < Chip8State::c_numRegisters; ++r)
+    {
+        if (current.V[r] != previous.V[r])
+            changes |= 1u << r;
+    }
+
+    if (current.I != previous.I)                   changes |= Trace::c_changedI;
+    if (current.SP != previous.SP)                 changes |= Trace::c_changedSP;
+    if (current.delayTimer != previous.delayTimer) changes |= Trace::c_changedDelay;
+    if (current.soundTimer != previous.soundTimer) changes |= Trace::c_changedSound;
+    if (current.keys != previous.keys)             changes |= Trace::c_changedKeys;
+
+    ++records;
+
+    if (records % checksumInterval == 0)
+    {
+        changes        |= Trace::c_hasChecksum;
+        record.checksum = Trace::hashState(state);
+    }
+
+    record.changes   = changes;
+    record.registers = current;
+    previous         = current;
+
+    Trace::encodeRecord(record, buffer);
+
+    if (writer != nullptr && buffer.size() >= Trace::c_chunkSize)
+        writer->submit(buffer);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+TraceWriter::TraceWriter(std::size_t queueCapacity) : queue(queueCapacity), stopping(false), writtenBytes(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+TraceWriter::~TraceWriter()
+{
+    std::string error;
+    close(error);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool TraceWriter::open(const std::string& path, const Trace::Header& header, std::string& error)
+{
+    outputFile.open(path, std::ios::binary | std::ios::trunc);
+
+    std::vector<byte> headerBytes;
+    writeLittleEndian(headerBytes, Trace::c_magic, 4);
+    writeLittleEndian(headerBytes, Trace::c_version, 2);
+    writeLittleEndian(headerBytes, 0, 2);
+    writeLittleEndian(headerBytes, header.checksumInterval, 4);
+    writeLittleEndian(headerBytes, header.seed, 4);
+    writeLittleEndian(headerBytes, header.romHash, 8);
+    writeLittleEndian(headerBytes, header.quirkProfile, 1);
+    writeLittleEndian(headerBytes, header.dispatchMode, 1);
+    writeLittleEndian(headerBytes, 0, 2);
+
+    outputFile.write(reinterpret_cast<const char*>(headerBytes.data()), headerBytes.size());
+
+    if (!outputFile)
+    {
+        error = "can't write " + path;
+        outputFile.close();
+        return false;
+    }
+
+    writeFailed = false;
+    rawBytes    = 0;
+    writtenBytes.store(headerBytes.size(), std::memory_order_relaxed);
+    stopping.store(false, std::memory_order_relaxed);
+
+    writerThread = std::thread(&TraceWriter::writeChunks, this);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool TraceWriter::close(std::string& error)
+{
+    if (!writerThread.joinable())
+        return true;
+
+    stopping.store(true, std::memory_order_release);
+    writerThread.join();
+
+    outputFile.close();
+
+    if (writeFailed || outputFile.fail())
+    {
+        error = "trace write failed";
+        return false;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void TraceWriter::submit(std::vector<byte>& chunk)
+{
+    if (chunk.empty())
+        return;
+
+    std::vector<byte>* slot = queue.getWriteSlot();
+
+    while (slot == nullptr)
+    {
+        std::this_thread::yield();
+        slot = queue.getWriteSlot();
+    }
+
+    rawBytes += chunk.size();
+
+    // Swap instead of copy: the slot's previous chunk, already written, becomes the caller's next buffer.
+    slot->swap(chunk);
+    chunk.clear();
+    queue.push();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void TraceWriter::writeChunks()
+{
+    std::vector<std::uint32_t> hashTable(std::size_t(1) << c_hashBits);
+    std::vector<byte> compressed;
+    std::vector<byte> chunkHeader;
+
+    while (true)
+    {
+        const std::vector<byte>* chunk = queue.getReadSlot();
+
+        if (chunk == nullptr)
+        {
+            // Checked before the last look at the queue, so chunks submitted before close() are all written.
+            if (stopping.load(std::memory_order_acquire) && queue.getReadSlot() == nullptr)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        compressed.resize(Trace::getMaxCompressedSize(chunk->size()));
+        std::size_t storedSize = Trace::compress(chunk->data(), chunk->size(), compressed.data(), hashTable.data());
+
+        // Incompressible chunks are stored as they are, marked by equal sizes.
+        const byte* stored = compressed.data();
+
+        if (storedSize >= chunk->size())
+        {
+            stored     = chunk->data();
+            storedSize = chunk->size();
+        }
+
+        chunkHeader.clear();
+        writeLittleEndian(chunkHeader, chunk->size(), 4);
+        writeLittleEndian(chunkHeader, storedSize, 4);
+
+        outputFile.write(reinterpret_cast<const char*>(chunkHeader.data()), chunkHeader.size());
+        outputFile.write(reinterpret_cast<const char*>(stored), storedSize);
+
+        writtenBytes.fetch_add(chunkHeader.size() + storedSize, std::memory_order_relaxed);
+
+        queue.pop();
+
+        if (!outputFile)
+            writeFailed = true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool TraceReader::open(const std::string& path, std::string& error)
+{
+    inputFile.open(path, std::ios::binary);
+
+    byte headerBytes[c_headerSize];
+
+    if (!inputFile.read(reinterpret_cast<char*>(headerBytes), c_headerSize))
+    {
+        error = "can't read " + path;
+        return false;
+    }
+
+    if (readLittleEndian(headerBytes, 4) != Trace::c_magic || readLittleEndian(headerBytes + 4, 2) != Trace::c_version)
+    {
+        error = path + " is not a version " + std::to_string(Trace::c_version) + " trace";
+        return false;
+    }
+
+    header.checksumInterval = static_cast<std::uint32_t>(readLittleEndian(headerBytes + 8, 4));
+    header.seed             = static_cast<std::uint32_t>(readLittleEndian(headerBytes + 12, 4));
+    header.romHash          = readLittleEndian(headerBytes + 16, 8);
+    header.quirkProfile     = headerBytes[24];
+    header.dispatchMode     = headerBytes[25];
+
+    chunk.clear();
+    offset = 0;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool TraceReader::next(Trace::Record& record, std::string& error)
+{
+    if (offset == chunk.size())
+    {
+        byte chunkHeader[c_chunkHeaderSize];
+
+        if (!inputFile.read(reinterpret_cast<char*>(chunkHeader), c_chunkHeaderSize))
+        {
+            if (inputFile.gcount() != 0)
+                error = "truncated chunk header";
+
+            return false;
+        }
+
+        const std::size_t rawSize    = static_cast<std::size_t>(readLittleEndian(chunkHeader, 4));
+        const std::size_t storedSize = static_cast<std::size_t>(readLittleEndian(chunkHeader + 4, 4));
+
+        // Sizes are checked before anything is allocated for them, a damaged header could ask for gigabytes.
+        if (rawSize > Trace::c_maxChunkSize || storedSize > rawSize)
+        {
+            error = "damaged chunk header";
+            return false;
+        }
+
+        stored.resize(storedSize);
+        chunk.resize(rawSize);
+        offset = 0;
+
+        if (!inputFile.read(reinterpret_cast<char*>(stored.data()), storedSize))
+        {
+            error = "truncated chunk";
+            return false;
+        }
+
+        if (storedSize == rawSize)
+            chunk.swap(stored);
+        else if (!Trace::decompress(stored.data(), storedSize, chunk.data(), rawSize))
+        {
+            error = "damaged chunk";
+            return false;
+        }
+    }
+
+    const byte* data = chunk.data() + offset;
+
+    if (!Trace::decodeRecord(data, chunk.data() + chunk.size(), record))
+    {
+        error = "damaged record";
+        return false;
+    }
+
+    offset = static_cast<std::size_t>(data - chunk.data());
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,179 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8State.h"
+#include "SpscQueue.h"
+
+// Instruction level execution traces, to prove that two engines (or two builds) run a game identically.
+// Chip8 only reports instructions when built with CHIP8_TRACER defined, see Chip8::setTracer().
+//
+// A trace is one record per executed instruction: its address and opcode, the registers it changed
+// (V0-VF, I, SP, the timers and the keys; changes made between instructions, like timer updates, count
+// for the instruction before them) and, every checksumInterval records, a checksum of the whole machine
+// state after it. Records are delta encoded and typically take 5-6 bytes.
+//
+// File layout, little endian: "C8TR", version (u16), reserved (u16), checksum interval (u32), RNG seed
+// (u32), ROM hash (u64), quirk profile (u8), dispatch mode (u8), reserved (u16), then chunks of records:
+// raw size (u32), stored size (u32) and the chunk, LZ compressed unless both sizes are equal. A record
+// is pc (u16), opcode (u16), the change mask (LEB128) and the changed values in mask bit order: V0-VF
+// (u8 each), I (u16), SP, delay and sound timers (u8 each), keys (u16), checksum (u64).
+namespace Trace
+{
+    constexpr std::uint32_t c_magic   = 0x52543843;     // "C8TR"
+    constexpr std::uint16_t c_version = 1;
+
+    constexpr unsigned int c_defaultChecksumInterval = 4096;
+
+    // Records are handed to the writer once a chunk reaches c_chunkSize, so a chunk is at most one record
+    // (pc, opcode, a 22 bit LEB128 mask and every value) longer.
+    constexpr std::size_t c_chunkSize     = 64 * 1024;
+    constexpr std::size_t c_maxRecordSize = 2 + 2 + 4 + Chip8State::c_numRegisters + 2 + 1 + 1 + 1 + 2 + 8;
+    constexpr std::size_t c_maxChunkSize  = c_chunkSize + c_maxRecordSize;
+
+    // Change mask bits, bit r for Vr.
+    constexpr std::uint32_t c_changedI     = 1u << 16;
+    constexpr std::uint32_t c_changedSP    = 1u << 17;
+    constexpr std::uint32_t c_changedDelay = 1u << 18;
+    constexpr std::uint32_t c_changedSound = 1u << 19;
+    constexpr std::uint32_t c_changedKeys  = 1u << 20;
+    constexpr std::uint32_t c_hasChecksum  = 1u << 21;
+
+    struct Header
+    {
+        std::uint32_t checksumInterval = c_defaultChecksumInterval;
+        std::uint32_t seed             = 0;
+        std::uint64_t romHash          = 0;
+        byte          quirkProfile     = 0;     // Chip8::QuirkProfile and Chip8::DispatchMode values.
+        byte          dispatchMode     = 0;
+    };
+
+    struct Registers
+    {
+        std::array<byte, Chip8State::c_numRegisters> V = {};
+        twoByte I          = 0;
+        byte    SP         = 0;
+        byte    delayTimer = 0;
+        byte    soundTimer = 0;
+        twoByte keys       = 0;
+
+        bool operator==(const Registers& other) const;
+        bool operator!=(const Registers& other) const { return !(*this == other); }
+    };
+
+    struct Record
+    {
+        twoByte       pc       = 0;
+        twoByte       opCode   = 0;
+        std::uint32_t changes  = 0;         // Change mask.
+        Registers     registers;            // All the registers after the instruction, the changed ones from this record.
+        std::uint64_t checksum = 0;         // When changes has c_hasChecksum.
+    };
+
+    Registers getRegisters(const Chip8State& state);
+    std::uint64_t hashState(const Chip8State& state);      // FNV-1a 64 over every field, padding excluded.
+
+    void encodeRecord(const Record& record, std::vector<byte>& output);
+    bool decodeRecord(const byte*& data, const byte* end, Record& record);     // record holds the registers of the previous one.
+
+    // Byte oriented LZ77 (LZ4 style sequences: literal run, then a match of 4+ bytes up to 64 KiB back).
+    // compress() needs getMaxCompressedSize() bytes of output and a 4096 entry hash table.
+    std::size_t getMaxCompressedSize(std::size_t size);
+    std::size_t compress(const byte* input, std::size_t size, byte* output, std::uint32_t* hashTable);
+    bool        decompress(const byte* input, std::size_t size, byte* output, std::size_t outputSize);
+}
+
+class TraceWriter;
+
+// Emulation side: turns each instruction into a record. Records accumulate in a buffer, which is handed
+// to the writer in 64 KiB chunks when there is one, and otherwise stays for the caller to read (in memory
+// comparisons) and clear.
+class Tracer
+{
+public:
+    explicit Tracer(unsigned int checksumInterval = Trace::c_defaultChecksumInterval);
+
+    void setWriter(TraceWriter* newWriter) { writer = newWriter; }
+
+    // Called by Chip8 before each instruction, with the machine state at that point.
+    void onInstruction(const Chip8State& state, twoByte opCode);
+
+    // Completes the record of the last instruction from the final state, and hands the buffer to the writer.
+    void finish(const Chip8State& state);
+
+    const std::vector<byte>& getBuffer() const { return buffer; }
+    void clearBuffer()                         { buffer.clear(); }
+
+    std::uint64_t getRecords() const { return records; }
+
+private:
+    void completeRecord(const Chip8State& state);
+
+    const unsigned int checksumInterval;
+    TraceWriter* writer = nullptr;
+
+    bool          pending = false;      // The last instruction reported, its changes are known at the next one.
+    Trace::Record record;
+    Trace::Registers previous;          // Registers before the pending instruction.
+
+    std::vector<byte> buffer;
+    std::uint64_t records = 0;
+};
+
+// Compresses chunks of records and writes them on a background thread. A full queue makes submit() wait:
+// a trace with holes would be useless.
+class TraceWriter
+{
+public:
+    explicit TraceWriter(std::size_t queueCapacity = 16);
+    ~TraceWriter();
+
+    bool open(const std::string& path, const Trace::Header& header, std::string& error);
+    bool close(std::string& error);      // Writes the queued chunks and stops the writer thread.
+
+    bool isOpen() const { return writerThread.joinable(); }
+
+    // Takes the chunk's contents and leaves it empty (with the capacity of an earlier chunk).
+    void submit(std::vector<byte>& chunk);
+
+    std::uint64_t getRawBytes() const     { return rawBytes; }
+    std::uint64_t getWrittenBytes() const { return writtenBytes.load(std::memory_order_relaxed); }
+
+private:
+    void writeChunks();
+
+    SpscQueue<std::vector<byte>> queue;
+    std::thread writerThread;
+    std::atomic<bool> stopping;
+
+    std::ofstream outputFile;
+    bool writeFailed = false;
+
+    std::uint64_t rawBytes = 0;
+    std::atomic<std::uint64_t> writtenBytes;
+};
+
+// Sequential reader of a trace file.
+class TraceReader
+{
+public:
+    bool open(const std::string& path, std::string& error);
+
+    const Trace::Header& getHeader() const { return header; }
+
+    // False at the end of the trace, or with error set when a chunk or record is damaged.
+    bool next(Trace::Record& record, std::string& error);
+
+private:
+    std::ifstream inputFile;
+    Trace::Header header;
+
+    std::vector<byte> stored;
+    std::vector<byte> chunk;
+    std::size_t offset = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+// Lock-free single producer / single consumer triple buffer.
+// The producer always has a back buffer to write into and the consumer always reads the newest
+// complete value, neither side ever waits for the other. Values published faster than they are
+// consumed are simply overwritten.
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : buffers{}, middle(1), backIndex(0), frontIndex(2) {}
+
+    // Producer side
+    T& getWriteBuffer() { return buffers[backIndex]; }
+
+    void publish()
+    {
+        // Hand the back buffer over as the newest value and take the old middle one to write next.
+        const unsigned char previous = middle.exchange(static_cast<unsigned char>(backIndex | c_newFlag), std::memory_order_acq_rel);
+        backIndex = previous & c_indexMask;
+    }
+
+    // Consumer side: returns true when a newer value than the one in the read buffer was picked up.
+    bool update()
+    {
+        if ((middle.load(std::memory_order_acquire) & c_newFlag) == 0)
+            return false;
+
+        const unsigned char previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & c_indexMask;
+
+        return true;
+    }
+
+    const T& getReadBuffer() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr unsigned char c_indexMask = 0x03;
+    static constexpr unsigned char c_newFlag   = 0x04;
+
+    std::array<T, 3> buffers;
+
+    alignas(64) std::atomic<unsigned char> middle;      // Index of the middle buffer, plus c_newFlag when it wasn't read yet.
+    alignas(64) unsigned char backIndex;                // Only touched by the producer.
+    alignas(64) unsigned char frontIndex;               // Only touched by the consumer.
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size thread pool where every worker owns a task deque.
+// A worker pops its own tasks from the back (most recently pushed, still hot in cache) and,
+// when it runs out, steals from the front of the other workers' deques.
+class WorkStealingThreadPool
+{
+public:
+    explicit WorkStealingThreadPool(unsigned int numThreads = std::thread::hardware_concurrency());
+    ~WorkStealingThreadPool();
+
+    WorkStealingThreadPool(const WorkStealingThreadPool&)            = delete;
+    WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+
+    unsigned int getNumThreads() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(unsigned int workerIndex);
+    bool popTask(unsigned int workerIndex, std::function<void()>& task);
+    bool stealTask(unsigned int thiefIndex, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<unsigned int> nextQueue;
+    std::atomic<unsigned int> queuedTasks;     // Submitted and not yet picked up by a worker.
+    std::atomic<unsigned int> pendingTasks;    // Submitted and not yet finished.
+    std::atomic<bool>         stopping;
+
+    std::mutex              sleepMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline WorkStealingThreadPool::WorkStealingThreadPool(unsigned int numThreads)
+    : nextQueue(0)
+    , queuedTasks(0)
+    , pendingTasks(0)
+    , stopping(false)
+{
+    if (numThreads == 0)
+        numThreads = 1;
+
+    for (unsigned int i = 0; i < numThreads; ++i)
+        queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (unsigned int i = 0; i < numThreads; ++i)
+        workers.emplace_back(&WorkStealingThreadPool::workerLoop, this, i);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+
+    workAvailable.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline void WorkStealingThreadPool::submit(std::function<void()> task)
+{
+    // Spread the tasks round robin, idle workers balance the rest by stealing.
+    const unsigned int queueIndex = nextQueue++ % getNumThreads();
+
+    ++pendingTasks;
+
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(std::move(task));
+        ++queuedTasks;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+
+    workAvailable.notify_one();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline void WorkStealingThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allDone.wait(lock, [this]() { return pendingTasks == 0; });
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline void WorkStealingThreadPool::workerLoop(unsigned int workerIndex)
+{
+    std::function<void()> task;
+
+    while (true)
+    {
+        if (popTask(workerIndex, task) || stealTask(workerIndex, task))
+        {
+            task();
+            task = nullptr;
+
+            if (--pendingTasks == 0)
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                allDone.notify_all();
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+
+        if (stopping)
+            return;
+
+        // Tasks may have been pushed between the failed steal and taking the lock, re-check before sleeping.
+        workAvailable.wait(lock, [this]() { return stopping || queuedTasks > 0; });
+
+        if (stopping)
+            return;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline bool WorkStealingThreadPool::popTask(unsigned int workerIndex, std::function<void()>& task)
+{
+    WorkerQueue& queue = *queues[workerIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --queuedTasks;
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+inline bool WorkStealingThreadPool::stealTask(unsigned int thiefIndex, std::function<void()>& task)
+{
+    const unsigned int numQueues = getNumThreads();
+
+    for (unsigned int offset = 1; offset < numQueues; ++offset)
+    {
+        WorkerQueue& victim = *queues[(thiefIndex + offset) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (victim.tasks.empty())
+            continue;
+
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        --queuedTasks;
+
+        return true;
+    }
+
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -1,81 +1,421 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
-#include "MultimediaSystem.h"
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
 #include "Chip8.h"
+#include "FrameStream.h"
+#include "InputMovie.h"
+#include "MediaBackend.h"
+#include "RomLibrary.h"
+#include "Scheduler.h"
+#include "ToneGenerator.h"
+#include "TripleBuffer.h"
+
+static const char* const c_usage = "Usage: CHIP8_Emulator.exe <game> [--dispatch map|table|blocks] [--mode fixed|turbo|frame] [--ips <500-20000>] [--quirks chip8|vip|schip|xochip] [--seed <n>] [--record <movie>] [--replay <movie>] [--frames-out <stream>] [--backend sdl|software|null] [--scale <1-64>] [--phosphor <0-99>] [--shared-memory <name>] [--max-frames <n>] [--profile <report prefix>] \n";
 
 int main(int argc, char* argv[])
 {
     // Check if the name of the game was sent as an argument
-    if (argc != 2)
+    if (argc < 2)
     {
-        std::cout << "No game loaded. Usage: CHIP8_Emulator.exe <game> \n";
+        std::cout << "No game loaded. " << c_usage;
         std::system("pause");
         return 1;
     } 
+
+    Chip8::DispatchMode dispatchMode   = Chip8::DispatchMode::JumpTable;
+    Scheduler::Mode     schedulerMode  = Scheduler::Mode::FrameLocked;
+    unsigned int instructionsPerSecond = 600;
+    std::string profilePrefix;
+
+    Chip8::QuirkProfile quirkProfile = Chip8::QuirkProfile::Chip8;
+    bool quirkProfileGiven = false;
+
+    std::uint32_t randomSeed = std::random_device()();
+    std::string recordPath;
+    std::string replayPath;
+    std::string framesPath;
+
+    std::string backendName = "sdl";
+    MediaBackend::VideoOptions videoOptions;
+    std::uint64_t maxFrames = 0;
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        const std::string option(argv[i]);
+        const std::string value((i + 1 < argc) ? argv[i + 1] : "");
+
+        bool valid = false;
+
+        if (option == "--dispatch")
+            valid = Chip8::parseDispatchMode(value, dispatchMode);
+        else if (option == "--mode")
+            valid = Scheduler::parseMode(value, schedulerMode);
+        else if (option == "--ips")
+        {
+            valid = !value.empty() && value.size() < 9 && value.find_first_not_of("0123456789") == std::string::npos;
+
+            if (valid)
+                instructionsPerSecond = std::stoul(value);
+        }
+        else if (option == "--quirks")
+        {
+            valid = Chip8::parseQuirkProfile(value, quirkProfile);
+            quirkProfileGiven = true;
+        }
+        else if (option == "--seed")
+        {
+            valid = !value.empty() && value.size() < 10 && value.find_first_not_of("0123456789") == std::string::npos;
+
+            if (valid)
+                randomSeed = std::stoul(value);
+        }
+        else if (option == "--record")
+        {
+            valid = !value.empty();
+            recordPath = value;
+        }
+        else if (option == "--replay")
+        {
+            valid = !value.empty();
+            replayPath = value;
+        }
+        else if (option == "--frames-out")
+        {
+            valid = !value.empty();
+            framesPath = value;
+        }
+        else if (option == "--backend")
+        {
+            valid = !value.empty();
+            backendName = value;
+        }
+        else if (option == "--scale" || option == "--phosphor")
+        {
+            valid = !value.empty() && value.size() < 3 && value.find_first_not_of("0123456789") == std::string::npos;
+
+            if (valid)
+                ((option == "--scale") ? videoOptions.scale : videoOptions.phosphor) = std::stoul(value);
+        }
+        else if (option == "--shared-memory")
+        {
+            valid = !value.empty();
+            videoOptions.sharedMemoryName = value;
+        }
+        else if (option == "--max-frames")
+        {
+            valid = !value.empty() && value.size() < 10 && value.find_first_not_of("0123456789") == std::string::npos;
+
+            if (valid)
+                maxFrames = std::stoul(value);
+        }
+        else if (option == "--profile")
+        {
+#ifdef CHIP8_PROFILER
+            valid = !value.empty();
+            profilePrefix = value;
+#else
+            std::cout << "Profiling needs a build with CHIP8_PROFILER defined. \n";
+            return 1;
+#endif
+        }
+
+        if (!valid)
+        {
+            std::cout << "Unknown option. " << c_usage;
+            std::system("pause");
+            return 1;
+        }
+    }
     
-    // Initialize Systems
-    MultimediaSystem& multimediaSystem = MultimediaSystem::getInstance();
+    // A replay runs with the settings of its recording.
+    InputMovie movie;
+    std::string error;
 
-    multimediaSystem.initializeGraphics("CHIP-8 Emulator", 640, 320, Chip8::c_displayWidth, Chip8::c_displayHeight);
-    multimediaSystem.initializeSound("beep.wav");
-    multimediaSystem.initializeInput(Chip8::c_numKeys);
+    if (!replayPath.empty())
+    {
+        if (!movie.load(replayPath, error))
+        {
+            std::cout << "Failed to load movie (" << error << "). \n";
+            std::system("pause");
+            return 1;
+        }
+
+        randomSeed            = movie.seed;
+        instructionsPerSecond = movie.instructionsPerSecond;
+        quirkProfile          = static_cast<Chip8::QuirkProfile>(movie.quirkProfile);
+        quirkProfileGiven     = true;
+    }
+
+    // Initialize Systems: the backend takes the frames, plays the sound and reads the keys.
+    std::unique_ptr<MediaBackend> backend = MediaBackend::create(backendName);
+
+    if (!backend)
+    {
+        std::cout << "Unknown or unavailable backend " << backendName << ". " << c_usage;
+        std::system("pause");
+        return 1;
+    }
 
-    Chip8 chip8;
+    if (!backend->initialize(videoOptions, error))
+    {
+        std::cout << "Failed to initialize the " << backendName << " backend (" << error << "). \n";
+        std::system("pause");
+        return 1;
+    }
+
+    ToneGenerator toneGenerator;
+    backend->initializeSound(toneGenerator);
+
+    Chip8 chip8(randomSeed);
     chip8.initialize();
+    chip8.setDispatchMode(dispatchMode);
 
     // Load game
     const std::string& gamePath(argv[1]);
 
-    if (!chip8.loadGame(gamePath))
+    RomImage game;
+
+    if (!loadRomImage(gamePath, game, error) || !chip8.loadGame(game.data))
     {
-        std::cout << "Failed to load game. Check that the game name is spelled correctly or try to load a different game. \n";
+        std::cout << "Failed to load game (" << error << "). Check that the game name is spelled correctly or try to load a different game. \n";
         std::system("pause");
         return 1;
     }
 
-    // CHIP-8 Loop
-    double currentTime = multimediaSystem.getTicks();
-    double accumTime   = 0.0;
+    // Unless given, the quirk profile is the one the ROM library index of the game's directory has for its hash.
+    if (!quirkProfileGiven)
+    {
+        RomLibrary library;
+        const std::string gameDirectory = std::filesystem::path(gamePath).parent_path().string();
 
-    const double timeStep = 16.6666;                // 60 Hz in ms.
-    const unsigned int chip8CycleFrequency = 10;    // 600 Hz
+        if (library.open(gameDirectory.empty() ? "." : gameDirectory, error, false))
+        {
+            const auto indexedGame = library.findByHash(game.hash);
 
-    bool quit = false;
+            if (indexedGame && !Chip8::parseQuirkProfile(indexedGame->quirkProfile, quirkProfile))
+            {
+                std::cout << "Unknown quirk profile \"" << indexedGame->quirkProfile << "\" for " << indexedGame->name << " in " << RomLibrary::c_indexFileName
+                          << ", use chip8, vip, schip or xochip. \n";
+                std::system("pause");
+                return 1;
+            }
+        }
+    }
 
-    while (!quit)
+    if (!replayPath.empty() && game.hash != movie.romHash)
     {
-        const double newTime = multimediaSystem.getTicks();
-        accumTime  += newTime - currentTime;
-        currentTime = newTime;
+        std::cout << "The movie was recorded with a different game. \n";
+        std::system("pause");
+        return 1;
+    }
 
-        while (accumTime >= timeStep)
-        {
-            accumTime -= timeStep;
+    chip8.setQuirkProfile(quirkProfile);
+
+#ifdef CHIP8_PROFILER
+    Profiler profiler;
+
+    if (!profilePrefix.empty())
+        chip8.setProfiler(&profiler);
+#endif
+
+    // State shared by the emulation thread and the render thread (this one, SDL wants events and rendering on the main thread).
+    TripleBuffer<Chip8::DisplayRows> frames;        // Finished frames, emulation -> render.
+    std::atomic<twoByte> keyMask(0);                // Keypad state, render -> emulation.
+    std::atomic<bool>    quit(false);
+
+    // CHIP-8 Loop: runs on its own thread so a render blocked on vsync never stalls emulation.
+    // The scheduler decides how many instructions run when, timers and frames follow the 60 Hz emulated clock.
+    Scheduler scheduler(schedulerMode, instructionsPerSecond);
 
-            multimediaSystem.handleInputEvents(quit);
+    // Keys only change at frame boundaries, so a movie of them is enough to replay the run exactly.
+    InputMovie::Player moviePlayer(movie);
 
-            if (quit)
-                break;
+    InputMovie recording;
+    recording.seed                  = randomSeed;
+    recording.instructionsPerSecond = scheduler.getInstructionsPerSecond();
+    recording.romHash               = game.hash;
+    recording.quirkProfile          = static_cast<byte>(quirkProfile);
 
-            chip8.setKeys(multimediaSystem.getUpdatedKeys());
+    const bool replaying = !replayPath.empty();
 
-            for (unsigned int i = 0; i < chip8CycleFrequency; ++i)
-                chip8.emulateCycle();
+    chip8.setKeys(replaying ? moviePlayer.getKeys(0) : 0);
 
-            bool playSoundNeeded = false;
-            chip8.updateTimers(playSoundNeeded);
+    // Every drawn frame to a compressed stream, written on a background thread (see tools/FrameDecode.cpp).
+    FrameStreamWriter frameStream;
 
-            if (playSoundNeeded)
-                multimediaSystem.playSound();
+    if (!framesPath.empty() && !frameStream.open(framesPath, error))
+    {
+        std::cout << "Failed to open frame stream (" << error << "). \n";
+        std::system("pause");
+        return 1;
+    }
 
+    std::thread emulationThread([&]()
+    {
+        // The audio callback plays while the sound timer runs: switched on right after the instructions that
+        // start it (FX18), off at the tick that ends it.
+        const bool xoChipAudio = (chip8.getQuirkProfile() == Chip8::QuirkProfile::XoChip);
+        bool patternLoaded     = false;
+
+        const auto runInstructions = [&](unsigned int count)
+        {
+            chip8.emulateCycles(count);
+            toneGenerator.setActive(chip8.isSoundActive());
+        };
+
+        const auto timerTick = [&]()
+        {
+            bool playSound = false;
+            chip8.updateTimers(playSound);
+            toneGenerator.setActive(playSound);
+
+            // The square wave plays until the game loads its first pattern, from then on every pattern is passed
+            // through, an all-zero one included (it's silence, not the square wave).
+            if (xoChipAudio && (patternLoaded || chip8.hasAudioPattern()))
+            {
+                toneGenerator.setPattern(chip8.getAudioPattern(), chip8.getAudioPitch());
+                patternLoaded = true;
+            }
+
+            // Frame f ends at timer tick f + 1, the frame that starts now is the number of ticks so far.
+            const std::uint32_t frame = static_cast<std::uint32_t>(scheduler.getTimerTicks());
+
+            // Only publish frames with a net pixel change, erase-and-redraw flicker doesn't reach the renderer.
             if (chip8.getDrawFlag())
             {
-                multimediaSystem.renderDisplay(chip8.getDisplay());
+                if (frameStream.isOpen())
+                    frameStream.submit(frame - 1, chip8.getDisplayRows());
+
+                if (chip8.takeChangedRows() != 0)
+                {
+                    frames.getWriteBuffer() = chip8.getDisplayRows();
+                    frames.publish();
+                }
+
                 chip8.setDrawFlagFalse();
             }
+
+            // Keys for the frame that starts now. Past the end of a replay the keyboard takes over.
+            const twoByte keys = (replaying && frame < movie.frameCount) ? moviePlayer.getKeys(frame) : keyMask.load(std::memory_order_relaxed);
+
+            chip8.setKeys(keys);
+
+            if (!recordPath.empty())
+                recording.record(frame, keys);
+
+            // Headless runs end on their own.
+            if (maxFrames != 0 && frame >= maxFrames)
+                quit.store(true, std::memory_order_relaxed);
+        };
+
+        while (!quit.load(std::memory_order_relaxed))
+        {
+            scheduler.runSlice(runInstructions, timerTick);
+            scheduler.waitForNextSlice();
         }
+    });
+
+    // Render Loop: input in, frames out. The backend only gets a frame when a new one was published,
+    // with the rows that differ from the last one it got (frames can be skipped in between). A backend
+    // still animating the last frame (phosphor fading out) gets it again at the frame rate.
+    Chip8::DisplayRows uploadedRows = {};
+    bool firstFrame = true;
+
+    std::chrono::steady_clock::time_point lastRenderTime = std::chrono::steady_clock::now();
+
+    double shownInstructionsPerSecond = -1.0;
+
+    while (!quit.load(std::memory_order_relaxed))
+    {
+        bool quitRequested = false;
+        backend->handleInputEvents(quitRequested);
+
+        if (quitRequested)
+        {
+            quit.store(true, std::memory_order_relaxed);
+            break;
+        }
+
+        keyMask.store(backend->getKeyMask(), std::memory_order_relaxed);
+
+        // Scheduler statistics in the title bar, to tune the mode and rate per game.
+        if (scheduler.getAchievedInstructionsPerSecond() != shownInstructionsPerSecond)
+        {
+            shownInstructionsPerSecond = scheduler.getAchievedInstructionsPerSecond();
+
+            std::ostringstream title;
+            title << "CHIP-8 Emulator - " << std::fixed << std::setprecision(0) << shownInstructionsPerSecond << " instructions/s, pacing error "
+                  << std::setprecision(3) << scheduler.getPacingErrorNs() / 1000000.0 << " ms";
+
+            backend->setWindowTitle(title.str());
+        }
+
+        if (frames.update())
+        {
+            const Chip8::DisplayRows& rows = frames.getReadBuffer();
+            std::uint32_t dirtyRows = firstFrame ? ~0u : 0u;
+
+            for (unsigned int row = 0; row < Chip8::c_displayHeight; ++row)
+            {
+                if (rows[row] != uploadedRows[row])
+                    dirtyRows |= 1u << row;
+            }
+
+            uploadedRows = rows;
+            firstFrame   = false;
+
+            backend->renderDisplay(rows, dirtyRows);
+            lastRenderTime = std::chrono::steady_clock::now();
+        }
+        else if (backend->isAnimating() && std::chrono::steady_clock::now() - lastRenderTime >= std::chrono::microseconds(1000000 / Scheduler::c_timerFrequency))
+        {
+            backend->renderDisplay(uploadedRows, 0);
+            lastRenderTime = std::chrono::steady_clock::now();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    emulationThread.join();
+
+    if (frameStream.isOpen())
+    {
+        if (!frameStream.close(error))
+            std::cout << "Failed to write frame stream (" << error << "). \n";
+        else if (frameStream.getDroppedFrames() > 0)
+            std::cout << frameStream.getDroppedFrames() << " of " << frameStream.getSubmittedFrames() << " frames dropped from the frame stream. \n";
+    }
+
+    if (!recordPath.empty())
+    {
+        recording.frameCount = static_cast<std::uint32_t>(scheduler.getTimerTicks());
+
+        if (!recording.save(recordPath, error))
+            std::cout << "Failed to save movie (" << error << "). \n";
+    }
+
+#ifdef CHIP8_PROFILER
+    // <prefix>.folded for flame graphs, <prefix>.csv for the counters.
+    if (!profilePrefix.empty())
+    {
+        std::ofstream foldedFile(profilePrefix + ".folded");
+        profiler.writeFoldedStacks(foldedFile, std::filesystem::path(gamePath).filename().string());
+
+        std::ofstream csvFile(profilePrefix + ".csv");
+        profiler.writeCsv(csvFile);
     }
+#endif
 
-    multimediaSystem.uninitialize();
+    backend->uninitialize();
 
     return 0;
 }
@@ -0,0 +1,616 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/Chip8.h"
+#include "../src/FrameStream.h"
+#include "../src/LockstepBatch.h"
+#include "../src/Profiler.h"
+#include "../src/RomLibrary.h"
+#include "../src/WorkStealingThreadPool.h"
+#include "ToolOptions.h"
+
+// Headless batch runner: runs many independent Chip8 instances (ROMs x seeds) on a work stealing
+// thread pool, as fast as possible and without SDL, and writes one CSV line of results per instance.
+//
+// Usage: BatchRunner [options] <rom> [<rom> ...]
+//   --rom-list <file>        Read additional ROM paths from a file, one per line.
+//   --library <dir>          Run every game of a ROM directory, through its index (see RomLibrary).
+//   --seeds <first>:<last>   Run every ROM once per seed in the inclusive range (default 0:0, at most 2^20 seeds).
+//   --cycles <n>             Run each instance for n cycles.
+//   --frames <n>             Run each instance for n frames of 10 cycles plus a timer update (default 600).
+//   --frame-cycles <n>       Cycles per frame for --frames (default 10, 10 x 60 = 600 instructions per second).
+//   --no-idle-skip           Execute every instruction of idle waits instead of skipping them (see
+//                            Chip8::setIdleSkipping(), results are the same either way).
+//   --random-keys            Drive the keypad with a per frame random key mask derived from the seed.
+//   --threads <n>            Worker threads, at least 1 (default: hardware concurrency).
+//   --dispatch <engine>      Opcode dispatch engine: map, table or blocks (default: table).
+//   --lockstep               Run the seeds of each ROM together, up to 32 per LockstepBatch (ignores --dispatch).
+//   --quirks <profile>       Quirk profile for every ROM: chip8, vip, schip or xochip (default: the profile in the
+//                            library index for --library ROMs, chip8 otherwise).
+//   --output <file>          Results CSV (default: stdout).
+//   --frames-out <dir>       Write the frames each instance draws to <dir>/<rom file>_<seed>.c8fs (--frames runs
+//                            only, see tools/FrameDecode.cpp).
+//   --profile <prefix>       Profile every ROM over all its instances (builds with CHIP8_PROFILER only): writes
+//                            <prefix>.folded (all ROMs) and <prefix>_<rom>.csv.
+
+namespace
+{
+    constexpr unsigned int c_cyclesPerSlice = 1024 * 1024;
+    constexpr unsigned int c_maxSeeds       = 1024 * 1024;     // Per ROM, bounds the results table.
+
+    struct Options
+    {
+        std::vector<std::string> romPaths;
+        std::string libraryPath;
+        unsigned int firstSeed    = 0;
+        unsigned int lastSeed     = 0;
+        unsigned long long cycles = 0;
+        unsigned long long frames = 600;
+        unsigned int cyclesPerFrame = 10;
+        bool idleSkipping           = true;
+        bool randomKeys             = false;
+        unsigned int threads      = std::thread::hardware_concurrency();
+        Chip8::DispatchMode dispatchMode = Chip8::DispatchMode::JumpTable;
+        bool lockstep                    = false;
+        Chip8::QuirkProfile quirkProfile = Chip8::QuirkProfile::Chip8;
+        bool quirkProfileGiven           = false;
+        std::string outputPath;
+        std::string framesDirectory;
+        std::string profilePrefix;
+    };
+
+    struct InstanceResult
+    {
+        std::size_t romIndex = 0;
+        unsigned int seed    = 0;
+        bool loaded          = false;
+        unsigned long long cycles = 0;
+        double cyclesPerSecond    = 0.0;
+        std::uint64_t displayHash = 0;
+        std::array<byte, Chip8::c_numRegisters> V{};
+        twoByte I  = 0;
+        twoByte PC = 0;
+        bool trapped = false;
+        std::uint64_t skippedCycles = 0;
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const bool hasValue = (i + 1 < argc);
+
+            if (argument == "--rom-list" && hasValue)
+            {
+                std::ifstream listFile(argv[++i]);
+                std::string line;
+
+                if (listFile.fail())
+                    return false;
+
+                while (std::getline(listFile, line))
+                {
+                    if (!line.empty())
+                        options.romPaths.push_back(line);
+                }
+            }
+            else if (argument == "--library" && hasValue)
+            {
+                options.libraryPath = argv[++i];
+            }
+            else if (argument == "--seeds" && hasValue)
+            {
+                const std::string range(argv[++i]);
+                const std::size_t separator = range.find(':');
+
+                if (!parseNumber(range.substr(0, separator), options.firstSeed))
+                    return false;
+
+                options.lastSeed = options.firstSeed;
+
+                if (separator != std::string::npos && !parseNumber(range.substr(separator + 1), options.lastSeed))
+                    return false;
+
+                if (options.lastSeed < options.firstSeed || options.lastSeed - options.firstSeed >= c_maxSeeds)
+                    return false;
+            }
+            else if (argument == "--cycles" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.cycles))
+                    return false;
+
+                options.frames = 0;
+            }
+            else if (argument == "--frames" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.frames))
+                    return false;
+
+                options.cycles = 0;
+            }
+            else if (argument == "--frame-cycles" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.cyclesPerFrame))
+                    return false;
+            }
+            else if (argument == "--no-idle-skip")
+            {
+                options.idleSkipping = false;
+            }
+            else if (argument == "--random-keys")
+            {
+                options.randomKeys = true;
+            }
+            else if (argument == "--threads" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.threads) || options.threads == 0)
+                    return false;
+            }
+            else if (argument == "--dispatch" && hasValue)
+            {
+                if (!Chip8::parseDispatchMode(argv[++i], options.dispatchMode))
+                    return false;
+            }
+            else if (argument == "--lockstep")
+            {
+                options.lockstep = true;
+            }
+            else if (argument == "--quirks" && hasValue)
+            {
+                if (!Chip8::parseQuirkProfile(argv[++i], options.quirkProfile))
+                    return false;
+
+                options.quirkProfileGiven = true;
+            }
+            else if (argument == "--output" && hasValue)
+            {
+                options.outputPath = argv[++i];
+            }
+            else if (argument == "--frames-out" && hasValue)
+            {
+                options.framesDirectory = argv[++i];
+            }
+            else if (argument == "--profile" && hasValue)
+            {
+#ifndef CHIP8_PROFILER
+                std::cout << "Profiling needs a build with CHIP8_PROFILER defined.\n";
+                return false;
+#endif
+                options.profilePrefix = argv[++i];
+            }
+            else if (argument.compare(0, 2, "--") == 0)
+            {
+                return false;
+            }
+            else
+            {
+                options.romPaths.push_back(argument);
+            }
+        }
+
+        // The lockstep core has no profiler hooks.
+        if (options.lockstep && !options.profilePrefix.empty())
+            return false;
+
+        if (options.cyclesPerFrame == 0)
+            return false;
+
+        // Frames only exist in frame runs.
+        if (!options.framesDirectory.empty() && options.frames == 0)
+            return false;
+
+        return !options.romPaths.empty() || !options.libraryPath.empty();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Drawn frames are queued and written by a thread of the stream. Every frame is kept: the instance waits
+    // when it draws faster than the stream is written.
+    bool openFrameStream(const Options& options, const RomImage& rom, unsigned int seed, FrameStreamWriter& frameStream)
+    {
+        const std::string fileName = rom.name + "_" + std::to_string(seed) + ".c8fs";
+        std::string error;
+
+        if (!frameStream.open((std::filesystem::path(options.framesDirectory) / fileName).string(), error))
+        {
+            std::cerr << "Failed to open frame stream " << error << "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void closeFrameStream(FrameStreamWriter& frameStream)
+    {
+        std::string error;
+
+        if (!frameStream.close(error))
+            std::cerr << "Failed to write frame stream (" << error << ")\n";
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void runInstance(const Options& options, const RomImage& rom, InstanceResult& result, Profiler* profiler)
+    {
+        // Everything an instance touches is owned by the instance, seeds included, so instances scale across cores.
+        Chip8 chip8(result.seed);
+        chip8.initialize();
+        chip8.setDispatchMode(options.dispatchMode);
+        chip8.setIdleSkipping(options.idleSkipping);
+
+        Chip8::QuirkProfile quirkProfile = options.quirkProfile;
+
+        if (!options.quirkProfileGiven)
+            Chip8::parseQuirkProfile(rom.quirkProfile, quirkProfile);
+
+        chip8.setQuirkProfile(quirkProfile);
+
+#ifdef CHIP8_PROFILER
+        chip8.setProfiler(profiler);
+#else
+        (void)profiler;
+#endif
+
+        result.loaded = chip8.loadGame(rom.data);
+
+        if (!result.loaded)
+            return;
+
+        std::mt19937 keyGenerator(result.seed ^ 0x9E3779B9u);
+
+        FrameStreamWriter frameStream(FrameStreamWriter::Overflow::Wait);
+
+        if (!options.framesDirectory.empty())
+            openFrameStream(options, rom, result.seed, frameStream);
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        if (options.frames > 0)
+        {
+            bool playSound = false;
+
+            for (unsigned long long frame = 0; frame < options.frames; ++frame)
+            {
+                if (options.randomKeys)
+                    chip8.setKeys(static_cast<twoByte>(keyGenerator()));
+
+                chip8.emulateCycles(options.cyclesPerFrame);
+
+                chip8.updateTimers(playSound);
+
+                if (frameStream.isOpen() && chip8.getDrawFlag())
+                {
+                    frameStream.submit(static_cast<std::uint32_t>(frame), chip8.getDisplayRows());
+                    chip8.setDrawFlagFalse();
+                }
+            }
+
+            result.cycles = options.frames * options.cyclesPerFrame;
+        }
+        else
+        {
+            // Run in large slices so engines that execute whole blocks aren't cut at every instruction.
+            for (unsigned long long cycle = 0; cycle < options.cycles; cycle += c_cyclesPerSlice)
+                chip8.emulateCycles(static_cast<unsigned int>(std::min<unsigned long long>(c_cyclesPerSlice, options.cycles - cycle)));
+
+            result.cycles = options.cycles;
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+        if (frameStream.isOpen())
+            closeFrameStream(frameStream);
+
+        result.cyclesPerSecond = (elapsed.count() > 0.0) ? result.cycles / elapsed.count() : 0.0;
+        result.displayHash     = chip8.getDisplayHash();
+        result.V               = chip8.getRegisters();
+        result.I               = chip8.getI();
+        result.PC              = chip8.getPC();
+        result.trapped         = chip8.hasTrapped();
+        result.skippedCycles   = chip8.getSkippedCycles();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Runs instances [first, last) of results, all of the same ROM, as the lanes of one lockstep batch.
+    // Keys and cycles are the same as runInstance() gives each of them, and so are the results.
+    void runLockstep(const Options& options, const RomImage& rom, std::vector<InstanceResult>& results, std::size_t first, std::size_t last)
+    {
+        Chip8::QuirkProfile quirkProfile = options.quirkProfile;
+
+        if (!options.quirkProfileGiven)
+            Chip8::parseQuirkProfile(rom.quirkProfile, quirkProfile);
+
+        auto batch = std::make_unique<LockstepBatch>(quirkProfile);
+        std::vector<std::mt19937> keyGenerators;
+        std::vector<std::unique_ptr<FrameStreamWriter>> frameStreams;
+
+        for (std::size_t instance = first; instance < last; ++instance)
+        {
+            Chip8 chip8(results[instance].seed);
+            chip8.initialize();
+            chip8.setQuirkProfile(quirkProfile);
+
+            results[instance].loaded = chip8.loadGame(rom.data);
+
+            if (!results[instance].loaded)
+                return;
+
+            batch->loadLane(static_cast<unsigned int>(instance - first), chip8.getState());
+            keyGenerators.emplace_back(results[instance].seed ^ 0x9E3779B9u);
+
+            if (!options.framesDirectory.empty())
+            {
+                frameStreams.push_back(std::make_unique<FrameStreamWriter>(FrameStreamWriter::Overflow::Wait));
+                openFrameStream(options, rom, results[instance].seed, *frameStreams.back());
+            }
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+        unsigned long long cycles = 0;
+
+        if (options.frames > 0)
+        {
+            for (unsigned long long frame = 0; frame < options.frames; ++frame)
+            {
+                if (options.randomKeys)
+                {
+                    for (unsigned int lane = 0; lane < keyGenerators.size(); ++lane)
+                        batch->setKeys(lane, static_cast<twoByte>(keyGenerators[lane]()));
+                }
+
+                batch->emulateCycles(options.cyclesPerFrame);
+
+                batch->updateTimers();
+
+                if (!frameStreams.empty() && batch->getDrawFlags() != 0)
+                {
+                    Chip8::DisplayRows rows;
+
+                    for (unsigned int lane = 0; lane < frameStreams.size(); ++lane)
+                    {
+                        if (frameStreams[lane]->isOpen() && ((batch->getDrawFlags() >> lane) & 1) != 0)
+                        {
+                            batch->getDisplayRows(lane, rows);
+                            frameStreams[lane]->submit(static_cast<std::uint32_t>(frame), rows);
+                            batch->clearDrawFlags(LockstepBatch::LaneMask(1) << lane);
+                        }
+                    }
+                }
+            }
+
+            cycles = options.frames * options.cyclesPerFrame;
+        }
+        else
+        {
+            for (unsigned long long cycle = 0; cycle < options.cycles; cycle += c_cyclesPerSlice)
+                batch->emulateCycles(static_cast<unsigned int>(std::min<unsigned long long>(c_cyclesPerSlice, options.cycles - cycle)));
+
+            cycles = options.cycles;
+        }
+
+        // Every lane ran its cycles in the time of the whole batch.
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+        for (const auto& frameStream : frameStreams)
+        {
+            if (frameStream->isOpen())
+                closeFrameStream(*frameStream);
+        }
+
+        for (std::size_t instance = first; instance < last; ++instance)
+        {
+            const unsigned int lane = static_cast<unsigned int>(instance - first);
+
+            Chip8State state;
+            batch->saveLane(lane, state);
+
+            Chip8 chip8(results[instance].seed);
+            chip8.loadState(state);
+
+            InstanceResult& result = results[instance];
+            result.cycles          = cycles;
+            result.cyclesPerSecond = (elapsed.count() > 0.0) ? cycles / elapsed.count() : 0.0;
+            result.displayHash     = chip8.getDisplayHash();
+            result.V               = chip8.getRegisters();
+            result.I               = chip8.getI();
+            result.PC              = chip8.getPC();
+            result.trapped         = ((batch->getTrappedLanes() >> lane) & 1) != 0;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void writeResults(std::ostream& output, const Options& options, const std::vector<InstanceResult>& results)
+    {
+        output << "rom,seed,loaded,cycles,cycles_per_sec,display_hash,pc,i";
+
+        for (unsigned int reg = 0; reg < Chip8::c_numRegisters; ++reg)
+            output << ",v" << std::hex << std::uppercase << reg << std::dec;
+
+        output << ",trapped\n";
+
+        for (const InstanceResult& result : results)
+        {
+            output << options.romPaths[result.romIndex] << ',' << result.seed << ',' << result.loaded << ','
+                   << result.cycles << ',' << std::fixed << std::setprecision(0) << result.cyclesPerSecond << ','
+                   << std::hex << std::setfill('0') << std::setw(16) << result.displayHash << ','
+                   << std::setw(3) << result.PC << ',' << std::setw(3) << result.I;
+
+            for (const byte value : result.V)
+                output << ',' << std::setw(2) << static_cast<unsigned int>(value);
+
+            output << std::dec << std::setfill(' ') << ',' << result.trapped << '\n';
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: BatchRunner [--rom-list <file>] [--library <dir>] [--seeds <first>:<last>] [--cycles <n> | --frames <n> [--frame-cycles <n>]] [--no-idle-skip] [--random-keys] "
+                     "[--threads <n>] [--dispatch map|table|blocks] [--lockstep] [--quirks <profile>] [--output <file>] [--frames-out <dir>] [--profile <prefix>] [<rom> ...] \n";
+        return 1;
+    }
+
+    // Every ROM is read once and shared read-only by all its instances.
+    std::vector<std::shared_ptr<const RomImage>> roms;
+
+    for (const std::string& romPath : options.romPaths)
+    {
+        auto image = std::make_shared<RomImage>();
+        std::string error;
+
+        if (!loadRomImage(romPath, *image, error))
+        {
+            std::cout << "Failed to load " << error << "\n";
+            return 1;
+        }
+
+        roms.push_back(image);
+    }
+
+    if (!options.libraryPath.empty())
+    {
+        RomLibrary library;
+        std::string error;
+
+        if (!library.open(options.libraryPath, error))
+        {
+            std::cout << "Failed to open library " << error << "\n";
+            return 1;
+        }
+
+        for (const auto& image : library.getRoms())
+        {
+            Chip8::QuirkProfile quirkProfile;
+
+            if (!options.quirkProfileGiven && !Chip8::parseQuirkProfile(image->quirkProfile, quirkProfile))
+            {
+                std::cout << "Unknown quirk profile \"" << image->quirkProfile << "\" for " << image->name << " in " << RomLibrary::c_indexFileName << "\n";
+                return 1;
+            }
+
+            options.romPaths.push_back((std::filesystem::path(options.libraryPath) / image->name).string());
+            roms.push_back(image);
+        }
+    }
+
+    const unsigned long long numSeeds = static_cast<unsigned long long>(options.lastSeed) - options.firstSeed + 1;
+    std::vector<InstanceResult> results(roms.size() * numSeeds);
+
+    for (std::size_t instance = 0; instance < results.size(); ++instance)
+    {
+        results[instance].romIndex = instance / numSeeds;
+        results[instance].seed     = options.firstSeed + static_cast<unsigned int>(instance % numSeeds);
+    }
+
+    // Instances profile into a profiler of their task, merged into the one of their ROM when they end.
+    std::vector<Profiler> romProfilers(options.profilePrefix.empty() ? 0 : roms.size());
+    std::mutex romProfilersMutex;
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    {
+        WorkStealingThreadPool threadPool(options.threads);
+
+        // Submit small chunks of instances so the per task overhead stays low and stealing can still balance ROMs of uneven cost.
+        constexpr std::size_t c_instancesPerTask = 16;
+
+        for (std::size_t first = 0; options.lockstep && first < results.size(); )
+        {
+            // One batch per task, never across two ROMs.
+            const std::size_t romEnd = (results[first].romIndex + 1) * numSeeds;
+            const std::size_t last   = std::min<std::size_t>(first + LockstepBatch::c_maxLanes, romEnd);
+
+            threadPool.submit([&options, &roms, &results, first, last]()
+            {
+                runLockstep(options, *roms[results[first].romIndex], results, first, last);
+            });
+
+            first = last;
+        }
+
+        for (std::size_t first = 0; !options.lockstep && first < results.size(); first += c_instancesPerTask)
+        {
+            const std::size_t last = std::min(first + c_instancesPerTask, results.size());
+
+            threadPool.submit([&options, &roms, &results, &romProfilers, &romProfilersMutex, first, last]()
+            {
+                std::unique_ptr<Profiler> profiler = romProfilers.empty() ? nullptr : std::make_unique<Profiler>();
+
+                for (std::size_t instance = first; instance < last; ++instance)
+                {
+                    runInstance(options, *roms[results[instance].romIndex], results[instance], profiler.get());
+
+                    if (profiler)
+                    {
+                        std::lock_guard<std::mutex> lock(romProfilersMutex);
+                        romProfilers[results[instance].romIndex].merge(*profiler);
+                        profiler->clear();
+                    }
+                }
+            });
+        }
+
+        threadPool.wait();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    unsigned long long totalCycles = 0;
+    std::uint64_t skippedCycles    = 0;
+
+    for (const InstanceResult& result : results)
+    {
+        totalCycles   += result.cycles;
+        skippedCycles += result.skippedCycles;
+    }
+
+    if (options.outputPath.empty())
+    {
+        writeResults(std::cout, options, results);
+    }
+    else
+    {
+        std::ofstream outputFile(options.outputPath);
+        writeResults(outputFile, options, results);
+    }
+
+    if (!romProfilers.empty())
+    {
+        std::ofstream foldedFile(options.profilePrefix + ".folded");
+
+        for (std::size_t romIndex = 0; romIndex < roms.size(); ++romIndex)
+        {
+            romProfilers[romIndex].writeFoldedStacks(foldedFile, roms[romIndex]->name);
+
+            std::ofstream csvFile(options.profilePrefix + "_" + roms[romIndex]->name + ".csv");
+            romProfilers[romIndex].writeCsv(csvFile);
+        }
+    }
+
+    std::cerr << results.size() << " instances, " << totalCycles << " cycles in " << elapsed.count() << " s ("
+              << (elapsed.count() > 0.0 ? totalCycles / elapsed.count() : 0.0) << " cycles/sec, "
+              << (totalCycles > 0 ? 100.0 * skippedCycles / totalCycles : 0.0) << "% skipped idle)\n";
+
+    return 0;
+}
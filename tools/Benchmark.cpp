@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/Chip8.h"
+#include "../src/Profiler.h"
+#include "../src/RomLibrary.h"
+#include "ToolOptions.h"
+
+// Emulator speed benchmark: runs every ROM of a directory unthrottled, with scripted key input,
+// on each dispatch engine and reports instructions/sec, ns/instruction, per opcode class timing
+// and the cost of Chip8::fetchOpcode and Chip8::draw.
+//
+// Usage: Benchmark [options]
+//   --roms <dir>             ROM directory (default: data/roms).
+//   --frames <n>             Frames of 10 cycles run per ROM and engine (default: 20000).
+//   --repeat <n>             Runs per measurement, at least 1, the fastest one is kept (default: 3).
+//   --engines <list>         Comma separated engines: map, table, blocks (default: all of them).
+//   --output <file>          Write the results as CSV.
+//   --baseline <file>        Compare against a previous --output, fail when a ROM, fetchOpcode or draw
+//   --threshold <percent>    gets slower (ns/op) than the baseline by more than the threshold (default: 10).
+//
+// Exit code: 0 on success, 1 on usage or I/O errors, 2 when a regression is detected.
+
+namespace
+{
+    constexpr unsigned int c_cyclesPerFrame = 10;
+    constexpr unsigned int c_opCodeChunkLength = 64;      // Instructions run between two state reloads.
+    constexpr unsigned int c_opCodeChunks      = 1024;    // Chunks per opcode class, ROM and run.
+
+    struct Options
+    {
+        std::string romDirectory = "data/roms";
+        unsigned long long frames = 20000;
+        unsigned int repeat       = 3;
+        std::vector<Chip8::DispatchMode> engines = { Chip8::DispatchMode::OpCodeMap, Chip8::DispatchMode::JumpTable, Chip8::DispatchMode::CachedBlocks };
+        std::string outputPath;
+        std::string baselinePath;
+        double threshold = 10.0;
+    };
+
+    struct Result
+    {
+        std::string benchmark;      // "rom:<name>", "opcode:<class>", "fetchOpcode" or "draw".
+        std::string engine;
+        unsigned long long count = 0;
+        double totalNs = 0.0;
+
+        double nsPerOp()   const { return (count > 0) ? totalNs / count : 0.0; }
+        double opsPerSec() const { return (totalNs > 0.0) ? count * 1e9 / totalNs : 0.0; }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    /////////////////////////////////////////////////////////////////////////
+
+    double elapsedNs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Scripted input: every 32 frames the next key of the keypad is held for 8 frames, so ROMs waiting on keys make progress.
+    twoByte scriptKeys(unsigned long long frame)
+    {
+        return (frame % 32 < 8) ? static_cast<twoByte>(1u << ((frame / 32) % Chip8::c_numKeys)) : 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void startMachine(Chip8& chip8, Chip8::DispatchMode engine, const std::vector<byte>& rom)
+    {
+        chip8.initialize();
+        chip8.setDispatchMode(engine);
+        chip8.setIdleSkipping(false);   // Measures the engines, spin loops included.
+        chip8.loadGame(rom);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    Result benchmarkRom(const Options& options, const std::string& romName, const std::vector<byte>& rom, Chip8::DispatchMode engine)
+    {
+        Result result;
+        result.benchmark = "rom:" + romName;
+        result.engine    = engineName(engine);
+
+        bool playSound = false;
+
+        for (unsigned int run = 0; run < options.repeat; ++run)
+        {
+            Chip8 chip8(0);
+            startMachine(chip8, engine, rom);
+
+            const Clock::time_point start = Clock::now();
+
+            for (unsigned long long frame = 0; frame < options.frames; ++frame)
+            {
+                chip8.setKeys(scriptKeys(frame));
+                chip8.emulateCycles(c_cyclesPerFrame);
+                chip8.updateTimers(playSound);
+            }
+
+            const double totalNs = elapsedNs(start, Clock::now());
+
+            if (run == 0 || totalNs < result.totalNs)
+                result.totalNs = totalNs;
+        }
+
+        result.count = options.frames * c_cyclesPerFrame;
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Times each opcode class in a tight loop: the first instruction of the class the ROM runs is executed
+    // again and again from the machine state it was met in, and the time is divided by the count. The state is
+    // reloaded every c_opCodeChunkLength instructions to keep the operands sane, the reload is timed on its own
+    // and subtracted. Only meaningful for engines that execute one instruction per dispatch.
+    void benchmarkOpCodeClasses(const Options& options, const std::vector<byte>& rom, Chip8::DispatchMode engine, std::map<std::string, Result>& classes)
+    {
+        std::map<std::string, Chip8State> samples;
+
+        {
+            Chip8 chip8(0);
+            startMachine(chip8, engine, rom);
+
+            bool playSound = false;
+
+            for (unsigned long long frame = 0; frame < options.frames; ++frame)
+            {
+                chip8.setKeys(scriptKeys(frame));
+
+                for (unsigned int cycle = 0; cycle < c_cyclesPerFrame; ++cycle)
+                {
+                    chip8.fetchOpcode();
+
+                    const std::string name = Profiler::getOpCodeClassName(chip8.getOpCode());
+
+                    if (samples.find(name) == samples.end())
+                        samples.emplace(name, chip8.getState());
+
+                    chip8.decodeAndExecuteOpcode();
+                }
+
+                chip8.updateTimers(playSound);
+            }
+        }
+
+        // FX55 and FX65 move I by up to 16 bytes each time, the whole chunk has to stay inside memory.
+        constexpr unsigned int c_maxI = Chip8::c_memorySize - (c_opCodeChunkLength + 1) * Chip8::c_numRegisters;
+
+        for (auto& sample : samples)
+        {
+            Chip8State& state = sample.second;
+            state.I = static_cast<twoByte>(std::min<unsigned int>(state.I, c_maxI));
+
+            Chip8 chip8(0);
+            startMachine(chip8, engine, rom);
+
+            double bestNs = 0.0;
+
+            for (unsigned int run = 0; run < options.repeat; ++run)
+            {
+                Clock::time_point start = Clock::now();
+
+                for (unsigned int chunk = 0; chunk < c_opCodeChunks; ++chunk)
+                {
+                    chip8.loadState(state);
+                    chip8.fetchOpcode();
+                }
+
+                const double reloadNs = elapsedNs(start, Clock::now());
+
+                start = Clock::now();
+
+                for (unsigned int chunk = 0; chunk < c_opCodeChunks; ++chunk)
+                {
+                    chip8.loadState(state);
+                    chip8.fetchOpcode();
+
+                    // The operands stay decoded, every call runs the same instruction whatever PC does.
+                    for (unsigned int i = 0; i < c_opCodeChunkLength; ++i)
+                        chip8.decodeAndExecuteOpcode();
+                }
+
+                const double totalNs = std::max(elapsedNs(start, Clock::now()) - reloadNs, 0.0);
+
+                if (run == 0 || totalNs < bestNs)
+                    bestNs = totalNs;
+            }
+
+            Result& result = classes[sample.first];
+            result.totalNs += bestNs;
+            result.count   += static_cast<unsigned long long>(c_opCodeChunks) * c_opCodeChunkLength;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // fetchOpcode and draw in isolation: a one instruction program, the call repeated in a tight loop.
+    Result benchmarkCall(const std::string& name, const Options& options, twoByte opCode, void (Chip8::*call)())
+    {
+        constexpr unsigned long long c_calls = 1000000;
+
+        const std::vector<byte> program = { static_cast<byte>(opCode >> 8), static_cast<byte>(opCode & 0xFF) };
+
+        Result result;
+        result.benchmark = name;
+        result.engine    = "-";
+        result.count     = c_calls;
+
+        for (unsigned int run = 0; run < options.repeat; ++run)
+        {
+            Chip8 chip8(0);
+            startMachine(chip8, Chip8::DispatchMode::JumpTable, program);
+            chip8.fetchOpcode();
+
+            const Clock::time_point start = Clock::now();
+
+            for (unsigned long long i = 0; i < c_calls; ++i)
+                (chip8.*call)();
+
+            const double totalNs = elapsedNs(start, Clock::now());
+
+            if (run == 0 || totalNs < result.totalNs)
+                result.totalNs = totalNs;
+        }
+
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void writeCsv(std::ostream& output, const std::vector<Result>& results)
+    {
+        output << "benchmark,engine,count,total_ns,ns_per_op,ops_per_sec\n";
+
+        for (const Result& result : results)
+        {
+            output << result.benchmark << ',' << result.engine << ',' << result.count << ',' << std::fixed << std::setprecision(0)
+                   << result.totalNs << ',' << std::setprecision(3) << result.nsPerOp() << ',' << std::setprecision(0) << result.opsPerSec() << '\n';
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool readCsv(const std::string& path, std::map<std::string, double>& nsPerOp, std::string& error)
+    {
+        std::ifstream input(path);
+
+        if (input.fail())
+        {
+            error = "can't open " + path;
+            return false;
+        }
+
+        std::string line;
+        std::getline(input, line);   // Header
+
+        for (unsigned int lineNumber = 2; std::getline(input, line); ++lineNumber)
+        {
+            if (line.empty())
+                continue;
+
+            std::istringstream fields(line);
+            std::string benchmark, engine, count, totalNs, nsPerOpField;
+
+            std::getline(fields, benchmark, ',');
+            std::getline(fields, engine, ',');
+            std::getline(fields, count, ',');
+            std::getline(fields, totalNs, ',');
+            std::getline(fields, nsPerOpField, ',');
+
+            double value = 0.0;
+
+            if (!parseNumber(nsPerOpField, value))
+            {
+                error = path + " line " + std::to_string(lineNumber) + " has no valid ns/op value";
+                return false;
+            }
+
+            nsPerOp[benchmark + "/" + engine] = value;
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+
+            if (i + 1 >= argc)
+                return false;
+
+            const std::string value(argv[++i]);
+            bool valid = true;
+
+            if (argument == "--roms")
+                options.romDirectory = value;
+            else if (argument == "--frames")
+                valid = parseNumber(value, options.frames);
+            else if (argument == "--repeat")
+                valid = parseNumber(value, options.repeat) && options.repeat > 0;
+            else if (argument == "--output")
+                options.outputPath = value;
+            else if (argument == "--baseline")
+                options.baselinePath = value;
+            else if (argument == "--threshold")
+                valid = parseNumber(value, options.threshold) && options.threshold >= 0.0;
+            else if (argument == "--engines")
+            {
+                std::istringstream names(value);
+                std::string name;
+
+                options.engines.clear();
+
+                while (std::getline(names, name, ','))
+                {
+                    Chip8::DispatchMode engine;
+
+                    if (!Chip8::parseDispatchMode(name, engine))
+                        return false;
+
+                    options.engines.push_back(engine);
+                }
+            }
+            else
+                valid = false;
+
+            if (!valid)
+                return false;
+        }
+
+        return !options.engines.empty();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: Benchmark [--roms <dir>] [--frames <n>] [--repeat <n>] [--engines map,table,blocks] "
+                     "[--output <file>] [--baseline <file>] [--threshold <percent>] \n";
+        return 1;
+    }
+
+    RomLibrary library;
+    std::string error;
+
+    if (!library.open(options.romDirectory, error, false) || library.getRoms().empty())
+    {
+        std::cout << "No ROMs found in " << options.romDirectory << (error.empty() ? "" : ": " + error) << "\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    std::map<std::string, std::map<std::string, Result>> opCodeClasses;     // engine -> class -> timing
+
+    for (const auto& image : library.getRoms())
+    {
+        const std::vector<byte>& rom = image->data;
+
+        for (const Chip8::DispatchMode engine : options.engines)
+        {
+            results.push_back(benchmarkRom(options, image->name, rom, engine));
+
+            if (engine != Chip8::DispatchMode::CachedBlocks)
+                benchmarkOpCodeClasses(options, rom, engine, opCodeClasses[engineName(engine)]);
+        }
+    }
+
+    for (auto& engineClasses : opCodeClasses)
+    {
+        for (auto& opCodeClass : engineClasses.second)
+        {
+            opCodeClass.second.benchmark = "opcode:" + opCodeClass.first;
+            opCodeClass.second.engine    = engineClasses.first;
+            results.push_back(opCodeClass.second);
+        }
+    }
+
+    results.push_back(benchmarkCall("fetchOpcode", options, 0x6000, &Chip8::fetchOpcode));
+    results.push_back(benchmarkCall("draw",        options, 0xD00F, &Chip8::draw));
+
+    // Human readable summary
+    std::cout << std::left << std::setw(24) << "benchmark" << std::setw(8) << "engine" << std::right
+              << std::setw(16) << "ops/sec" << std::setw(12) << "ns/op" << "\n";
+
+    for (const Result& result : results)
+    {
+        std::cout << std::left << std::setw(24) << result.benchmark << std::setw(8) << result.engine << std::right << std::fixed
+                  << std::setw(16) << std::setprecision(0) << result.opsPerSec() << std::setw(12) << std::setprecision(2) << result.nsPerOp() << "\n";
+    }
+
+    if (!options.outputPath.empty())
+    {
+        std::ofstream outputFile(options.outputPath);
+        writeCsv(outputFile, results);
+    }
+
+    if (options.baselinePath.empty())
+        return 0;
+
+    std::map<std::string, double> baseline;
+
+    if (!readCsv(options.baselinePath, baseline, error))
+    {
+        std::cout << "Failed to read baseline " << error << "\n";
+        return 1;
+    }
+
+    // Per opcode class timings are too noisy to gate on, only whole ROM runs and the isolated calls are compared.
+    bool regression = false;
+
+    for (const Result& result : results)
+    {
+        if (result.benchmark.compare(0, 7, "opcode:") == 0)
+            continue;
+
+        const auto it = baseline.find(result.benchmark + "/" + result.engine);
+
+        if (it == baseline.end() || it->second <= 0.0)
+            continue;
+
+        const double change = (result.nsPerOp() - it->second) * 100.0 / it->second;
+
+        if (change > options.threshold)
+        {
+            std::cout << "REGRESSION " << result.benchmark << " [" << result.engine << "]: " << std::setprecision(2)
+                      << it->second << " -> " << result.nsPerOp() << " ns/op (+" << change << "%)\n";
+            regression = true;
+        }
+    }
+
+    return regression ? 2 : 0;
+}
@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "../src/Chip8.h"
+#include "../src/RomLibrary.h"
+#include "ToolOptions.h"
+
+#ifndef CHIP8_DEBUGGER
+#error "DebugConsole needs every file built with CHIP8_DEBUGGER defined"
+#endif
+
+// Command line debugger: runs a game headless with a Debugger attached and takes commands on standard
+// input, one per line, so it can be driven interactively or from a script or socket (socat, nc -e).
+// Emulated time advances only while running: a frame is --frame-cycles instructions then a timer update.
+//
+// Usage: DebugConsole [options] <game>
+//   --quirks <profile>       chip8, vip, schip or xochip (default: the ROM library index, or chip8).
+//   --dispatch <engine>      map, table or blocks (default: table).
+//   --seed <n>               RNG seed (default: 0).
+//   --frame-cycles <n>       Instructions per 60 Hz frame (default: 10).
+//
+// Addresses and key masks are hexadecimal, counts decimal. Type "h" for the commands.
+
+namespace
+{
+    const char* const c_help =
+        "b <addr>                   set a breakpoint         bd <addr>          delete it\n"
+        "w <addr> [len] [r|w|rw]    watch memory (rw)        wd <addr> [len]    delete the watch\n"
+        "u on|off                   stop on unknown opcodes\n"
+        "s [n]                      step n instructions      n                  step over a call\n"
+        "c [frames]                 continue (at most 600 frames by default)\n"
+        "k <mask>                   hold keys (bit k for key k)\n"
+        "r                          registers and stack      m <addr> [len]     memory\n"
+        "l [addr] [n]               disassemble              p                  screen\n"
+        "q                          quit\n";
+
+    constexpr unsigned int c_defaultRunFrames = 600;
+
+    struct Session
+    {
+        Chip8    chip8;
+        Debugger debugger;
+
+        unsigned int  frameCycles = 10;
+        unsigned int  cyclesLeft  = 10;     // Instructions still to run in the current frame.
+        std::uint64_t frame       = 0;
+
+        explicit Session(unsigned int seed) : chip8(seed) {}
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+
+    std::string hex(unsigned int value, int width)
+    {
+        std::ostringstream text;
+        text << std::hex << std::uppercase << std::setw(width) << std::setfill('0') << value;
+        return text.str();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    twoByte readOpCode(const Chip8State& state, unsigned int address)
+    {
+        return static_cast<twoByte>(state.memory[address & 0xFFF] << 8 | state.memory[(address + 1) & 0xFFF]);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // As the session's quirk profile runs it: BNNN jumps with VX under some.
+    std::string disassemble(const Session& session, twoByte opCode)
+    {
+        return Debugger::disassemble(opCode, Chip8::getQuirks(session.chip8.getQuirkProfile()).jumpUsesVX);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printLocation(const Session& session)
+    {
+        const Chip8State& state = session.chip8.getState();
+        const twoByte opCode = readOpCode(state, state.PC);
+
+        std::cout << "  " << hex(state.PC, 3) << ": " << hex(opCode, 4) << "  " << disassemble(session, opCode) << "\n";
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printStop(const Session& session)
+    {
+        const Debugger::Stop& stop = session.debugger.getStop();
+
+        std::cout << Debugger::getStopReasonName(stop.reason) << " at frame " << session.frame;
+
+        if (stop.reason == Debugger::StopReason::ReadWatch || stop.reason == Debugger::StopReason::WriteWatch)
+            std::cout << ", address " << hex(stop.address, 3);
+
+        std::cout << "\n";
+        printLocation(session);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Runs whole frames until the debugger stops or maxFrames frames ended, then pauses.
+    void run(Session& session, unsigned int maxFrames)
+    {
+        unsigned int frames = 0;
+
+        while (!session.debugger.isStopped() && frames < maxFrames)
+        {
+            const std::uint64_t executedBefore = session.debugger.getExecutedInstructions();
+
+            session.chip8.emulateCycles(session.cyclesLeft);
+            session.cyclesLeft -= static_cast<unsigned int>(session.debugger.getExecutedInstructions() - executedBefore);
+
+            if (session.cyclesLeft == 0)
+            {
+                bool playSound = false;
+                session.chip8.updateTimers(playSound);
+                session.chip8.setDrawFlagFalse();
+
+                session.cyclesLeft = session.frameCycles;
+                ++session.frame;
+                ++frames;
+            }
+        }
+
+        session.debugger.pause();
+        printStop(session);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printRegisters(const Session& session)
+    {
+        const Chip8State& state = session.chip8.getState();
+
+        std::cout << "PC " << hex(state.PC, 3) << "  I " << hex(state.I, 3) << "  SP " << static_cast<unsigned int>(state.SP)
+                  << "  DT " << static_cast<unsigned int>(state.delayTimer) << "  ST " << static_cast<unsigned int>(state.soundTimer)
+                  << "  keys " << hex(state.keys, 4) << "\n";
+
+        for (unsigned int r = 0; r < Chip8State::c_numRegisters; ++r)
+            std::cout << "V" << hex(r, 1) << " " << hex(state.V[r], 2) << ((r % 8 == 7) ? "\n" : "  ");
+
+        for (unsigned int level = state.SP; level > 0; --level)
+            std::cout << "  #" << (state.SP - level) << " return to " << hex(state.stack[(level - 1) & (Chip8State::c_stackLevels - 1)] + 2, 3) << "\n";
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printMemory(const Session& session, unsigned int address, unsigned int length)
+    {
+        const Chip8State& state = session.chip8.getState();
+
+        for (unsigned int offset = 0; offset < length; offset += 16)
+        {
+            std::cout << hex((address + offset) & 0xFFF, 3) << ":";
+
+            for (unsigned int i = offset; i < std::min(offset + 16, length); ++i)
+                std::cout << " " << hex(state.memory[(address + i) & 0xFFF], 2);
+
+            std::cout << "\n";
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printScreen(const Session& session)
+    {
+        for (const std::uint64_t row : session.chip8.getDisplayRows())
+        {
+            for (unsigned int x = 0; x < Chip8State::c_displayWidth; ++x)
+                std::cout << (((row >> (Chip8State::c_displayWidth - 1 - x)) & 1) ? '#' : '.');
+
+            std::cout << "\n";
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseValue(std::string text, int base, unsigned int& value)
+    {
+        // Hexadecimal values may have a 0x prefix.
+        if (base == 16 && text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+            text.erase(0, 2);
+
+        return parseNumber(text, value, base);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseNumber(std::istringstream& arguments, int base, unsigned int& value)
+    {
+        std::string text;
+        return (arguments >> text) && parseValue(text, base, value);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Returns false on quit.
+    bool executeCommand(Session& session, const std::string& line)
+    {
+        std::istringstream arguments(line);
+        std::string command;
+
+        if (!(arguments >> command))
+            return true;
+
+        Debugger& debugger = session.debugger;
+        const Chip8State& state = session.chip8.getState();
+
+        unsigned int address = 0;
+        unsigned int count   = 0;
+
+        if (command == "q")
+            return false;
+
+        if (command == "h")
+            std::cout << c_help;
+        else if ((command == "b" || command == "bd") && parseNumber(arguments, 16, address))
+            debugger.setBreakpoint(static_cast<twoByte>(address), command == "b");
+        else if ((command == "w" || command == "wd") && parseNumber(arguments, 16, address))
+        {
+            unsigned int length = 1;
+            Debugger::Access access = Debugger::ReadWrite;
+            std::string argument;
+
+            while (arguments >> argument)
+            {
+                if (argument == "r" || argument == "w")
+                    access = (argument == "r") ? Debugger::Read : Debugger::Write;
+                else if (argument != "rw" && !parseValue(argument, 10, length))
+                    length = 0;
+            }
+
+            debugger.setWatchpoint(static_cast<twoByte>(address), length, (command == "w") ? access : Debugger::ReadWrite, command == "w");
+        }
+        else if (command == "u")
+        {
+            std::string value;
+            arguments >> value;
+            debugger.setStopOnUnknownOpCode(value != "off");
+        }
+        else if (command == "s")
+        {
+            debugger.step(parseNumber(arguments, 10, count) ? count : 1);
+            run(session, c_defaultRunFrames);
+        }
+        else if (command == "n")
+        {
+            debugger.stepOver(state.PC, readOpCode(state, state.PC), state.SP);
+            run(session, c_defaultRunFrames);
+        }
+        else if (command == "c")
+        {
+            debugger.resume();
+            run(session, parseNumber(arguments, 10, count) ? count : c_defaultRunFrames);
+        }
+        else if (command == "k" && parseNumber(arguments, 16, count))
+            session.chip8.setKeys(static_cast<twoByte>(count));
+        else if (command == "r")
+            printRegisters(session);
+        else if (command == "m" && parseNumber(arguments, 16, address))
+            printMemory(session, address, parseNumber(arguments, 10, count) ? count : 64);
+        else if (command == "l")
+        {
+            if (!parseNumber(arguments, 16, address))
+                address = state.PC;
+
+            if (!parseNumber(arguments, 10, count))
+                count = 10;
+
+            for (unsigned int i = 0; i < count; ++i, address += 2)
+            {
+                const twoByte opCode = readOpCode(state, address);
+
+                std::cout << ((address == state.PC) ? "> " : "  ") << (debugger.hasBreakpoint(static_cast<twoByte>(address)) ? '*' : ' ')
+                          << hex(address & 0xFFF, 3) << ": " << hex(opCode, 4) << "  " << disassemble(session, opCode) << "\n";
+            }
+        }
+        else if (command == "p")
+            printScreen(session);
+        else
+            std::cout << "Unknown command, h for help.\n";
+
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    std::string gamePath;
+    Chip8::DispatchMode dispatchMode = Chip8::DispatchMode::JumpTable;
+    Chip8::QuirkProfile quirkProfile = Chip8::QuirkProfile::Chip8;
+    bool quirkProfileGiven = false;
+    unsigned int seed = 0;
+    unsigned int frameCycles = 10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+
+        bool valid = true;
+
+        if (argument == "--quirks" && hasValue)
+            valid = quirkProfileGiven = Chip8::parseQuirkProfile(argv[++i], quirkProfile);
+        else if (argument == "--dispatch" && hasValue)
+            valid = Chip8::parseDispatchMode(argv[++i], dispatchMode);
+        else if (argument == "--seed" && hasValue)
+            valid = parseValue(argv[++i], 10, seed);
+        else if (argument == "--frame-cycles" && hasValue)
+            valid = parseValue(argv[++i], 10, frameCycles) && frameCycles > 0;
+        else if (argument.compare(0, 2, "--") == 0 || !gamePath.empty())
+            valid = false;
+        else
+            gamePath = argument;
+
+        if (!valid)
+        {
+            std::cout << "Usage: DebugConsole [--quirks chip8|vip|schip|xochip] [--dispatch map|table|blocks] [--seed <n>] [--frame-cycles <n>] <game>\n";
+            return 1;
+        }
+    }
+
+    if (gamePath.empty())
+    {
+        std::cout << "Usage: DebugConsole [--quirks chip8|vip|schip|xochip] [--dispatch map|table|blocks] [--seed <n>] [--frame-cycles <n>] <game>\n";
+        return 1;
+    }
+
+    RomImage game;
+    std::string error;
+
+    Session session(seed);
+    session.chip8.initialize();
+
+    if (!loadRomImage(gamePath, game, error) || !session.chip8.loadGame(game.data))
+    {
+        std::cout << "Failed to load game (" << error << ").\n";
+        return 1;
+    }
+
+    // Unless given, the quirk profile is the one the ROM library index of the game's directory has for its hash.
+    if (!quirkProfileGiven)
+    {
+        RomLibrary library;
+        const std::string gameDirectory = std::filesystem::path(gamePath).parent_path().string();
+
+        if (library.open(gameDirectory.empty() ? "." : gameDirectory, error, false))
+        {
+            const auto indexedGame = library.findByHash(game.hash);
+
+            if (indexedGame && !Chip8::parseQuirkProfile(indexedGame->quirkProfile, quirkProfile))
+            {
+                std::cout << "Unknown quirk profile \"" << indexedGame->quirkProfile << "\" for " << indexedGame->name << " in " << RomLibrary::c_indexFileName << ".\n";
+                return 1;
+            }
+        }
+    }
+
+    session.chip8.setQuirkProfile(quirkProfile);
+    session.chip8.setDispatchMode(dispatchMode);
+    session.chip8.setDebugger(&session.debugger);
+    session.frameCycles = frameCycles;
+    session.cyclesLeft  = frameCycles;
+
+    session.debugger.pause();
+    printLocation(session);
+
+    std::string line;
+
+    while (std::cout << "(c8db) " << std::flush && std::getline(std::cin, line))
+    {
+        if (!executeCommand(session, line))
+            break;
+    }
+
+    return 0;
+}
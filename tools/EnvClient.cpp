@@ -0,0 +1,321 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../src/Chip8.h"
+#include "../src/EnvironmentProtocol.h"
+#include "../src/RomLibrary.h"
+#include "../src/SharedMemory.h"
+#include "ToolOptions.h"
+
+// Reference client of EnvServer, and its throughput benchmark: steps every instance with random keys,
+// resets a few instances per step and saves and restores snapshots, the way a training loop would.
+// With --verify it mirrors some instances with local Chip8s and checks every observation against them.
+//
+// Usage: EnvClient [options]
+//   --socket <path>            Server socket (default: /tmp/chip8_env.sock).
+//   --shared-memory <name>     Server shared memory (default: chip8_env).
+//   --steps <n>                Steps to run (default: 1000).
+//   --frames <n>               Frames per step (default: 4).
+//   --seed <n>                 Seed of the random keys and resets (default: 0).
+//   --verify <rom>             Mirror instances with local Chip8s (the server's ROM) and compare.
+//   --shutdown                 Stop the server when done.
+
+namespace
+{
+    constexpr unsigned int c_resetChance   = 64;       // One instance in this many resets per step.
+    constexpr unsigned int c_snapshotSteps = 50;       // Save instance 0 at step n * c_snapshotSteps, restore it 10 steps later.
+    constexpr unsigned int c_mirrors       = 4;        // Instances --verify mirrors (the first ones).
+
+    struct Options
+    {
+        std::string socketPath       = "/tmp/chip8_env.sock";
+        std::string sharedMemoryName = "chip8_env";
+        unsigned int steps  = 1000;
+        unsigned int frames = 4;
+        unsigned int seed   = 0;
+        std::string verifyRomPath;
+        bool shutdown = false;
+    };
+
+    // Local copy of a server instance.
+    struct Mirror
+    {
+        Chip8      chip8;
+        Chip8State snapshot;
+
+        explicit Mirror(unsigned int seed) : chip8(seed), snapshot(chip8.getState()) {}
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const bool hasValue = (i + 1 < argc);
+            bool valid = true;
+
+            if (argument == "--socket" && hasValue)
+                options.socketPath = argv[++i];
+            else if (argument == "--shared-memory" && hasValue)
+                options.sharedMemoryName = argv[++i];
+            else if (argument == "--steps" && hasValue)
+                valid = parseNumber(argv[++i], options.steps);
+            else if (argument == "--frames" && hasValue)
+                valid = parseNumber(argv[++i], options.frames);
+            else if (argument == "--seed" && hasValue)
+                valid = parseNumber(argv[++i], options.seed);
+            else if (argument == "--verify" && hasValue)
+                options.verifyRomPath = argv[++i];
+            else if (argument == "--shutdown")
+                options.shutdown = true;
+            else
+                valid = false;
+
+            if (!valid)
+                return false;
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    int connectToServer(const std::string& path)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+
+        if (path.size() >= sizeof(address.sun_path))
+            return -1;
+
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (connection >= 0 && connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            close(connection);
+            return -1;
+        }
+
+        return connection;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool sendRequest(int connection, Environment::Command command, unsigned int frames, Environment::Response& response)
+    {
+        const Environment::Request request = { command, frames };
+
+        if (send(connection, &request, sizeof(request), 0) != static_cast<ssize_t>(sizeof(request)))
+            return false;
+
+        return recv(connection, &response, sizeof(response), MSG_WAITALL) == static_cast<ssize_t>(sizeof(response)) && response.status == Environment::Status::Ok;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // What the server does for a step, on a local machine.
+    void stepMirror(Mirror& mirror, const Chip8State& startState, const Environment::InstanceControl& control, unsigned int frames, unsigned int cyclesPerFrame)
+    {
+        Chip8& chip8 = mirror.chip8;
+
+        if (control.flags & Environment::c_reset)
+        {
+            chip8.loadState(startState);
+            chip8.setRandomSeed(control.seed);
+        }
+
+        if (control.flags & Environment::c_restore)
+            chip8.loadState(mirror.snapshot);
+
+        chip8.setKeys(control.keys);
+
+        bool playSound = false;
+
+        for (unsigned int frame = 0; frame < frames; ++frame)
+        {
+            chip8.emulateCycles(cyclesPerFrame);
+            chip8.updateTimers(playSound);
+        }
+
+        if (control.flags & Environment::c_save)
+            chip8.saveState(mirror.snapshot);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Number of fields of the observation that differ from the mirror.
+    unsigned int compareObservation(const Environment::Observation& observation, const Chip8State& state)
+    {
+        unsigned int differences = 0;
+
+        differences += (observation.display != state.display);
+        differences += (std::memcmp(observation.V, state.V.data(), sizeof(observation.V)) != 0);
+        differences += (observation.I != state.I) + (observation.PC != state.PC) + (observation.SP != state.SP);
+        differences += (observation.delayTimer != state.delayTimer) + (observation.soundTimer != state.soundTimer);
+
+        return differences;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Local machines set up like the server's first instances.
+    bool createMirrors(const Options& options, const Environment::Header& header, std::vector<std::unique_ptr<Mirror>>& mirrors, Chip8State& startState)
+    {
+        RomImage rom;
+        std::string error;
+
+        if (!loadRomImage(options.verifyRomPath, rom, error) || rom.hash != header.romHash)
+        {
+            std::cout << "The server doesn't run " << options.verifyRomPath << "\n";
+            return false;
+        }
+
+        for (unsigned int index = 0; index < c_mirrors && index < header.numInstances; ++index)
+        {
+            auto mirror = std::make_unique<Mirror>(header.seed + index);
+            mirror->chip8.initialize();
+            mirror->chip8.setDispatchMode(static_cast<Chip8::DispatchMode>(header.dispatchMode));
+            mirror->chip8.setQuirkProfile(static_cast<Chip8::QuirkProfile>(header.quirkProfile));
+            mirror->chip8.loadGame(rom.data);
+            mirror->snapshot = mirror->chip8.getState();
+
+            mirrors.push_back(std::move(mirror));
+        }
+
+        startState = mirrors.front()->chip8.getState();
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: EnvClient [--socket <path>] [--shared-memory <name>] [--steps <n>] [--frames <n>] [--seed <n>] [--verify <rom>] [--shutdown]\n";
+        return 1;
+    }
+
+    SharedMemory sharedMemory;
+    std::string error;
+
+    if (!sharedMemory.open(options.sharedMemoryName, error))
+    {
+        std::cout << "Failed to open " << error << "\n";
+        return 2;
+    }
+
+    byte* const base = static_cast<byte*>(sharedMemory.getData());
+    const Environment::Header& header = *reinterpret_cast<const Environment::Header*>(base);
+
+    if (sharedMemory.getSize() < sizeof(Environment::Header) || header.magic != Environment::c_magic || header.version != Environment::c_version ||
+        header.observationSize != sizeof(Environment::Observation) || header.snapshotSize != sizeof(Chip8State))
+    {
+        std::cout << "The shared memory isn't a version " << Environment::c_version << " environment of this build\n";
+        return 2;
+    }
+
+    auto* const controls     = reinterpret_cast<Environment::InstanceControl*>(base + header.controlOffset);
+    auto* const observations = reinterpret_cast<const Environment::Observation*>(base + header.observationOffset);
+    const unsigned int numInstances = header.numInstances;
+
+    std::vector<std::unique_ptr<Mirror>> mirrors;
+    Chip8State startState;
+
+    if (!options.verifyRomPath.empty() && !createMirrors(options, header, mirrors, startState))
+        return 2;
+
+    const int connection = connectToServer(options.socketPath);
+
+    if (connection < 0)
+    {
+        std::cout << "Failed to connect to " << options.socketPath << "\n";
+        return 2;
+    }
+
+    std::mt19937 generator(options.seed);
+    Environment::Response response;
+    unsigned long long differences = 0;
+    std::uint64_t drawnObservations = 0;
+    std::uint64_t rewardSum = 0;
+
+    // Every instance restarts with a seed of the client's choosing, then the steps go.
+    for (unsigned int index = 0; index < numInstances; ++index)
+        controls[index] = { 0, Environment::c_reset, 0, static_cast<std::uint32_t>(generator()) };
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (unsigned int step = 0; step <= options.steps; ++step)
+    {
+        const unsigned int frames = (step == 0) ? 0 : options.frames;
+
+        for (unsigned int index = 0; index < numInstances && step > 0; ++index)
+        {
+            Environment::InstanceControl& control = controls[index];
+            control.keys  = static_cast<twoByte>(generator());
+            control.flags = (generator() % c_resetChance == 0) ? Environment::c_reset : 0;
+            control.seed  = static_cast<std::uint32_t>(generator());
+        }
+
+        if (step % c_snapshotSteps == 0)
+            controls[0].flags |= Environment::c_save;
+        else if (step % c_snapshotSteps == 10)
+            controls[0].flags |= Environment::c_restore;
+
+        // The mirrors step from the controls before the server clears the flags.
+        for (unsigned int index = 0; index < mirrors.size(); ++index)
+            stepMirror(*mirrors[index], startState, controls[index], frames, header.cyclesPerFrame);
+
+        if (!sendRequest(connection, Environment::Command::Step, frames, response))
+        {
+            std::cout << "Step " << step << " failed\n";
+            close(connection);
+            return 2;
+        }
+
+        const Environment::Observation* slot = observations + static_cast<std::size_t>(response.slot) * numInstances;
+
+        for (unsigned int index = 0; index < numInstances; ++index)
+        {
+            drawnObservations += (slot[index].flags & Environment::c_drawn) ? 1 : 0;
+
+            for (unsigned int reward = 0; reward < header.numRewards; ++reward)
+                rewardSum += slot[index].rewards[reward];
+        }
+
+        for (unsigned int index = 0; index < mirrors.size(); ++index)
+            differences += compareObservation(slot[index], mirrors[index]->chip8.getState());
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    const double instanceFrames = static_cast<double>(options.steps) * options.frames * numInstances;
+
+    std::cout << options.steps << " steps of " << numInstances << " instances x " << options.frames << " frames in " << elapsed.count() << " s: "
+              << options.steps / elapsed.count() << " steps/s, " << instanceFrames / elapsed.count() << " frames/s, "
+              << instanceFrames * header.cyclesPerFrame / elapsed.count() << " instructions/s\n";
+    std::cout << "Observations with drawing: " << drawnObservations << ", reward sum: " << rewardSum << "\n";
+
+    if (!mirrors.empty())
+        std::cout << "Mirrored instances: " << mirrors.size() << ", differing fields: " << differences << "\n";
+
+    if (options.shutdown)
+        sendRequest(connection, Environment::Command::Shutdown, 0, response);
+
+    close(connection);
+
+    return (differences == 0) ? 0 : 3;
+}
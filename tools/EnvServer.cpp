@@ -0,0 +1,211 @@
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/EnvironmentServer.h"
+#include "ToolOptions.h"
+
+// Environment server for training loops: hosts a pool of instances of one game and steps them in batches
+// for a client on a Unix socket, with observations in shared memory (see src/EnvironmentProtocol.h and
+// tools/EnvClient.cpp). POSIX only.
+//
+// Usage: EnvServer [options] <rom>
+//   --instances <n>            Instances in the pool (default: 64).
+//   --ring <n>                 Observation slots, the last n steps stay readable (default: 4).
+//   --socket <path>            Unix socket to listen on (default: /tmp/chip8_env.sock).
+//   --shared-memory <name>     Shared memory name (default: chip8_env).
+//   --frame-cycles <n>         Instructions per frame, followed by a timer update (default: 10).
+//   --seed <n>                 Instance k starts with RNG seed n + k (default: 0).
+//   --threads <n>              Threads stepping the instances (default: hardware concurrency).
+//   --dispatch <engine>        map, table or blocks (default: blocks).
+//   --quirks <profile>         chip8, vip, schip or xochip (default: the ROM library index, or chip8).
+//   --reward <addr>[:<bytes>[:bcd]]
+//                              Memory value read into every observation (up to 8): hexadecimal address, 1 to 4
+//                              bytes big endian, or one decimal digit per byte with bcd (default: 1 byte).
+
+namespace
+{
+    EnvironmentServer* runningServer = nullptr;
+
+    void onSignal(int)
+    {
+        if (runningServer != nullptr)
+            runningServer->requestStop();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseReward(const std::string& text, Environment::RewardSource& reward)
+    {
+        const std::size_t sizeSeparator = text.find(':');
+
+        if (!parseNumber(text.substr(0, sizeSeparator), reward.address, 16) || reward.address >= Chip8State::c_memorySize)
+            return false;
+
+        if (sizeSeparator == std::string::npos)
+            return true;
+
+        const std::size_t formatSeparator = text.find(':', sizeSeparator + 1);
+
+        if (!parseNumber(text.substr(sizeSeparator + 1, formatSeparator - sizeSeparator - 1), reward.size))
+            return false;
+
+        if (formatSeparator != std::string::npos)
+        {
+            if (text.substr(formatSeparator + 1) != "bcd")
+                return false;
+
+            reward.format = Environment::RewardSource::Decimal;
+        }
+
+        return reward.size >= 1 && reward.size <= 4;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], EnvironmentServer::Options& options, std::string& romPath, bool& quirkProfileGiven)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const bool hasValue = (i + 1 < argc);
+
+            if (argument == "--instances" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.numInstances))
+                    return false;
+            }
+            else if (argument == "--ring" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.ringSlots))
+                    return false;
+            }
+            else if (argument == "--socket" && hasValue)
+            {
+                options.socketPath = argv[++i];
+            }
+            else if (argument == "--shared-memory" && hasValue)
+            {
+                options.sharedMemoryName = argv[++i];
+            }
+            else if (argument == "--frame-cycles" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.cyclesPerFrame))
+                    return false;
+            }
+            else if (argument == "--seed" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.seed))
+                    return false;
+            }
+            else if (argument == "--threads" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.threads))
+                    return false;
+            }
+            else if (argument == "--dispatch" && hasValue)
+            {
+                if (!Chip8::parseDispatchMode(argv[++i], options.dispatchMode))
+                    return false;
+            }
+            else if (argument == "--quirks" && hasValue)
+            {
+                if (!Chip8::parseQuirkProfile(argv[++i], options.quirkProfile))
+                    return false;
+
+                quirkProfileGiven = true;
+            }
+            else if (argument == "--reward" && hasValue)
+            {
+                Environment::RewardSource reward;
+
+                if (!parseReward(argv[++i], reward))
+                    return false;
+
+                options.rewards.push_back(reward);
+            }
+            else if (argument.compare(0, 2, "--") == 0 || !romPath.empty())
+            {
+                return false;
+            }
+            else
+            {
+                romPath = argument;
+            }
+        }
+
+        return !romPath.empty() && !options.socketPath.empty();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    EnvironmentServer::Options options;
+    std::string romPath;
+    bool quirkProfileGiven = false;
+
+    if (!parseOptions(argc, argv, options, romPath, quirkProfileGiven))
+    {
+        std::cout << "Usage: EnvServer [--instances <n>] [--ring <n>] [--socket <path>] [--shared-memory <name>] [--frame-cycles <n>] [--seed <n>] [--threads <n>] "
+                     "[--dispatch map|table|blocks] [--quirks <profile>] [--reward <addr>[:<bytes>[:bcd]]] <rom>\n";
+        return 1;
+    }
+
+    RomImage rom;
+    std::string error;
+
+    if (!loadRomImage(romPath, rom, error))
+    {
+        std::cout << "Failed to load " << error << "\n";
+        return 1;
+    }
+
+    // Unless given, the quirk profile is the one the ROM library index of the game's directory has for its hash.
+    if (!quirkProfileGiven)
+    {
+        RomLibrary library;
+        const std::string romDirectory = std::filesystem::path(romPath).parent_path().string();
+
+        if (library.open(romDirectory.empty() ? "." : romDirectory, error, false))
+        {
+            const auto indexedRom = library.findByHash(rom.hash);
+
+            if (indexedRom && !Chip8::parseQuirkProfile(indexedRom->quirkProfile, options.quirkProfile))
+            {
+                std::cout << "Unknown quirk profile \"" << indexedRom->quirkProfile << "\" for " << indexedRom->name << " in " << RomLibrary::c_indexFileName << "\n";
+                return 1;
+            }
+        }
+    }
+
+    EnvironmentServer server;
+
+    if (!server.open(options, rom, error))
+    {
+        std::cout << "Failed to start the server (" << error << ")\n";
+        return 1;
+    }
+
+    // Without SA_RESTART, so a signal interrupts the server's waits and the socket and memory get removed.
+    runningServer = &server;
+
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout << "Serving " << options.numInstances << " instances of " << rom.name << " on " << options.socketPath << ", shared memory " << options.sharedMemoryName << "\n";
+
+    const bool served = server.serve(error);
+
+    if (!served)
+        std::cout << "Server stopped (" << error << ")\n";
+
+    server.close();
+    runningServer = nullptr;
+
+    return served ? 0 : 2;
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/Chip8.h"
+#include "../src/FrameStream.h"
+#include "ToolOptions.h"
+
+// Expands a frame stream (see src/FrameStream.h) written by the emulator's or BatchRunner's --frames-out.
+//
+// Usage: FrameDecode [options] <stream>
+//   --hashes                 One CSV line per frame: frame number and display hash, the same FNV-1a the
+//                            emulator reports (default when no --png is given).
+//   --png <prefix>           Write each frame to <prefix><frame>.png, grayscale,
+//   --scale <n>              n screen pixels per CHIP-8 pixel, 1 to 32 (default: 4).
+//
+// Exit code: 0 on success, 1 on usage or I/O errors, 2 when the stream is damaged.
+
+namespace
+{
+    constexpr unsigned int c_maxScale = 32;
+
+    struct Options
+    {
+        std::string streamPath;
+        std::string pngPrefix;
+        bool hashes = false;
+        unsigned int scale = 4;
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const bool hasValue = (i + 1 < argc);
+
+            if (argument == "--hashes")
+            {
+                options.hashes = true;
+            }
+            else if (argument == "--png" && hasValue)
+            {
+                options.pngPrefix = argv[++i];
+            }
+            else if (argument == "--scale" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.scale))
+                    return false;
+            }
+            else if (argument.compare(0, 2, "--") == 0 || !options.streamPath.empty())
+            {
+                return false;
+            }
+            else
+            {
+                options.streamPath = argument;
+            }
+        }
+
+        if (options.pngPrefix.empty())
+            options.hashes = true;
+
+        return !options.streamPath.empty() && options.scale >= 1 && options.scale <= c_maxScale;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Minimal PNG encoder: 8 bit grayscale, no filtering, zlib stream of stored (uncompressed) blocks.
+    class PngWriter
+    {
+    public:
+        PngWriter()
+        {
+            for (std::uint32_t n = 0; n < 256; ++n)
+            {
+                std::uint32_t c = n;
+
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+
+                crcTable[n] = c;
+            }
+        }
+
+        bool write(const std::string& path, const std::vector<byte>& pixels, unsigned int width, unsigned int height) const
+        {
+            std::vector<byte> raw;
+            raw.reserve((width + 1) * height);
+
+            for (unsigned int y = 0; y < height; ++y)
+            {
+                raw.push_back(0);   // Filter type None.
+                raw.insert(raw.end(), pixels.begin() + y * width, pixels.begin() + (y + 1) * width);
+            }
+
+            std::vector<byte> header;
+            appendBigEndian(header, width);
+            appendBigEndian(header, height);
+            header.insert(header.end(), { 8, 0, 0, 0, 0 });     // Bit depth 8, grayscale, deflate, adaptive filtering, no interlace.
+
+            std::vector<byte> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+            appendChunk(file, "IHDR", header);
+            appendChunk(file, "IDAT", deflateStored(raw));
+            appendChunk(file, "IEND", {});
+
+            std::ofstream outputFile(path, std::ios::binary);
+            outputFile.write(reinterpret_cast<const char*>(file.data()), file.size());
+
+            return static_cast<bool>(outputFile);
+        }
+
+    private:
+        static void appendBigEndian(std::vector<byte>& output, std::uint32_t value)
+        {
+            for (int shift = 24; shift >= 0; shift -= 8)
+                output.push_back(static_cast<byte>(value >> shift));
+        }
+
+        static std::vector<byte> deflateStored(const std::vector<byte>& data)
+        {
+            std::vector<byte> stream = { 0x78, 0x01 };
+            std::uint32_t a = 1, b = 0;
+
+            for (const byte value : data)
+            {
+                a = (a + value) % 65521;
+                b = (b + a) % 65521;
+            }
+
+            std::size_t offset = 0;
+
+            do
+            {
+                const std::size_t size = std::min<std::size_t>(data.size() - offset, 0xFFFF);
+                const bool last = (offset + size == data.size());
+
+                stream.push_back(last ? 1 : 0);
+                stream.push_back(static_cast<byte>(size));
+                stream.push_back(static_cast<byte>(size >> 8));
+                stream.push_back(static_cast<byte>(~size));
+                stream.push_back(static_cast<byte>(~size >> 8));
+                stream.insert(stream.end(), data.begin() + offset, data.begin() + offset + size);
+
+                offset += size;
+            } while (offset < data.size());
+
+            appendBigEndian(stream, (b << 16) | a);
+
+            return stream;
+        }
+
+        void appendChunk(std::vector<byte>& output, const char* type, const std::vector<byte>& data) const
+        {
+            appendBigEndian(output, static_cast<std::uint32_t>(data.size()));
+
+            const std::size_t start = output.size();
+            output.insert(output.end(), type, type + 4);
+            output.insert(output.end(), data.begin(), data.end());
+
+            std::uint32_t crc = 0xFFFFFFFFu;
+
+            for (std::size_t i = start; i < output.size(); ++i)
+                crc = crcTable[(crc ^ output[i]) & 0xFF] ^ (crc >> 8);
+
+            appendBigEndian(output, crc ^ 0xFFFFFFFFu);
+        }
+
+        std::array<std::uint32_t, 256> crcTable;
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: FrameDecode [--hashes] [--png <prefix> [--scale <n>]] <stream> \n";
+        return 1;
+    }
+
+    FrameStreamReader reader;
+    std::string error;
+
+    if (!reader.open(options.streamPath, error))
+    {
+        std::cout << "Failed to open frame stream " << error << "\n";
+        return 1;
+    }
+
+    const PngWriter pngWriter;
+    const unsigned int width  = Chip8::c_displayWidth * options.scale;
+    const unsigned int height = Chip8::c_displayHeight * options.scale;
+
+    std::vector<byte> pixels;
+    std::vector<byte> scaledPixels(width * height);
+
+    std::uint32_t frame;
+    Chip8::DisplayRows rows;
+
+    if (options.hashes)
+        std::cout << "frame,display_hash\n";
+
+    while (reader.next(frame, rows, error))
+    {
+        if (options.hashes)
+            std::cout << frame << ',' << std::hex << Chip8::hashDisplay(rows) << std::dec << '\n';
+
+        if (!options.pngPrefix.empty())
+        {
+            Chip8::expandDisplay(rows, pixels);
+
+            for (unsigned int y = 0; y < height; ++y)
+            {
+                for (unsigned int x = 0; x < width; ++x)
+                    scaledPixels[y * width + x] = pixels[(y / options.scale) * Chip8::c_displayWidth + x / options.scale];
+            }
+
+            std::ostringstream path;
+            path << options.pngPrefix << std::setw(6) << std::setfill('0') << frame << ".png";
+
+            if (!pngWriter.write(path.str(), scaledPixels, width, height))
+            {
+                std::cout << "Failed to write " << path.str() << "\n";
+                return 1;
+            }
+        }
+    }
+
+    if (!error.empty())
+    {
+        std::cerr << "Damaged frame stream: " << error << "\n";
+        return 2;
+    }
+
+    return 0;
+}
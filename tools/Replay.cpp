@@ -0,0 +1,324 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "../src/Chip8.h"
+#include "../src/InputMovie.h"
+#include "../src/RomLibrary.h"
+#include "../src/Scheduler.h"
+#include "ToolOptions.h"
+
+// Headless movie replay: runs recorded input (see src/InputMovie.h) as fast as possible, frame by frame
+// exactly as the emulator's scheduler did, and writes one CSV line per movie and engine with the final
+// display hash and registers. Replays are expected to be bit identical across engines and runs.
+//
+// Usage: Replay [options] <movie> [<movie> ...]
+//   --roms <dir>             ROM directory the games are looked up in by hash (default: data/roms).
+//   --engines <list>         Comma separated engines: map, table, blocks (default: all of them).
+//   --generate <rom>         Instead of replaying, write each <movie> with random key changes for <rom>,
+//   --frames <n>             lasting n frames (default: 3600),
+//   --seed <n>               with RNG seed n (default: 0).
+//   --self-test              Instead of movies, run the built-in regression ROMs (code at the end of memory) on
+//                            the engines and compare their final states.
+//
+// Exit code: 0 on success, 1 on usage or I/O errors, 3 when engines end a replay in different states.
+
+namespace
+{
+    struct Options
+    {
+        std::string romDirectory = "data/roms";
+        std::vector<Chip8::DispatchMode> engines = { Chip8::DispatchMode::OpCodeMap, Chip8::DispatchMode::JumpTable, Chip8::DispatchMode::CachedBlocks };
+        std::vector<std::string> moviePaths;
+
+        std::string generateRomPath;
+        std::uint32_t frames = 3600;
+        std::uint32_t seed   = 0;
+
+        bool selfTest = false;
+    };
+
+    // Regression ROMs for the engines, each run for c_selfTestCycles instructions.
+    struct SelfTest
+    {
+        const char* name;
+        std::vector<byte> rom;
+    };
+
+    constexpr unsigned int c_selfTestCycles = 10000;
+
+    const SelfTest c_selfTests[] =
+    {
+        { "jump_to_last_address", { 0x1F, 0xFF } },     // The instruction at 0xFFF reads its second byte at 0x000.
+        { "jump_to_last_word",    { 0x1F, 0xFE } },     // The instruction at 0xFFE leaves PC past the end of memory.
+    };
+
+    // States are compared as raw bytes, padding would make equal states differ.
+    static_assert(std::has_unique_object_representations_v<Chip8State>, "Chip8State has padding, compare it field by field");
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const bool hasValue = (i + 1 < argc);
+
+            if (argument == "--roms" && hasValue)
+            {
+                options.romDirectory = argv[++i];
+            }
+            else if (argument == "--engines" && hasValue)
+            {
+                options.engines.clear();
+
+                std::string list(argv[++i]);
+                std::size_t start = 0;
+
+                while (start <= list.size())
+                {
+                    const std::size_t end = std::min(list.find(',', start), list.size());
+                    Chip8::DispatchMode engine;
+
+                    if (!Chip8::parseDispatchMode(list.substr(start, end - start), engine))
+                        return false;
+
+                    options.engines.push_back(engine);
+                    start = end + 1;
+                }
+            }
+            else if (argument == "--generate" && hasValue)
+            {
+                options.generateRomPath = argv[++i];
+            }
+            else if (argument == "--frames" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.frames))
+                    return false;
+            }
+            else if (argument == "--seed" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.seed))
+                    return false;
+            }
+            else if (argument == "--self-test")
+            {
+                options.selfTest = true;
+            }
+            else if (argument.compare(0, 2, "--") == 0)
+            {
+                return false;
+            }
+            else
+            {
+                options.moviePaths.push_back(argument);
+            }
+        }
+
+        return (options.selfTest || !options.moviePaths.empty()) && !options.engines.empty();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool generateMovie(const Options& options, const std::string& moviePath)
+    {
+        RomImage rom;
+        std::string error;
+
+        if (!loadRomImage(options.generateRomPath, rom, error))
+        {
+            std::cout << "Failed to load " << error << "\n";
+            return false;
+        }
+
+        // Holds random key masks for a random number of frames, like a player pressing keys now and then.
+        std::mt19937 generator(options.seed);
+        InputMovie movie;
+
+        movie.seed       = options.seed;
+        movie.romHash    = rom.hash;
+        movie.frameCount = options.frames;
+
+        for (std::uint32_t frame = 0; frame < options.frames; frame += 1 + generator() % 30)
+            movie.record(frame, static_cast<twoByte>(1u << (generator() % 17)));    // One key or none.
+
+        if (!movie.save(moviePath, error))
+        {
+            std::cout << "Failed to save movie " << error << "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Runs the movie as the scheduler would: the instructions of frame f, the timer update that ends it,
+    // then the keys of frame f + 1.
+    Chip8State replay(const InputMovie& movie, const RomImage& rom, Chip8::DispatchMode engine, double& seconds)
+    {
+        Chip8 chip8(movie.seed);
+        chip8.initialize();
+        chip8.setDispatchMode(engine);
+        chip8.setQuirkProfile(static_cast<Chip8::QuirkProfile>(movie.quirkProfile));
+        chip8.loadGame(rom.data);
+
+        InputMovie::Player player(movie);
+        chip8.setKeys(player.getKeys(0));
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        bool playSound = false;
+
+        for (std::uint32_t frame = 0; frame < movie.frameCount; ++frame)
+        {
+            const std::uint64_t instructions = Scheduler::getInstructionsBeforeTick(frame + 1, movie.instructionsPerSecond) -
+                                               Scheduler::getInstructionsBeforeTick(frame, movie.instructionsPerSecond);
+
+            chip8.emulateCycles(static_cast<unsigned int>(instructions));
+            chip8.updateTimers(playSound);
+            chip8.setKeys(player.getKeys(frame + 1));
+        }
+
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        return chip8.getState();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Runs the regression ROMs on each engine, false when the engines end one of them in different states.
+    bool runSelfTests(const Options& options)
+    {
+        bool identical = true;
+
+        std::cout << "test,engine,instructions,display_hash,pc,i\n";
+
+        for (const SelfTest& test : c_selfTests)
+        {
+            Chip8State reference;
+
+            for (std::size_t engineIndex = 0; engineIndex < options.engines.size(); ++engineIndex)
+            {
+                Chip8 chip8(options.seed);
+                chip8.initialize();
+                chip8.setDispatchMode(options.engines[engineIndex]);
+                chip8.loadGame(test.rom);
+                chip8.emulateCycles(c_selfTestCycles);
+
+                const Chip8State& state = chip8.getState();
+
+                if (engineIndex == 0)
+                    reference = state;
+                else if (std::memcmp(&reference, &state, sizeof(Chip8State)) != 0)
+                    identical = false;
+
+                std::cout << test.name << ',' << engineName(options.engines[engineIndex]) << ',' << c_selfTestCycles << ','
+                          << std::hex << chip8.getDisplayHash() << ',' << chip8.getPC() << ',' << chip8.getI() << std::dec << '\n';
+            }
+        }
+
+        return identical;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: Replay [--roms <dir>] [--engines map,table,blocks] [--generate <rom> [--frames <n>] [--seed <n>]] <movie> [<movie> ...] \n"
+                  << "       Replay [--engines map,table,blocks] [--seed <n>] --self-test\n";
+        return 1;
+    }
+
+    if (options.selfTest)
+    {
+        if (!runSelfTests(options))
+        {
+            std::cerr << "Engines ended a self test in different states\n";
+            return 3;
+        }
+
+        return 0;
+    }
+
+    if (!options.generateRomPath.empty())
+    {
+        for (const std::string& moviePath : options.moviePaths)
+        {
+            if (!generateMovie(options, moviePath))
+                return 1;
+        }
+
+        return 0;
+    }
+
+    RomLibrary library;
+    std::string error;
+
+    if (!library.open(options.romDirectory, error, false))
+    {
+        std::cout << "Failed to open ROM directory " << error << "\n";
+        return 1;
+    }
+
+    bool identical = true;
+
+    std::cout << "movie,engine,frames,instructions,display_hash,pc,i,seconds,frames_per_ms\n";
+
+    for (const std::string& moviePath : options.moviePaths)
+    {
+        InputMovie movie;
+
+        if (!movie.load(moviePath, error))
+        {
+            std::cout << "Failed to load movie " << error << "\n";
+            return 1;
+        }
+
+        const auto rom = library.findByHash(movie.romHash);
+
+        if (!rom)
+        {
+            std::cout << "No ROM in " << options.romDirectory << " matches " << moviePath << "\n";
+            return 1;
+        }
+
+        Chip8State reference;
+
+        for (std::size_t engineIndex = 0; engineIndex < options.engines.size(); ++engineIndex)
+        {
+            double seconds = 0.0;
+            const Chip8State state = replay(movie, *rom, options.engines[engineIndex], seconds);
+
+            if (engineIndex == 0)
+                reference = state;
+            else if (std::memcmp(&reference, &state, sizeof(Chip8State)) != 0)
+                identical = false;
+
+            Chip8 view(0);
+            view.loadState(state);
+
+            std::cout << moviePath << ',' << engineName(options.engines[engineIndex]) << ',' << movie.frameCount << ','
+                      << Scheduler::getInstructionsBeforeTick(movie.frameCount, movie.instructionsPerSecond) << ','
+                      << std::hex << view.getDisplayHash() << ',' << view.getPC() << ',' << view.getI() << std::dec << ','
+                      << seconds << ',' << (seconds > 0.0 ? movie.frameCount / (seconds * 1000.0) : 0.0) << '\n';
+        }
+    }
+
+    if (!identical)
+    {
+        std::cerr << "Engines ended a replay in different states\n";
+        return 3;
+    }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <charconv>
+#include <string>
+#include "../src/Chip8.h"
+
+// Helpers shared by the command line tools.
+
+// Whole number (decimal unless base says otherwise) that fits in value, false otherwise.
+template<typename Number>
+bool parseNumber(const std::string& text, Number& value, int base = 10)
+{
+    const char* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, value, base);
+
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Decimal or scientific notation floating point number, false otherwise.
+inline bool parseNumber(const std::string& text, double& value)
+{
+    const char* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, value);
+
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Name of a dispatch engine, as Chip8::parseDispatchMode() reads it.
+inline const char* engineName(Chip8::DispatchMode mode)
+{
+    switch (mode)
+    {
+        case Chip8::DispatchMode::OpCodeMap:    return "map";
+        case Chip8::DispatchMode::JumpTable:    return "table";
+        case Chip8::DispatchMode::CachedBlocks: return "blocks";
+    }
+
+    return "?";
+}
@@ -0,0 +1,601 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/Chip8.h"
+#include "../src/Debugger.h"
+#include "../src/RomLibrary.h"
+#include "ToolOptions.h"
+
+#ifndef CHIP8_TRACER
+#error "TraceDiff needs every file built with CHIP8_TRACER defined"
+#endif
+
+// Differential tester: runs every game with two dispatch engines, traces every instruction of both (see
+// Tracer.h) and compares the traces record by record. The first divergence is reported with the state of
+// both machines before and after the instruction, replayed from the start.
+//
+// Usage: TraceDiff [options] <rom> [<rom> ...]
+//        TraceDiff --files <trace a> <trace b>
+//   --library <dir>            Run every game of a ROM directory, with the quirk profile of its index.
+//   --engines <a>,<b>          Engines to compare: map, table or blocks (default: map,blocks).
+//   --quirks <profile>         Quirk profile for every ROM (default: the library index, or chip8).
+//   --frames <n>               Frames to run (default: 3000).
+//   --frame-cycles <n>         Instructions per frame, followed by a timer update (default: 10).
+//   --seed <n>                 RNG seed (default: 0).
+//   --random-keys              Drive the keypad with a per frame random key mask derived from the seed (the
+//                              schedule of BatchRunner --random-keys).
+//   --checksum-interval <n>    Records between full state checksums (default: 4096).
+//   --write <dir>              Also write the traces, to <dir>/<rom file>_<engine>.c8tr.
+//   --files                    Compare two trace files instead of running games.
+//
+// Exit code: 0 when the traces match, 3 at the first divergence, 1 or 2 for usage or file errors.
+
+namespace
+{
+    struct Options
+    {
+        std::vector<std::string> romPaths;
+        std::string libraryPath;
+        std::string engineNames[2] = { "map", "blocks" };
+        Chip8::DispatchMode engines[2] = { Chip8::DispatchMode::OpCodeMap, Chip8::DispatchMode::CachedBlocks };
+        Chip8::QuirkProfile quirkProfile = Chip8::QuirkProfile::Chip8;
+        bool quirkProfileGiven           = false;
+        unsigned long long frames   = 3000;
+        unsigned int cyclesPerFrame = 10;
+        unsigned int seed           = 0;
+        bool randomKeys             = false;
+        unsigned int checksumInterval = Trace::c_defaultChecksumInterval;
+        std::string traceDirectory;
+        bool compareFiles = false;
+    };
+
+    // One traced machine.
+    struct Run
+    {
+        Chip8        chip8;
+        Tracer       tracer;
+        TraceWriter  writer;
+        std::mt19937 keyGenerator;
+
+        Run(unsigned int seed, unsigned int checksumInterval) : chip8(seed), tracer(checksumInterval), keyGenerator(seed ^ 0x9E3779B9u) {}
+    };
+
+    // Where two traces stopped agreeing.
+    struct Divergence
+    {
+        std::uint64_t record = 0;
+        std::string   reason;
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const bool hasValue = (i + 1 < argc);
+
+            if (argument == "--library" && hasValue)
+            {
+                options.libraryPath = argv[++i];
+            }
+            else if (argument == "--engines" && hasValue)
+            {
+                const std::string engines(argv[++i]);
+                const std::size_t separator = engines.find(',');
+
+                if (separator == std::string::npos)
+                    return false;
+
+                options.engineNames[0] = engines.substr(0, separator);
+                options.engineNames[1] = engines.substr(separator + 1);
+
+                if (!Chip8::parseDispatchMode(options.engineNames[0], options.engines[0]) || !Chip8::parseDispatchMode(options.engineNames[1], options.engines[1]))
+                    return false;
+            }
+            else if (argument == "--quirks" && hasValue)
+            {
+                if (!Chip8::parseQuirkProfile(argv[++i], options.quirkProfile))
+                    return false;
+
+                options.quirkProfileGiven = true;
+            }
+            else if (argument == "--frames" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.frames))
+                    return false;
+            }
+            else if (argument == "--frame-cycles" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.cyclesPerFrame))
+                    return false;
+            }
+            else if (argument == "--seed" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.seed))
+                    return false;
+            }
+            else if (argument == "--random-keys")
+            {
+                options.randomKeys = true;
+            }
+            else if (argument == "--checksum-interval" && hasValue)
+            {
+                if (!parseNumber(argv[++i], options.checksumInterval))
+                    return false;
+            }
+            else if (argument == "--write" && hasValue)
+            {
+                options.traceDirectory = argv[++i];
+            }
+            else if (argument == "--files")
+            {
+                options.compareFiles = true;
+            }
+            else if (argument.compare(0, 2, "--") == 0)
+            {
+                return false;
+            }
+            else
+            {
+                options.romPaths.push_back(argument);
+            }
+        }
+
+        if (options.cyclesPerFrame == 0 || options.checksumInterval == 0)
+            return false;
+
+        if (options.compareFiles)
+            return options.romPaths.size() == 2 && options.libraryPath.empty();
+
+        return !options.romPaths.empty() || !options.libraryPath.empty();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    std::string hex(unsigned int value, int width)
+    {
+        std::ostringstream text;
+        text << std::hex << std::uppercase << std::setw(width) << std::setfill('0') << value;
+        return text.str();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Empty when the records agree, otherwise what differs. Checksums are compared where both have one.
+    std::string compareRecords(const Trace::Record& a, const Trace::Record& b)
+    {
+        std::ostringstream reason;
+
+        if (a.pc != b.pc || a.opCode != b.opCode)
+            reason << "instruction " << hex(a.pc, 3) << ":" << hex(a.opCode, 4) << " vs " << hex(b.pc, 3) << ":" << hex(b.opCode, 4);
+        else if (a.registers != b.registers)
+            reason << "registers after " << hex(a.pc, 3) << ":" << hex(a.opCode, 4);
+        else if ((a.changes & b.changes & Trace::c_hasChecksum) && a.checksum != b.checksum)
+            reason << "state checksum after " << hex(a.pc, 3) << ":" << hex(a.opCode, 4) << " (memory, display or stack)";
+
+        return reason.str();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Decodes both buffers in step from record index onwards. Records carry on from the previous buffers.
+    bool compareBuffers(const std::vector<byte>& bufferA, const std::vector<byte>& bufferB, Trace::Record (&records)[2], std::uint64_t& index, Divergence& divergence)
+    {
+        const byte* data[2] = { bufferA.data(), bufferB.data() };
+        const byte* end[2]  = { bufferA.data() + bufferA.size(), bufferB.data() + bufferB.size() };
+
+        while (data[0] != end[0] && data[1] != end[1])
+        {
+            if (!Trace::decodeRecord(data[0], end[0], records[0]) || !Trace::decodeRecord(data[1], end[1], records[1]))
+            {
+                divergence = { index, "damaged record" };
+                return false;
+            }
+
+            divergence.reason = compareRecords(records[0], records[1]);
+
+            if (!divergence.reason.empty())
+            {
+                divergence.record = index;
+                return false;
+            }
+
+            ++index;
+        }
+
+        // Both engines run the same instruction count, so the buffers end together.
+        if (data[0] != end[0] || data[1] != end[1])
+        {
+            divergence = { index, "trace lengths differ" };
+            return false;
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printRecord(const std::string& name, const Trace::Record& record)
+    {
+        std::cout << "  " << std::left << std::setw(8) << (name + " ") << std::right << hex(record.pc, 3) << ": " << hex(record.opCode, 4) << "  "
+                  << std::setw(16) << std::left << Debugger::disassemble(record.opCode) << std::right << " I=" << hex(record.registers.I, 3)
+                  << " SP=" << static_cast<int>(record.registers.SP) << " DT=" << hex(record.registers.delayTimer, 2)
+                  << " ST=" << hex(record.registers.soundTimer, 2) << " K=" << hex(record.registers.keys, 4) << " V=";
+
+        for (const byte value : record.registers.V)
+            std::cout << hex(value, 2);
+
+        std::cout << "\n";
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // 0 when the traces match, 2 on errors, 3 when they diverge.
+    int compareTraceFiles(const Options& options)
+    {
+        TraceReader readers[2];
+        std::string error;
+
+        for (int side = 0; side < 2; ++side)
+        {
+            if (!readers[side].open(options.romPaths[side], error))
+            {
+                std::cout << "Failed to open trace " << error << "\n";
+                return 2;
+            }
+        }
+
+        if (readers[0].getHeader().romHash != readers[1].getHeader().romHash)
+            std::cout << "Warning: the traces are of different ROMs\n";
+
+        Trace::Record records[2];
+        std::uint64_t index = 0;
+
+        while (true)
+        {
+            const bool more[2] = { readers[0].next(records[0], error), error.empty() && readers[1].next(records[1], error) };
+
+            if (!error.empty())
+            {
+                std::cout << "Failed to read trace (" << error << ") at record " << index << "\n";
+                return 2;
+            }
+
+            if (!more[0] && !more[1])
+                break;
+
+            const std::string reason = (more[0] && more[1]) ? compareRecords(records[0], records[1]) : "trace lengths differ";
+
+            if (!reason.empty())
+            {
+                std::cout << "Traces diverge at instruction " << index << ": " << reason << "\n";
+
+                for (int side = 0; side < 2; ++side)
+                {
+                    if (more[side])
+                        printRecord(std::filesystem::path(options.romPaths[side]).filename().string(), records[side]);
+                }
+
+                return 3;
+            }
+
+            ++index;
+        }
+
+        std::cout << index << " instructions identical\n";
+        return 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool startRun(const Options& options, const RomImage& rom, Chip8::QuirkProfile quirkProfile, int side, Chip8& chip8)
+    {
+        chip8.initialize();
+        chip8.setDispatchMode(options.engines[side]);
+        chip8.setQuirkProfile(quirkProfile);
+
+        return chip8.loadGame(rom.data);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // Runs a fresh machine up to just before instruction index, with the frames, timer updates and keys
+    // of the traced run.
+    void replay(const Options& options, const RomImage& rom, Chip8::QuirkProfile quirkProfile, int side, std::uint64_t index, Chip8& chip8)
+    {
+        startRun(options, rom, quirkProfile, side, chip8);
+
+        std::mt19937 keyGenerator(options.seed ^ 0x9E3779B9u);
+        bool playSound = false;
+
+        while (true)
+        {
+            if (options.randomKeys)
+                chip8.setKeys(static_cast<twoByte>(keyGenerator()));
+
+            const unsigned int cycles = static_cast<unsigned int>(std::min<std::uint64_t>(options.cyclesPerFrame, index));
+
+            chip8.emulateCycles(cycles);
+            index -= cycles;
+
+            if (cycles < options.cyclesPerFrame)
+                break;
+
+            chip8.updateTimers(playSound);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printState(const std::string& name, const Chip8State& state)
+    {
+        std::cout << "  " << std::left << std::setw(8) << name << std::right << "PC=" << hex(state.PC, 3) << " I=" << hex(state.I, 3)
+                  << " SP=" << static_cast<int>(state.SP) << " DT=" << hex(state.delayTimer, 2) << " ST=" << hex(state.soundTimer, 2)
+                  << " K=" << hex(state.keys, 4) << " V=";
+
+        for (const byte value : state.V)
+            std::cout << hex(value, 2);
+
+        std::cout << " stack=";
+
+        for (unsigned int level = 0; level < state.SP && level < Chip8State::c_stackLevels; ++level)
+            std::cout << (level ? "," : "") << hex(state.stack[level], 3);
+
+        std::cout << "\n";
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void printDifferences(const Chip8State& a, const Chip8State& b)
+    {
+        unsigned int differences = 0;
+
+        for (unsigned int address = 0; address < Chip8State::c_memorySize; ++address)
+        {
+            if (a.memory[address] == b.memory[address])
+                continue;
+
+            if (differences++ < 16)
+                std::cout << "  memory " << hex(address, 3) << ": " << hex(a.memory[address], 2) << " vs " << hex(b.memory[address], 2) << "\n";
+        }
+
+        if (differences > 16)
+            std::cout << "  ... " << differences << " memory bytes differ\n";
+
+        for (unsigned int y = 0; y < Chip8State::c_displayHeight; ++y)
+        {
+            if (a.display[y] != b.display[y])
+                std::cout << "  display row " << y << ": " << hex(static_cast<unsigned int>(a.display[y] >> 32), 8) << hex(static_cast<unsigned int>(a.display[y]), 8)
+                          << " vs " << hex(static_cast<unsigned int>(b.display[y] >> 32), 8) << hex(static_cast<unsigned int>(b.display[y]), 8) << "\n";
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void reportDivergence(const Options& options, const RomImage& rom, Chip8::QuirkProfile quirkProfile, const Divergence& divergence)
+    {
+        std::cout << rom.name << ": " << options.engineNames[0] << " and " << options.engineNames[1] << " diverge at instruction " << divergence.record
+                  << " (frame " << divergence.record / options.cyclesPerFrame << "): " << divergence.reason << "\n";
+
+        std::unique_ptr<Chip8> machines[2];
+
+        for (int side = 0; side < 2; ++side)
+        {
+            machines[side] = std::make_unique<Chip8>(options.seed);
+            replay(options, rom, quirkProfile, side, divergence.record, *machines[side]);
+        }
+
+        std::cout << " before:\n";
+
+        for (int side = 0; side < 2; ++side)
+            printState(options.engineNames[side], machines[side]->getState());
+
+        printDifferences(machines[0]->getState(), machines[1]->getState());
+
+        const twoByte pc = machines[0]->getPC();
+        const twoByte opCode = static_cast<twoByte>(machines[0]->getState().memory[pc & 0xFFF] << 8 | machines[0]->getState().memory[(pc + 1) & 0xFFF]);
+
+        std::cout << " after " << hex(pc, 3) << ": " << hex(opCode, 4) << "  " << Debugger::disassemble(opCode) << "\n";
+
+        for (int side = 0; side < 2; ++side)
+        {
+            machines[side]->emulateCycle();
+            printState(options.engineNames[side], machines[side]->getState());
+        }
+
+        printDifferences(machines[0]->getState(), machines[1]->getState());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    bool openTrace(const Options& options, const RomImage& rom, Chip8::QuirkProfile quirkProfile, int side, Run& run)
+    {
+        Trace::Header header;
+        header.checksumInterval = options.checksumInterval;
+        header.seed             = options.seed;
+        header.romHash          = rom.hash;
+        header.quirkProfile     = static_cast<byte>(quirkProfile);
+        header.dispatchMode     = static_cast<byte>(options.engines[side]);
+
+        const std::string fileName = rom.name + "_" + options.engineNames[side] + ".c8tr";
+        std::string error;
+
+        if (!run.writer.open((std::filesystem::path(options.traceDirectory) / fileName).string(), header, error))
+        {
+            std::cout << "Failed to open trace " << error << "\n";
+            return false;
+        }
+
+        run.tracer.setWriter(&run.writer);
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    // 0 when both engines ran the game identically, 2 on errors, 3 when they diverge.
+    int diffRom(const Options& options, const RomImage& rom)
+    {
+        Chip8::QuirkProfile quirkProfile = options.quirkProfile;
+
+        // Games given by path have no index entry and run as chip8, library games with the profile of their entry.
+        if (!options.quirkProfileGiven && !Chip8::parseQuirkProfile(rom.quirkProfile, quirkProfile) && !rom.quirkProfile.empty())
+        {
+            std::cout << rom.name << ": unknown quirk profile \"" << rom.quirkProfile << "\" in " << RomLibrary::c_indexFileName << "\n";
+            return 2;
+        }
+
+        std::unique_ptr<Run> runs[2];
+        const bool writing = !options.traceDirectory.empty();
+
+        for (int side = 0; side < 2; ++side)
+        {
+            runs[side] = std::make_unique<Run>(options.seed, options.checksumInterval);
+
+            if (!startRun(options, rom, quirkProfile, side, runs[side]->chip8))
+            {
+                std::cout << "Failed to load " << rom.name << "\n";
+                return 2;
+            }
+
+            if (writing && !openTrace(options, rom, quirkProfile, side, *runs[side]))
+                return 2;
+
+            runs[side]->chip8.setTracer(&runs[side]->tracer);
+        }
+
+        // Without files the traces are compared in memory after every frame, so a divergence stops the run early.
+        Trace::Record records[2];
+        std::uint64_t compared = 0;
+        Divergence divergence;
+
+        for (unsigned long long frame = 0; frame < options.frames; ++frame)
+        {
+            for (const auto& run : runs)
+            {
+                bool playSound = false;
+
+                if (options.randomKeys)
+                    run->chip8.setKeys(static_cast<twoByte>(run->keyGenerator()));
+
+                run->chip8.emulateCycles(options.cyclesPerFrame);
+                run->chip8.updateTimers(playSound);
+            }
+
+            if (!writing)
+            {
+                if (!compareBuffers(runs[0]->tracer.getBuffer(), runs[1]->tracer.getBuffer(), records, compared, divergence))
+                {
+                    reportDivergence(options, rom, quirkProfile, divergence);
+                    return 3;
+                }
+
+                runs[0]->tracer.clearBuffer();
+                runs[1]->tracer.clearBuffer();
+            }
+        }
+
+        for (const auto& run : runs)
+            run->tracer.finish(run->chip8.getState());
+
+        if (writing)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                std::string error;
+
+                if (!runs[side]->writer.close(error))
+                {
+                    std::cout << "Failed to write trace of " << rom.name << " (" << error << ")\n";
+                    return 2;
+                }
+            }
+
+            // Compare what was written, which also proves the files read back.
+            Options fileOptions = options;
+            fileOptions.romPaths.clear();
+
+            for (int side = 0; side < 2; ++side)
+                fileOptions.romPaths.push_back((std::filesystem::path(options.traceDirectory) / (rom.name + "_" + options.engineNames[side] + ".c8tr")).string());
+
+            std::cout << rom.name << ": " << runs[0]->tracer.getRecords() << " records, " << runs[0]->writer.getRawBytes() << " bytes raw, "
+                      << runs[0]->writer.getWrittenBytes() << " written; ";
+
+            return compareTraceFiles(fileOptions);
+        }
+
+        if (!compareBuffers(runs[0]->tracer.getBuffer(), runs[1]->tracer.getBuffer(), records, compared, divergence))
+        {
+            reportDivergence(options, rom, quirkProfile, divergence);
+            return 3;
+        }
+
+        std::cout << rom.name << ": " << compared << " instructions identical (" << options.engineNames[0] << ", " << options.engineNames[1] << ")\n";
+        return 0;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: TraceDiff [--library <dir>] [--engines <a>,<b>] [--quirks <profile>] [--frames <n>] [--frame-cycles <n>] [--seed <n>] [--random-keys] "
+                     "[--checksum-interval <n>] [--write <dir>] [<rom> ...]\n"
+                     "       TraceDiff --files <trace a> <trace b>\n";
+        return 1;
+    }
+
+    if (options.compareFiles)
+        return compareTraceFiles(options);
+
+    std::vector<std::shared_ptr<const RomImage>> roms;
+
+    for (const std::string& romPath : options.romPaths)
+    {
+        auto image = std::make_shared<RomImage>();
+        std::string error;
+
+        if (!loadRomImage(romPath, *image, error))
+        {
+            std::cout << "Failed to load " << error << "\n";
+            return 2;
+        }
+
+        roms.push_back(image);
+    }
+
+    if (!options.libraryPath.empty())
+    {
+        RomLibrary library;
+        std::string error;
+
+        if (!library.open(options.libraryPath, error, false))
+        {
+            std::cout << "Failed to open library " << error << "\n";
+            return 2;
+        }
+
+        roms.insert(roms.end(), library.getRoms().begin(), library.getRoms().end());
+    }
+
+    for (const auto& rom : roms)
+    {
+        const int result = diffRom(options, *rom);
+
+        if (result != 0)
+            return result;
+    }
+
+    return 0;
+}